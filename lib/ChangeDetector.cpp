@@ -0,0 +1,108 @@
+#include "ChangeDetector.hpp"
+#include "MemKernels.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+
+// Hash value used for null source blocks
+#define NULL_BLOCK_HASH ( 0 )
+
+
+static inline bool isZero ( const char *bytes, size_t len )
+{
+    for ( size_t i = 0; i < len; ++i )
+    {
+        if ( bytes[i] )
+            return false;
+    }
+
+    return true;
+}
+
+void ChangeDetector::appendChanged ( const char *src, size_t offset, size_t size, vector<ChangedRange>& changed )
+{
+    if ( ! changed.empty() )
+    {
+        ChangedRange& last = changed.back();
+
+        if ( last.offset + last.size == offset && ( src ? last.src + last.size == src : last.src == 0 ) )
+        {
+            last.size += size;
+            return;
+        }
+    }
+
+    changed.push_back ( { src, offset, size } );
+}
+
+
+void CompareChangeDetector::scan ( const char *src, size_t len, size_t offset, const char *prev,
+                                   vector<ChangedRange>& changed )
+{
+    for ( size_t i = 0; i < len; i += blockSize )
+    {
+        const size_t size = min ( blockSize, len - i );
+
+        const char *last = prev + offset + i;
+
+        if ( src ? MemKernels::firstDifference ( src + i, last, size ) != size : !isZero ( last, size ) )
+            appendChanged ( src ? src + i : 0, offset + i, size, changed );
+    }
+}
+
+
+void HashChangeDetector::reset()
+{
+    _hashes.clear();
+    _next = 0;
+}
+
+void HashChangeDetector::begin()
+{
+    _next = 0;
+}
+
+void HashChangeDetector::scan ( const char *src, size_t len, size_t offset, const char *prev,
+                                vector<ChangedRange>& changed )
+{
+    for ( size_t i = 0; i < len; i += blockSize, ++_next )
+    {
+        const size_t size = min ( blockSize, len - i );
+        const uint64_t value = ( src ? hash ( src + i, size ) : NULL_BLOCK_HASH );
+
+        if ( _next < _hashes.size() )
+        {
+            if ( _hashes[_next] == value )
+                continue;
+
+            _hashes[_next] = value;
+        }
+        else
+        {
+            _hashes.push_back ( value );
+        }
+
+        appendChanged ( src ? src + i : 0, offset + i, size, changed );
+    }
+}
+
+uint64_t HashChangeDetector::hash ( const char *bytes, size_t len )
+{
+    // FNV-1a over 32-bit words, then the remaining bytes
+    uint64_t value = 0xCBF29CE484222325ULL;
+    size_t i = 0;
+
+    for ( uint32_t word; i + sizeof ( word ) <= len; i += sizeof ( word ) )
+    {
+        memcpy ( &word, bytes + i, sizeof ( word ) );
+        value = ( value ^ word ) * 0x100000001B3ULL;
+    }
+
+    for ( ; i < len; ++i )
+        value = ( value ^ uint8_t ( bytes[i] ) ) * 0x100000001B3ULL;
+
+    return value;
+}
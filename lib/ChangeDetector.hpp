@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+
+// A range of changed bytes in a snapshot
+struct ChangedRange
+{
+    // The current source bytes of this range, null if the source is all zero
+    const char *src;
+
+    // Location of this range in the snapshot
+    size_t offset, size;
+};
+
+
+// Detects which blocks of memory changed since the previous snapshot.
+// A snapshot is scanned as a sequence of source ranges, always in the same order, each mapped to a snapshot offset.
+class ChangeDetector
+{
+public:
+
+    // Changes are detected at this granularity, blocks are aligned to the start of each source range
+    const size_t blockSize;
+
+    // Construct a change detector with the given block size
+    ChangeDetector ( size_t blockSize ) : blockSize ( blockSize ) {}
+
+    virtual ~ChangeDetector() {}
+
+    // Forget the previous snapshot, so every block of the next snapshot is reported as changed
+    virtual void reset() = 0;
+
+    // Start scanning the next snapshot
+    virtual void begin() = 0;
+
+    // Scan len bytes at src, located at offset in the snapshot, against the previous snapshot prev.
+    // A null src is treated as all zero. Changed ranges are appended, adjacent ones are merged.
+    virtual void scan ( const char *src, size_t len, size_t offset, const char *prev,
+                        std::vector<ChangedRange>& changed ) = 0;
+
+protected:
+
+    // Append a changed range, merging it with the last one if possible
+    static void appendChanged ( const char *src, size_t offset, size_t size, std::vector<ChangedRange>& changed );
+};
+
+
+// Compares each block with the previous snapshot, exact but reads both copies
+class CompareChangeDetector : public ChangeDetector
+{
+public:
+
+    CompareChangeDetector ( size_t blockSize ) : ChangeDetector ( blockSize ) {}
+
+    // The previous snapshot is compared directly, so there is nothing to forget
+    void reset() override {}
+
+    void begin() override {}
+
+    void scan ( const char *src, size_t len, size_t offset, const char *prev,
+                std::vector<ChangedRange>& changed ) override;
+};
+
+
+// Keeps a 64-bit hash of each block, only reads the source, but can miss a change on a hash collision
+class HashChangeDetector : public ChangeDetector
+{
+public:
+
+    HashChangeDetector ( size_t blockSize ) : ChangeDetector ( blockSize ) {}
+
+    void reset() override;
+
+    void begin() override;
+
+    void scan ( const char *src, size_t len, size_t offset, const char *prev,
+                std::vector<ChangedRange>& changed ) override;
+
+    // Hash a block of bytes
+    static uint64_t hash ( const char *bytes, size_t len );
+
+private:
+
+    // Hash of each block in scan order
+    std::vector<uint64_t> _hashes;
+
+    // Index of the next block in scan order
+    size_t _next = 0;
+};
@@ -0,0 +1,232 @@
+#include "Checksum.hpp"
+#include "Compression.hpp"
+
+#include <cpuid.h>
+#include <nmmintrin.h>
+
+#include <cstring>
+
+using namespace std;
+
+
+#define SSE42 __attribute__ ( ( target ( "sse4.2" ) ) )
+
+// Reflected CRC32C polynomial
+#define CRC32C_POLY ( 0x82F63B78u )
+
+#define XXH_PRIME32_1 ( 0x9E3779B1u )
+#define XXH_PRIME32_2 ( 0x85EBCA77u )
+#define XXH_PRIME32_3 ( 0xC2B2AE3Du )
+#define XXH_PRIME32_4 ( 0x27D4EB2Fu )
+#define XXH_PRIME32_5 ( 0x165667B1u )
+
+
+namespace Checksum
+{
+
+bool isSse42Supported()
+{
+    unsigned eax, ebx, ecx, edx;
+
+    if ( ! __get_cpuid ( 1, &eax, &ebx, &ecx, &edx ) )
+        return false;
+
+    return ( ecx & bit_SSE4_2 );
+}
+
+bool useSse42 = isSse42Supported();
+
+
+// Slicing-by-8 tables, table[0] is the regular byte-wise table
+struct Crc32cTables
+{
+    uint32_t table[8][256];
+
+    Crc32cTables()
+    {
+        for ( uint32_t i = 0; i < 256; ++i )
+        {
+            uint32_t crc = i;
+
+            for ( int j = 0; j < 8; ++j )
+                crc = ( crc >> 1 ) ^ ( CRC32C_POLY & ( 0 - ( crc & 1 ) ) );
+
+            table[0][i] = crc;
+        }
+
+        for ( uint32_t i = 0; i < 256; ++i )
+            for ( int j = 1; j < 8; ++j )
+                table[j][i] = ( table[j - 1][i] >> 8 ) ^ table[0][table[j - 1][i] & 0xFF];
+    }
+};
+
+static const Crc32cTables crcTables;
+
+
+static inline uint32_t read32 ( const uint8_t *src )
+{
+    uint32_t value;
+    memcpy ( &value, src, sizeof ( value ) );
+    return value;
+}
+
+static inline uint32_t rotl32 ( uint32_t x, int r )
+{
+    return ( x << r ) | ( x >> ( 32 - r ) );
+}
+
+
+SSE42 static uint32_t crc32cSse42 ( const uint8_t *src, size_t len, uint32_t crc )
+{
+#ifdef __x86_64__
+    uint64_t crc64 = crc;
+
+    for ( ; len >= 8; src += 8, len -= 8 )
+    {
+        uint64_t value;
+        memcpy ( &value, src, sizeof ( value ) );
+        crc64 = _mm_crc32_u64 ( crc64, value );
+    }
+
+    crc = uint32_t ( crc64 );
+#endif
+
+    for ( ; len >= 4; src += 4, len -= 4 )
+        crc = _mm_crc32_u32 ( crc, read32 ( src ) );
+
+    for ( ; len; ++src, --len )
+        crc = _mm_crc32_u8 ( crc, *src );
+
+    return crc;
+}
+
+static uint32_t crc32cTable ( const uint8_t *src, size_t len, uint32_t crc )
+{
+    const uint32_t ( &t ) [8][256] = crcTables.table;
+
+    for ( ; len >= 8; src += 8, len -= 8 )
+    {
+        const uint32_t lo = read32 ( src ) ^ crc;
+        const uint32_t hi = read32 ( src + 4 );
+
+        crc = t[7][lo & 0xFF] ^ t[6][( lo >> 8 ) & 0xFF] ^ t[5][( lo >> 16 ) & 0xFF] ^ t[4][lo >> 24]
+              ^ t[3][hi & 0xFF] ^ t[2][( hi >> 8 ) & 0xFF] ^ t[1][( hi >> 16 ) & 0xFF] ^ t[0][hi >> 24];
+    }
+
+    for ( ; len; ++src, --len )
+        crc = ( crc >> 8 ) ^ t[0][( crc ^ *src ) & 0xFF];
+
+    return crc;
+}
+
+uint32_t crc32c ( const void *bytes, size_t len, uint32_t crc )
+{
+    const uint8_t *src = ( const uint8_t * ) bytes;
+
+    crc = ~crc;
+    crc = ( useSse42 ? crc32cSse42 ( src, len, crc ) : crc32cTable ( src, len, crc ) );
+    return ~crc;
+}
+
+
+static inline uint32_t xxHash32Round ( uint32_t acc, uint32_t input )
+{
+    acc += input * XXH_PRIME32_2;
+    acc = rotl32 ( acc, 13 );
+    return acc * XXH_PRIME32_1;
+}
+
+uint32_t xxHash32 ( const void *bytes, size_t len, uint32_t seed )
+{
+    const uint8_t *src = ( const uint8_t * ) bytes;
+    const uint8_t *const end = src + len;
+
+    uint32_t hash;
+
+    if ( len >= 16 )
+    {
+        uint32_t v1 = seed + XXH_PRIME32_1 + XXH_PRIME32_2;
+        uint32_t v2 = seed + XXH_PRIME32_2;
+        uint32_t v3 = seed;
+        uint32_t v4 = seed - XXH_PRIME32_1;
+
+        for ( ; src + 16 <= end; src += 16 )
+        {
+            v1 = xxHash32Round ( v1, read32 ( src ) );
+            v2 = xxHash32Round ( v2, read32 ( src + 4 ) );
+            v3 = xxHash32Round ( v3, read32 ( src + 8 ) );
+            v4 = xxHash32Round ( v4, read32 ( src + 12 ) );
+        }
+
+        hash = rotl32 ( v1, 1 ) + rotl32 ( v2, 7 ) + rotl32 ( v3, 12 ) + rotl32 ( v4, 18 );
+    }
+    else
+    {
+        hash = seed + XXH_PRIME32_5;
+    }
+
+    hash += uint32_t ( len );
+
+    for ( ; src + 4 <= end; src += 4 )
+        hash = rotl32 ( hash + read32 ( src ) * XXH_PRIME32_3, 17 ) * XXH_PRIME32_4;
+
+    for ( ; src < end; ++src )
+        hash = rotl32 ( hash + ( *src ) * XXH_PRIME32_5, 11 ) * XXH_PRIME32_1;
+
+    hash ^= hash >> 15;
+    hash *= XXH_PRIME32_2;
+    hash ^= hash >> 13;
+    hash *= XXH_PRIME32_3;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+
+size_t getSize ( ChecksumType type )
+{
+    switch ( type )
+    {
+        case ChecksumType::CRC32C:
+        case ChecksumType::XXHash32:
+            return sizeof ( uint32_t );
+
+        default:
+            return 16;
+    }
+}
+
+void calculate ( ChecksumType type, const char *bytes, size_t len, char *dst )
+{
+    uint32_t checksum;
+
+    switch ( type )
+    {
+        case ChecksumType::CRC32C:
+            checksum = crc32c ( bytes, len );
+            break;
+
+        case ChecksumType::XXHash32:
+            checksum = xxHash32 ( bytes, len );
+            break;
+
+        default:
+            getMD5 ( bytes, len, dst );
+            return;
+    }
+
+    memcpy ( dst, &checksum, sizeof ( checksum ) );
+}
+
+bool check ( ChecksumType type, const char *bytes, size_t len, const char *checksum )
+{
+    char tmp[CHECKSUM_MAX_SIZE];
+    calculate ( type, bytes, len, tmp );
+    return ! memcmp ( tmp, checksum, getSize ( type ) );
+}
+
+ChecksumType getFastest()
+{
+    return ( useSse42 ? ChecksumType::CRC32C : ChecksumType::XXHash32 );
+}
+
+}
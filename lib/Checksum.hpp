@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+
+// Message integrity checks. MD5 must stay 0, since older versions always send 0 and only understand MD5.
+enum class ChecksumType : uint8_t { MD5 = 0, CRC32C = 1, XXHash32 = 2 };
+
+
+// Number of bytes for the largest checksum
+#define CHECKSUM_MAX_SIZE ( 16 )
+
+
+// Checksum calculations, with an SSE4.2 CRC32C path selected at runtime and a table based fallback
+namespace Checksum
+{
+
+// True if the SSE4.2 CRC32C path is used, defaults to whether the CPU supports SSE4.2
+extern bool useSse42;
+
+// True if the CPU supports SSE4.2
+bool isSse42Supported();
+
+// CRC32C (Castagnoli), crc is the result of the previous range when calculating in parts
+uint32_t crc32c ( const void *bytes, size_t len, uint32_t crc = 0 );
+
+// 32-bit xxHash
+uint32_t xxHash32 ( const void *bytes, size_t len, uint32_t seed = 0 );
+
+// Number of bytes for the given checksum type
+size_t getSize ( ChecksumType type );
+
+// Calculate the checksum into dst, which must have space for getSize ( type ) bytes
+void calculate ( ChecksumType type, const char *bytes, size_t len, char *dst );
+
+// Check the checksum against the one calculated from the given bytes
+bool check ( ChecksumType type, const char *bytes, size_t len, const char *checksum );
+
+// Fastest non-MD5 checksum on this CPU, the other side must have negotiated ClientMode::FastChecksum
+ChecksumType getFastest();
+
+}
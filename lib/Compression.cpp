@@ -1,5 +1,6 @@
 #include "Compression.hpp"
 #include "Logger.hpp"
+#include "MemKernels.hpp"
 
 #define MINIZ_NO_ZLIB_COMPATIBLE_NAMES
 #include <miniz.h>
@@ -49,12 +50,12 @@ size_t compress ( const char *src, size_t srcLen, char *dst, size_t dstLen, int
 
 size_t uncompress ( const char *src, size_t srcLen, char *dst, size_t dstLen )
 {
-    mz_ulong len = dstLen;
-    int rc = mz_uncompress ( ( unsigned char * ) dst, &len, ( unsigned char * ) src, srcLen );
-    if ( rc == MZ_OK )
+    // The decompressor state is kept on the stack, mz_uncompress allocates it on the heap for every call
+    size_t len = tinfl_decompress_mem_to_mem ( dst, dstLen, src, srcLen, TINFL_FLAG_PARSE_ZLIB_HEADER );
+    if ( len != TINFL_DECOMPRESS_MEM_TO_MEM_FAILED )
         return len;
 
-    LOG ( "[%d] %s; zlib error", rc, mz_error ( rc ) );
+    LOG ( "Failed to decompress [ %u bytes ]", srcLen );
     return 0;
 }
 
@@ -62,3 +63,116 @@ size_t compressBound ( size_t srcLen )
 {
     return mz_compressBound ( srcLen );
 }
+
+
+// Minimum number of equal bytes to end a literal run, shorter equal runs are cheaper to encode as literals
+#define DELTA_MIN_ZERO_RUN ( 8 )
+
+static inline void writeVarint ( string& dst, size_t value )
+{
+    while ( value >= 0x80 )
+    {
+        dst.push_back ( char ( ( value & 0x7F ) | 0x80 ) );
+        value >>= 7;
+    }
+
+    dst.push_back ( char ( value ) );
+}
+
+static inline bool readVarint ( const char *& src, const char *end, size_t& value )
+{
+    value = 0;
+
+    for ( size_t shift = 0; src < end && shift < 8 * sizeof ( size_t ); shift += 7 )
+    {
+        const uint8_t byte = * ( src++ );
+
+        value |= size_t ( byte & 0x7F ) << shift;
+
+        if ( ! ( byte & 0x80 ) )
+            return true;
+    }
+
+    return false;
+}
+
+size_t deltaCompress ( const char *src, const char *base, size_t len, string& dst )
+{
+    dst.clear();
+
+    size_t zeroRun = 0;
+    deltaAppend ( src, base, len, zeroRun, dst );
+
+    return dst.size();
+}
+
+void deltaAppend ( const char *src, const char *base, size_t len, size_t& zeroRun, string& dst )
+{
+    size_t pos = 0;
+
+    while ( pos < len )
+    {
+        const size_t zeroStart = pos;
+
+        // Skip equal bytes
+        pos += MemKernels::firstDifference ( src + pos, base + pos, len - pos );
+
+        zeroRun += pos - zeroStart;
+
+        // Trailing equal bytes are carried over to the next range
+        if ( pos == len )
+            break;
+
+        // Gather the literal run, allowing short runs of equal bytes inside it
+        const size_t literalStart = pos;
+        size_t literalEnd = pos;
+
+        while ( pos < len )
+        {
+            if ( src[pos] != base[pos] )
+                literalEnd = ++pos;
+            else if ( pos - literalEnd >= DELTA_MIN_ZERO_RUN )
+                break;
+            else
+                ++pos;
+        }
+
+        writeVarint ( dst, zeroRun );
+        writeVarint ( dst, literalEnd - literalStart );
+
+        const size_t offset = dst.size();
+        dst.resize ( offset + literalEnd - literalStart );
+
+        for ( size_t i = literalStart; i < literalEnd; ++i )
+            dst[offset + i - literalStart] = src[i] ^ base[i];
+
+        zeroRun = 0;
+        pos = literalEnd;
+    }
+}
+
+bool deltaUncompress ( const char *delta, size_t deltaLen, char *dst, size_t len )
+{
+    const char *end = delta + deltaLen;
+
+    size_t pos = 0, zeroRun, literalLen;
+
+    while ( delta < end )
+    {
+        if ( ! readVarint ( delta, end, zeroRun ) || ! readVarint ( delta, end, literalLen ) )
+            return false;
+
+        pos += zeroRun;
+
+        if ( pos + literalLen > len || literalLen > size_t ( end - delta ) )
+            return false;
+
+        for ( size_t i = 0; i < literalLen; ++i )
+            dst[pos + i] ^= delta[i];
+
+        delta += literalLen;
+        pos += literalLen;
+    }
+
+    return true;
+}
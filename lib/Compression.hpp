@@ -14,3 +14,15 @@ bool checkMD5 ( const std::string& str, const char md5[16] );
 size_t compress ( const char *src, size_t srcLen, char *dst, size_t dstLen, int level = 9 );
 size_t uncompress ( const char *src, size_t srcLen, char *dst, size_t dstLen );
 size_t compressBound ( size_t srcLen );
+
+
+// XOR / run-length delta compression against a base buffer of the same length.
+// The encoded delta is a sequence of ( zero run length, literal length, literal XOR bytes ), with varint lengths.
+size_t deltaCompress ( const char *src, const char *base, size_t len, std::string& dst );
+
+// Append the delta of a range to dst, for building a delta out of separate ranges.
+// zeroRun is the number of equal bytes before this range, and is updated to the number of trailing equal bytes.
+void deltaAppend ( const char *src, const char *base, size_t len, size_t& zeroRun, std::string& dst );
+
+// Apply a delta in-place, this turns the base buffer into the original source buffer
+bool deltaUncompress ( const char *delta, size_t deltaLen, char *dst, size_t len );
@@ -1,6 +1,7 @@
 #include "ControllerManager.hpp"
 #include "Exceptions.hpp"
 #include "ErrorStrings.hpp"
+#include "Profiler.hpp"
 
 #define INITGUID
 #define DIRECTINPUT_VERSION 0x0800 // Need at least version 8
@@ -224,6 +225,17 @@ bool ControllerManager::check()
         ++it;
     }
 
+    // Queue the polled states for the frame step, only when something is consuming them
+    if ( pollingThread.isRunning() )
+    {
+        const uint64_t ticks = Profiler::getTicks();
+
+        samples.push ( { ticks, &keyboard, keyboard._state } );
+
+        for ( const auto& kv : joysticks )
+            samples.push ( { ticks, kv.second.get(), kv.second->_state } );
+    }
+
     return true;
 }
 
@@ -4,6 +4,7 @@
 #include "JoystickDetector.hpp"
 #include "Guid.hpp"
 #include "Thread.hpp"
+#include "SpscRing.hpp"
 
 #include <unordered_map>
 #include <unordered_set>
@@ -11,6 +12,23 @@
 #include <vector>
 
 
+// Number of polled controller states queued for the frame step, this must be a power of 2
+#define CONTROLLER_SAMPLES_SIZE ( 256 )
+
+
+// Controller state polled at a specific time
+struct ControllerSample
+{
+    // Profiler ticks when the state was polled
+    uint64_t ticks;
+
+    // Only for comparing, since the controller may be detached after this was queued
+    const Controller *controller;
+
+    uint32_t state;
+};
+
+
 struct ControllerMappings : public SerializableSequence
 {
     std::unordered_map<std::string, MsgPtr> mappings;
@@ -87,6 +105,10 @@ public:
     // Start the high frequency polling thread
     void startHighFreqPolling();
 
+    // Pop the oldest state queued by the polling thread, returns false if empty.
+    // This doesn't lock the mutex, so it must only be called from one consumer thread.
+    bool popSample ( ControllerSample& sample ) { return samples.pop ( sample ); }
+
     // Save / load mappings to / from a folder, returns the number of mappings saved / loaded
     size_t saveMappings ( const std::string& folder, const std::string& ext ) const;
     size_t loadMappings ( const std::string& folder, const std::string& ext );
@@ -129,6 +151,9 @@ private:
 
     PollingThread pollingThread;
 
+    // States polled by the polling thread, pushed under the mutex and popped without it
+    SpscRing<ControllerSample, CONTROLLER_SAMPLES_SIZE> samples;
+
     // Attach / detach a joystick
     void attachJoystick ( const Guid& guid, JoystickInfo& info );
     void detachJoystick ( const Guid& guid );
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <array>
+#include <cstring>
+#include <type_traits>
+
+
+// Compile-time fixed layout serialization, for messages where every field has a fixed size.
+// This produces the same bytes as cereal's binary archives, without going through a stream for each field.
+namespace FixedLayout
+{
+
+// Arithmetic and enum fields are written by cereal as their raw bytes
+template<typename T, typename Enable = void>
+struct Field
+{
+    static constexpr bool isFixed = false;
+    static constexpr size_t size = 0;
+};
+
+template<typename T>
+struct Field<T, typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value>::type>
+{
+    static constexpr bool isFixed = true;
+    static constexpr size_t size = sizeof ( T );
+};
+
+// Arrays of fixed size fields are written element by element, which is their raw bytes without padding
+template<typename T, size_t N>
+struct Field<std::array<T, N>>
+{
+    static constexpr bool isFixed = Field<T>::isFixed && ( sizeof ( std::array<T, N> ) == N * Field<T>::size );
+    static constexpr size_t size = ( isFixed ? N * Field<T>::size : 0 );
+};
+
+
+// Total size of the fields, only valid if every field is fixed
+template<typename ... Ts>
+struct Layout
+{
+    static constexpr bool isFixed = true;
+    static constexpr size_t size = 0;
+};
+
+template<typename T, typename ... Ts>
+struct Layout<T, Ts ...>
+{
+    static constexpr bool isFixed = Field<T>::isFixed && Layout<Ts ...>::isFixed;
+    static constexpr size_t size = ( isFixed ? Field<T>::size + Layout<Ts ...>::size : 0 );
+};
+
+
+inline void saveFields ( char *dst ) {}
+
+template<typename T, typename ... Ts>
+inline void saveFields ( char *dst, const T& t, const Ts& ... ts )
+{
+    memcpy ( dst, &t, Field<T>::size );
+    saveFields ( dst + Field<T>::size, ts ... );
+}
+
+inline void loadFields ( const char *src ) {}
+
+template<typename T, typename ... Ts>
+inline void loadFields ( const char *src, T& t, Ts& ... ts )
+{
+    memcpy ( &t, src, Field<T>::size );
+    loadFields ( src + Field<T>::size, ts ... );
+}
+
+
+// Number of bytes for the fields, 0 if any field doesn't have a fixed size
+template<typename ... Ts>
+constexpr size_t size ( const Ts& ... )
+{
+    return Layout<Ts ...>::size;
+}
+
+// Write the fields to dst, which must have space for size ( ts ... ) bytes
+template<typename ... Ts>
+inline typename std::enable_if<Layout<Ts ...>::isFixed>::type save ( char *dst, const Ts& ... ts )
+{
+    saveFields ( dst, ts ... );
+}
+
+template<typename ... Ts>
+inline typename std::enable_if<! Layout<Ts ...>::isFixed>::type save ( char *dst, const Ts& ... ts ) {}
+
+// Read the fields from src, which must have at least size ( ts ... ) bytes
+template<typename ... Ts>
+inline typename std::enable_if<Layout<Ts ...>::isFixed>::type load ( const char *src, Ts& ... ts )
+{
+    loadFields ( src, ts ... );
+}
+
+template<typename ... Ts>
+inline typename std::enable_if<! Layout<Ts ...>::isFixed>::type load ( const char *src, Ts& ... ts ) {}
+
+}
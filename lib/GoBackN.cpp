@@ -106,9 +106,9 @@ void GoBackN::sendViaGoBackN ( const MsgPtr& msg )
     else
     {
         msg->getAs<SerializableSequence>().setSequence ( _sendSequence + 1 );
-        string bytes = ::Protocol::encode ( msg );
+        ::Protocol::encode ( msg, _encodeBuffer );
 
-        if ( bytes.size() <= MTU )
+        if ( _encodeBuffer.size() <= MTU )
         {
             ++_sendSequence;
             owner->goBackNSendRaw ( this, msg );
@@ -116,11 +116,12 @@ void GoBackN::sendViaGoBackN ( const MsgPtr& msg )
         }
         else
         {
-            const uint32_t count = ( bytes.size() / MTU ) + ( bytes.size() % MTU == 0 ? 0 : 1 );
+            const uint32_t count = ( _encodeBuffer.size() / MTU ) + ( _encodeBuffer.size() % MTU == 0 ? 0 : 1 );
 
-            for ( uint32_t pos = 0, i = 0; pos < bytes.size(); pos += MTU, ++i )
+            for ( uint32_t pos = 0, i = 0; pos < _encodeBuffer.size(); pos += MTU, ++i )
             {
-                SplitMessage *splitMsg = new SplitMessage ( msg->getMsgType(), bytes.substr ( pos, MTU ), i, count );
+                SplitMessage *splitMsg = new SplitMessage ( msg->getMsgType(), _encodeBuffer.substr ( pos, MTU ),
+                                                            i, count );
                 splitMsg->setSequence ( ++_sendSequence );
 
                 MsgPtr msg ( splitMsg );
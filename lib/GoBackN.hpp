@@ -121,6 +121,9 @@ private:
     // Buffer for accumulating split messages
     std::string _recvBuffer;
 
+    // Buffer for encoding messages to check if they need to be split
+    std::string _encodeBuffer;
+
     // The interval to send packets, should be non-zero
     uint64_t _interval = DEFAULT_SEND_INTERVAL;
 
@@ -1,9 +1,10 @@
 #include "MemDump.hpp"
 #include "Compression.hpp"
 #include "Algorithms.hpp"
+#include "MemKernels.hpp"
 
-#include <list>
 #include <algorithm>
+#include <numeric>
 #include <cstring>
 #include <sstream>
 #include <fstream>
@@ -78,49 +79,299 @@ vector<MemDumpPtr> MemDumpBase::concat ( const vector<MemDumpPtr>& a, const vect
     return ret;
 }
 
+MemDumpBase::MemDumpBase ( const MemDump *const *first, const MemDump *const *last )
+    : size ( accumulate ( first, last, size_t ( 0 ), [] ( size_t sum, const MemDump *mem ) { return sum + mem->size; } ) )
+    , ptrs ( mergePtrs ( first, last, this ) ) {}
+
+vector<MemDumpPtr> MemDumpBase::mergePtrs ( const MemDump *const *first, const MemDump *const *last,
+                                            const MemDumpBase *parent )
+{
+    size_t count = 0;
+    for ( auto it = first; it != last; ++it )
+        count += ( *it )->ptrs.size();
+
+    vector<MemDumpPtr> ret;
+    ret.reserve ( count );
+
+    size_t offset = 0;
+
+    for ( auto it = first; it != last; ++it )
+    {
+        ASSERT ( it == first || ( *it )->addr == ( * ( it - 1 ) )->addr + ( * ( it - 1 ) )->size );
+
+        for ( const MemDumpPtr& ptr : ( *it )->ptrs )
+            ret.push_back ( MemDumpPtr ( parent, ptr.ptrs, ptr.srcOffset + offset, ptr.dstOffset, ptr.size ) );
+
+        offset += ( *it )->size;
+    }
+
+    return ret;
+}
+
 void MemDumpList::update()
 {
-    vector<MemDump> sortedVector = sorted ( addrs, compareMemDumpAddrs );
-    list<MemDump> sortedList ( sortedVector.begin(), sortedVector.end() );
+    overlaps.clear();
 
-    addrs.clear();
-    addrs.push_back ( sortedList.front() );
+    // Sort pointers to the memory dumps, so nothing is copied until the merged list is built
+    vector<const MemDump *> sorted;
+    sorted.reserve ( addrs.size() );
+
+    for ( const MemDump& mem : addrs )
+        sorted.push_back ( &mem );
+
+    stable_sort ( sorted.begin(), sorted.end(), [] ( const MemDump *a, const MemDump *b )
+    {
+        return compareMemDumpAddrs ( *a, *b );
+    } );
 
-    auto it = sortedList.begin();
-    auto jt = it;
+    // Find the runs of continuous address ranges in a single pass. Overlaps are checked against the maximum end so far,
+    // since a range can overlap an earlier range that contains the ranges in between.
+    vector<size_t> runs;
+    const char *maxStart = 0;
+    const char *maxEnd = 0;
 
-    // Merge continuous address ranges
-    for ( ++jt; jt != sortedList.end(); ++jt )
+    for ( size_t i = 0; i < sorted.size(); ++i )
     {
-        if ( jt->addr >= addrs.back().addr && jt->addr < addrs.back().addr + addrs.back().size )
+        const MemDump& mem = *sorted[i];
+
+        if ( i == 0 )
         {
-            LOG ( "Overlap: { 0x%06X, 0x%06X } and { 0x%06X, 0x%06X }",
-                  addrs.back().addr, addrs.back().addr + addrs.back().size,
-                  jt->addr, jt->addr + jt->size );
+            runs.push_back ( i );
         }
-
-        // Add to the previous address's size if the next one is continuous
-        if ( addrs.back().addr + addrs.back().size == jt->addr )
+        else if ( mem.addr != sorted[i - 1]->addr + sorted[i - 1]->size || mem.addr != maxEnd )
         {
-            // Merge the two addresses
-            MemDump merged ( addrs.back(), *jt );
-            addrs.pop_back();
-            addrs.push_back ( merged );
-
-            // Erase and try the next address
-            sortedList.erase ( jt );
-            jt = it;
-            continue;
+            if ( mem.addr < maxEnd )
+                overlaps.push_back ( { maxStart, size_t ( maxEnd - maxStart ), mem.addr, mem.size } );
+
+            runs.push_back ( i );
         }
 
-        ++it;
-        addrs.push_back ( *jt );
+        if ( i == 0 || mem.addr + mem.size > maxEnd )
+        {
+            maxStart = sorted[runs.back()]->addr;
+            maxEnd = mem.addr + mem.size;
+        }
     }
 
+    runs.push_back ( sorted.size() );
+
+    // Merge each run, the new list is reserved so the merged memory dumps are constructed in place
+    vector<MemDump> merged;
+    merged.reserve ( runs.size() - 1 );
+
+    for ( size_t i = 0; i + 1 < runs.size(); ++i )
+        merged.emplace_back ( sorted.data() + runs[i], sorted.data() + runs[i + 1] );
+
+    addrs.swap ( merged );
+
     // Update the total size
     totalSize = 0;
     for ( const MemDump& mem : addrs )
         totalSize += mem.getTotalSize();
+
+    plan.compile ( addrs );
+}
+
+MemDumpPlan& MemDumpPlan::operator= ( const MemDumpPlan& other )
+{
+    _ops = other._ops;
+    ops = ( other._ops.empty() ? other.ops : &_ops[0] );
+    numOps = other.numOps;
+    totalSize = other.totalSize;
+    return *this;
+}
+
+bool MemDumpPlan::compile ( const vector<MemDump>& addrs )
+{
+    clear();
+
+    for ( const MemDump& mem : addrs )
+    {
+        if ( ! compile ( mem, 0, ( size_t ) mem.addr, 0 ) )
+        {
+            clear();
+            return false;
+        }
+    }
+
+    for ( const MemDumpOp& op : _ops )
+        totalSize += op.size;
+
+    ops = ( _ops.empty() ? 0 : &_ops[0] );
+    numOps = _ops.size();
+    return true;
+}
+
+bool MemDumpPlan::compile ( const MemDumpBase& mem, uint32_t depth, size_t src, size_t dst )
+{
+    if ( depth >= MEMDUMP_MAX_DEPTH )
+    {
+        LOG ( "Pointer chain is too deep: depth=%u", depth );
+        return false;
+    }
+
+    // Merge continuous static addresses, unless the child pointers need this address
+    if ( depth == 0 && mem.ptrs.empty() && ! _ops.empty()
+            && _ops.back().depth == 0 && _ops.back().src + _ops.back().size == src )
+    {
+        _ops.back().size += mem.size;
+        return true;
+    }
+
+    _ops.push_back ( { depth, src, dst, mem.size } );
+
+    for ( const MemDumpPtr& ptr : mem.ptrs )
+    {
+        if ( ! compile ( ptr, depth + 1, ptr.srcOffset, ptr.dstOffset ) )
+            return false;
+    }
+
+    return true;
+}
+
+void MemDumpPlan::saveDump ( char *dump ) const
+{
+    ASSERT ( dump != 0 );
+
+    run ( [dump] ( const char *addr, size_t size, size_t offset )
+    {
+        if ( addr )
+            MemKernels::copy ( dump + offset, addr, size );
+        else
+            memset ( dump + offset, 0, size );
+    } );
+}
+
+void MemDumpPlan::loadDump ( const char *dump ) const
+{
+    ASSERT ( dump != 0 );
+
+    run ( [dump] ( char *addr, size_t size, size_t offset )
+    {
+        if ( addr )
+            MemKernels::copy ( addr, dump + offset, size );
+    } );
+}
+
+void MemDumpPlan::scanDump ( ChangeDetector& detector, const char *prev, vector<ChangedRange>& changed ) const
+{
+    ASSERT ( prev != 0 );
+
+    run ( [&] ( const char *addr, size_t size, size_t offset )
+    {
+        detector.scan ( addr, size, offset, prev, changed );
+    } );
+}
+
+void MemDumpPlan::save ( string& data ) const
+{
+    const MemDumpHeader header = { MEMDUMP_MAGIC, MEMDUMP_VERSION, ( uint32_t ) numOps, ( uint32_t ) totalSize };
+
+    data.assign ( ( const char * ) &header, sizeof ( header ) );
+
+    for ( const MemDumpOp *op = ops; op != ops + numOps; ++op )
+    {
+        const MemDumpRecord record = { op->depth, ( uint32_t ) op->src, ( uint32_t ) op->dst, ( uint32_t ) op->size };
+        data.append ( ( const char * ) &record, sizeof ( record ) );
+    }
+
+    char md5[16];
+    getMD5 ( data, md5 );
+    data.append ( md5, sizeof ( md5 ) );
+}
+
+bool MemDumpPlan::save ( const string& filename ) const
+{
+    string data;
+    save ( data );
+
+    ofstream fout ( filename.c_str(), ofstream::binary );
+    bool good = fout.good();
+    if ( good )
+        good = fout.write ( &data[0], data.size() ).good();
+    fout.close();
+    return good;
+}
+
+bool MemDumpPlan::load ( const char *data, size_t size )
+{
+    clear();
+
+    MemDumpHeader header;
+
+    if ( size >= sizeof ( header ) )
+        memcpy ( &header, data, sizeof ( header ) );
+
+    // Fallback to the old MemDumpList format
+    if ( size < sizeof ( header ) || header.magic != MEMDUMP_MAGIC )
+    {
+        MemDumpList list;
+
+        if ( ! list.load ( data, size ) )
+            return false;
+
+        *this = list.plan;
+        return true;
+    }
+
+    if ( header.version != MEMDUMP_VERSION )
+    {
+        LOG ( "Unsupported version: %u", header.version );
+        return false;
+    }
+
+    if ( size != sizeof ( header ) + header.numOps * sizeof ( MemDumpRecord ) + 16
+            || ! checkMD5 ( data, size - 16, data + size - 16 ) )
+    {
+        LOG ( "Invalid data" );
+        return false;
+    }
+
+    const char *records = data + sizeof ( header );
+
+    // Use the records in place if they have the same layout as the ops, otherwise copy them
+    if ( sizeof ( MemDumpOp ) == sizeof ( MemDumpRecord ) && ( size_t ) records % alignof ( MemDumpOp ) == 0 )
+    {
+        ops = ( const MemDumpOp * ) records;
+    }
+    else
+    {
+        _ops.resize ( header.numOps );
+
+        for ( uint32_t i = 0; i < header.numOps; ++i )
+        {
+            MemDumpRecord record;
+            memcpy ( &record, records + i * sizeof ( record ), sizeof ( record ) );
+
+            _ops[i] = { record.depth, record.src, record.dst, record.size };
+        }
+
+        ops = ( _ops.empty() ? 0 : &_ops[0] );
+    }
+
+    numOps = header.numOps;
+    totalSize = 0;
+
+    for ( size_t i = 0; i < numOps; ++i )
+    {
+        if ( ops[i].depth >= MEMDUMP_MAX_DEPTH || ( i == 0 && ops[i].depth != 0 )
+                || ( i > 0 && ops[i].depth > ops[i - 1].depth + 1 ) )
+        {
+            LOG ( "Invalid op: i=%u; depth=%u", i, ops[i].depth );
+            clear();
+            return false;
+        }
+
+        totalSize += ops[i].size;
+    }
+
+    if ( totalSize != header.totalSize )
+    {
+        clear();
+        return false;
+    }
+
+    return true;
 }
 
 void MemDumpBase::save ( BinaryOutputArchive& ar ) const
@@ -285,5 +536,12 @@ bool MemDumpList::load ( const char *data, size_t size )
         return false;
     }
 
+    // Flatten the memory dumps for saving / loading
+    if ( ! plan.compile ( addrs ) || plan.totalSize != totalSize )
+    {
+        clear();
+        return false;
+    }
+
     return true;
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Logger.hpp"
+#include "ChangeDetector.hpp"
 
 #include <cereal/archives/binary.hpp>
 
@@ -9,6 +10,7 @@
 
 
 class MemDumpPtr;
+class MemDump;
 
 
 class MemDumpBase
@@ -42,7 +44,13 @@ public:
 
 protected:
 
+    // Construct a memory dump by merging a sorted range of continuous memory dumps
+    MemDumpBase ( const MemDump *const *first, const MemDump *const *last );
+
     static std::vector<MemDumpPtr> setParents ( const std::vector<MemDumpPtr>& ptrs, const MemDumpBase *parent );
+
+    static std::vector<MemDumpPtr> mergePtrs ( const MemDump *const *first, const MemDump *const *last,
+                                               const MemDumpBase *parent );
     static std::vector<MemDumpPtr> addOffsets ( const std::vector<MemDumpPtr>& ptrs, size_t addSrcOffset );
     static std::vector<MemDumpPtr> concat ( const std::vector<MemDumpPtr>& a, const std::vector<MemDumpPtr>& b );
 };
@@ -154,6 +162,10 @@ public:
         ASSERT ( a.addr + a.size == b.addr );
     }
 
+    // Merge constructor for a sorted range of continuous memory dumps, this copies each child pointer once
+    MemDump ( const MemDump *const *first, const MemDump *const *last )
+        : MemDumpBase ( first, last ), addr ( ( *first )->addr ) {}
+
     // Get the starting address of this memory dump
     char *getAddr() const override { return addr; }
 
@@ -162,6 +174,151 @@ public:
 };
 
 
+// Maximum depth of pointer chains in a memory dump plan
+#define MEMDUMP_MAX_DEPTH ( 8 )
+
+
+// A single memory dump op, which copies from a static address or from a pointer located in the parent op's memory
+struct MemDumpOp
+{
+    // Pointer depth, 0 for a static address, otherwise the parent is the last op with depth - 1
+    uint32_t depth;
+
+    // The static address if depth is 0, otherwise the location of the pointer's value from the parent's address
+    size_t src;
+
+    // The offset to add to the pointer's value
+    size_t dst;
+
+    // Number of bytes to copy
+    size_t size;
+};
+
+
+// Flat versioned layout of a memory dump plan, which can be used in place from the linked resource data.
+// This is a MemDumpHeader, followed by numOps MemDumpRecords, followed by the MD5 of all the preceding bytes.
+#define MEMDUMP_MAGIC   ( 0x444D4343u ) // "CCMD"
+#define MEMDUMP_VERSION ( 1 )
+
+struct MemDumpHeader
+{
+    uint32_t magic, version, numOps, totalSize;
+};
+
+// On disk MemDumpOp, with the same layout as MemDumpOp on 32-bit targets
+struct MemDumpRecord
+{
+    uint32_t depth, src, dst, size;
+};
+
+
+// Memory dumps compiled into a flat list of ops, in the same order as the recursive walk
+class MemDumpPlan
+{
+public:
+
+    // List of ops in dump order, these point to either the compiled ops or the loaded data
+    const MemDumpOp *ops = 0;
+    size_t numOps = 0;
+
+    // Total size of the memory dump
+    size_t totalSize = 0;
+
+    MemDumpPlan() {}
+
+    MemDumpPlan ( const MemDumpPlan& other ) { *this = other; }
+
+    MemDumpPlan& operator= ( const MemDumpPlan& other );
+
+    // Clear all ops
+    void clear()
+    {
+        ops = 0;
+        numOps = totalSize = 0;
+        _ops.clear();
+    }
+
+    // True only if there are no ops
+    bool empty() const
+    {
+        return ( numOps == 0 );
+    }
+
+    // Number of bytes allocated for the ops, 0 if they are used in place from the loaded data
+    size_t getHeapSize() const
+    {
+        return _ops.capacity() * sizeof ( MemDumpOp );
+    }
+
+    // Compile a list of memory dumps, returns false if a pointer chain is too deep
+    bool compile ( const std::vector<MemDump>& addrs );
+
+    // Save / load the whole memory dump to / from the given pointer
+    void saveDump ( char *dump ) const;
+    void loadDump ( const char *dump ) const;
+
+    // Scan the whole memory dump for changes against the previous dump
+    void scanDump ( ChangeDetector& detector, const char *prev, std::vector<ChangedRange>& changed ) const;
+
+    // Run each op in order, calling func ( addr, size, offset ) with the resolved address, which may be null
+    template<typename F>
+    void run ( const F& func ) const
+    {
+        char *addrs[MEMDUMP_MAX_DEPTH];
+        size_t offset = 0;
+
+        for ( const MemDumpOp *op = ops; op != ops + numOps; ++op )
+        {
+            char *addr;
+
+            if ( op->depth == 0 )
+            {
+                addr = ( char * ) op->src;
+            }
+            else
+            {
+                const char *parent = addrs[op->depth - 1];
+
+                addr = ( parent ? * ( char ** ) ( parent + op->src ) : 0 );
+
+                if ( addr )
+                    addr += op->dst;
+            }
+
+            addrs[op->depth] = addr;
+
+            func ( addr, op->size, offset );
+
+            offset += op->size;
+        }
+    }
+
+    // Serialization with the flat layout. Loading uses the data in place if possible, so the data must outlive this.
+    // Data in the old MemDumpList format is also loaded, by compiling it.
+    void save ( std::string& data ) const;
+    bool save ( const std::string& filename ) const;
+    bool load ( const char *data, size_t size );
+
+private:
+
+    // Compiled or copied ops, empty if the ops are used in place
+    std::vector<MemDumpOp> _ops;
+
+    bool compile ( const MemDumpBase& mem, uint32_t depth, size_t src, size_t dst );
+};
+
+
+// Overlapping address ranges found when updating a MemDumpList
+struct MemDumpOverlap
+{
+    // The merged range before the overlap, and the range that overlaps it
+    const char *firstAddr;
+    size_t firstSize;
+    const char *secondAddr;
+    size_t secondSize;
+};
+
+
 class MemDumpList
 {
 public:
@@ -172,11 +329,19 @@ public:
     // List of memory dumps
     std::vector<MemDump> addrs;
 
+    // Memory dumps compiled for saving / loading, only valid after calling update() or load()
+    MemDumpPlan plan;
+
+    // Overlapping address ranges, only valid after calling update()
+    std::vector<MemDumpOverlap> overlaps;
+
     // Clear all addresses
     void clear()
     {
         totalSize = 0;
         addrs.clear();
+        plan.clear();
+        overlaps.clear();
     }
 
     // True only if addrs.empty()
@@ -211,7 +376,8 @@ public:
             append ( addr, addAddrOffset );
     }
 
-    // Update the list of memory dumps: merge continuous address ranges, then compute total size
+    // Update the list of memory dumps: merge continuous address ranges, compute total size, then compile the plan.
+    // This sorts once and merges in a single pass, overlapping ranges are not merged but added to overlaps.
     void update();
 
     // Serialization
@@ -0,0 +1,227 @@
+#include "MemKernels.hpp"
+
+#include <cpuid.h>
+#include <emmintrin.h>
+
+#include <cstring>
+
+using namespace std;
+
+
+#define SSE2 __attribute__ ( ( target ( "sse2" ) ) )
+
+
+namespace MemKernels
+{
+
+bool isSse2Supported()
+{
+    unsigned eax, ebx, ecx, edx;
+
+    if ( ! __get_cpuid ( 1, &eax, &ebx, &ecx, &edx ) )
+        return false;
+
+    return ( edx & bit_SSE2 );
+}
+
+bool useSse2 = isSse2Supported();
+
+
+static inline size_t firstSetBit ( uint32_t mask )
+{
+    return __builtin_ctz ( mask );
+}
+
+
+SSE2 static void copySse2 ( char *dst, const char *src, size_t len )
+{
+    if ( len < 64 )
+    {
+        memcpy ( dst, src, len );
+        return;
+    }
+
+    // Copy the unaligned head, then use aligned stores
+    size_t i = ( 16 - ( ( uintptr_t ) dst & 15 ) ) & 15;
+
+    memcpy ( dst, src, i );
+
+    for ( ; i + 64 <= len; i += 64 )
+    {
+        const __m128i a = _mm_loadu_si128 ( ( const __m128i * ) ( src + i ) );
+        const __m128i b = _mm_loadu_si128 ( ( const __m128i * ) ( src + i + 16 ) );
+        const __m128i c = _mm_loadu_si128 ( ( const __m128i * ) ( src + i + 32 ) );
+        const __m128i d = _mm_loadu_si128 ( ( const __m128i * ) ( src + i + 48 ) );
+
+        _mm_store_si128 ( ( __m128i * ) ( dst + i ), a );
+        _mm_store_si128 ( ( __m128i * ) ( dst + i + 16 ), b );
+        _mm_store_si128 ( ( __m128i * ) ( dst + i + 32 ), c );
+        _mm_store_si128 ( ( __m128i * ) ( dst + i + 48 ), d );
+    }
+
+    for ( ; i + 16 <= len; i += 16 )
+        _mm_store_si128 ( ( __m128i * ) ( dst + i ), _mm_loadu_si128 ( ( const __m128i * ) ( src + i ) ) );
+
+    memcpy ( dst + i, src + i, len - i );
+}
+
+void copy ( void *dst, const void *src, size_t len )
+{
+    if ( useSse2 )
+        copySse2 ( ( char * ) dst, ( const char * ) src, len );
+    else
+        memcpy ( dst, src, len );
+}
+
+
+SSE2 static size_t orRowsSse2 ( uint8_t *dst, const uint8_t *const *rows, size_t numRows, size_t len )
+{
+    size_t i = 0;
+
+    for ( ; i + 16 <= len; i += 16 )
+    {
+        __m128i acc = _mm_loadu_si128 ( ( const __m128i * ) ( dst + i ) );
+
+        for ( size_t r = 0; r < numRows; ++r )
+            acc = _mm_or_si128 ( acc, _mm_loadu_si128 ( ( const __m128i * ) ( rows[r] + i ) ) );
+
+        _mm_storeu_si128 ( ( __m128i * ) ( dst + i ), acc );
+    }
+
+    return i;
+}
+
+void orRows ( uint8_t *dst, const uint8_t *const *rows, size_t numRows, size_t len )
+{
+    size_t i = ( useSse2 ? orRowsSse2 ( dst, rows, numRows, len ) : 0 );
+
+    for ( uint32_t acc, word; i + sizeof ( acc ) <= len; i += sizeof ( acc ) )
+    {
+        memcpy ( &acc, dst + i, sizeof ( acc ) );
+
+        for ( size_t r = 0; r < numRows; ++r )
+        {
+            memcpy ( &word, rows[r] + i, sizeof ( word ) );
+            acc |= word;
+        }
+
+        memcpy ( dst + i, &acc, sizeof ( acc ) );
+    }
+
+    for ( ; i < len; ++i )
+    {
+        for ( size_t r = 0; r < numRows; ++r )
+            dst[i] |= rows[r][i];
+    }
+}
+
+
+SSE2 static size_t firstDifferenceSse2 ( const char *a, const char *b, size_t len )
+{
+    size_t i = 0;
+
+    for ( ; i + 16 <= len; i += 16 )
+    {
+        const __m128i eq = _mm_cmpeq_epi8 ( _mm_loadu_si128 ( ( const __m128i * ) ( a + i ) ),
+                                            _mm_loadu_si128 ( ( const __m128i * ) ( b + i ) ) );
+
+        const uint32_t mask = ( ~_mm_movemask_epi8 ( eq ) ) & 0xFFFF;
+
+        if ( mask )
+            return i + firstSetBit ( mask );
+    }
+
+    return i;
+}
+
+size_t firstDifference ( const void *a, const void *b, size_t len )
+{
+    const char *x = ( const char * ) a;
+    const char *y = ( const char * ) b;
+
+    size_t i = ( useSse2 ? firstDifferenceSse2 ( x, y, len ) : 0 );
+
+    for ( uint32_t u, v; i + sizeof ( u ) <= len; i += sizeof ( u ) )
+    {
+        memcpy ( &u, x + i, sizeof ( u ) );
+        memcpy ( &v, y + i, sizeof ( v ) );
+
+        if ( u != v )
+            break;
+    }
+
+    while ( i < len && x[i] == y[i] )
+        ++i;
+
+    return i;
+}
+
+
+SSE2 static size_t findByteSse2 ( const char *src, size_t len, uint8_t value )
+{
+    const __m128i needle = _mm_set1_epi8 ( value );
+
+    size_t i = 0;
+
+    for ( ; i + 16 <= len; i += 16 )
+    {
+        const uint32_t mask = _mm_movemask_epi8 (
+                                  _mm_cmpeq_epi8 ( _mm_loadu_si128 ( ( const __m128i * ) ( src + i ) ), needle ) );
+
+        if ( mask )
+            return i + firstSetBit ( mask );
+    }
+
+    return i;
+}
+
+size_t findByte ( const void *src, size_t len, uint8_t value )
+{
+    const uint8_t *bytes = ( const uint8_t * ) src;
+
+    size_t i = ( useSse2 ? findByteSse2 ( ( const char * ) src, len, value ) : 0 );
+
+    while ( i < len && bytes[i] != value )
+        ++i;
+
+    return i;
+}
+
+size_t firstDifference16 ( const uint16_t *a, const uint16_t *b, size_t n )
+{
+    // The first differing byte is in the first differing word
+    return firstDifference ( a, b, n * sizeof ( uint16_t ) ) / sizeof ( uint16_t );
+}
+
+
+SSE2 static size_t findNotEqual16Sse2 ( const uint16_t *src, size_t n, uint16_t value )
+{
+    const __m128i needle = _mm_set1_epi16 ( value );
+
+    size_t i = 0;
+
+    for ( ; i + 8 <= n; i += 8 )
+    {
+        const __m128i eq = _mm_cmpeq_epi16 ( _mm_loadu_si128 ( ( const __m128i * ) ( src + i ) ), needle );
+
+        // Each word sets two bits of the mask
+        const uint32_t mask = ( ~_mm_movemask_epi8 ( eq ) ) & 0xFFFF;
+
+        if ( mask )
+            return i + firstSetBit ( mask ) / 2;
+    }
+
+    return i;
+}
+
+size_t findNotEqual16 ( const uint16_t *src, size_t n, uint16_t value )
+{
+    size_t i = ( useSse2 ? findNotEqual16Sse2 ( src, n, value ) : 0 );
+
+    while ( i < n && src[i] == value )
+        ++i;
+
+    return i;
+}
+
+}
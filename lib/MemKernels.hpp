@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+
+// Bulk memory kernels, with SSE2 paths selected at runtime and a scalar fallback
+namespace MemKernels
+{
+
+// True if the SSE2 paths are used, defaults to whether the CPU supports SSE2
+extern bool useSse2;
+
+// True if the CPU supports SSE2
+bool isSse2Supported();
+
+// Copy len bytes from src to dst, the ranges must not overlap
+void copy ( void *dst, const void *src, size_t len );
+
+// OR each of the numRows rows of len bytes into dst
+void orRows ( uint8_t *dst, const uint8_t *const *rows, size_t numRows, size_t len );
+
+// Find the index of the first differing byte, returns len if the ranges are equal
+size_t firstDifference ( const void *a, const void *b, size_t len );
+
+// Find the index of the first byte equal to value, returns len if not found
+size_t findByte ( const void *src, size_t len, uint8_t value );
+
+// Find the index of the first differing 16-bit word, returns n if the ranges are equal
+size_t firstDifference16 ( const uint16_t *a, const uint16_t *b, size_t n );
+
+// Find the index of the first 16-bit word not equal to value, returns n if all are equal
+size_t findNotEqual16 ( const uint16_t *src, size_t n, uint16_t value );
+
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "Thread.hpp"
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+
+// Maximum number of free blocks kept per block size, any extra blocks are returned to the heap
+#define MESSAGE_POOL_MAX_FREE ( 256 )
+
+
+// Total number of blocks that any BlockPool had to take from the heap, for checking that the pools are reused
+inline std::atomic<size_t>& getNumPoolHeapBlocks()
+{
+    static std::atomic<size_t> numHeapBlocks ( 0 );
+    return numHeapBlocks;
+}
+
+
+// Free list of fixed size memory blocks, shared by all types with the same block size.
+// Freed blocks are reused by the next allocation, so steady state allocations never reach the heap.
+template<size_t SIZE>
+class BlockPool
+{
+    union Block
+    {
+        Block *next;
+        char bytes[SIZE];
+    };
+
+public:
+
+    // The pool is never destroyed, since messages can outlive static destruction
+    static BlockPool& get()
+    {
+        static BlockPool *pool = new BlockPool();
+        return *pool;
+    }
+
+    void *allocate()
+    {
+        LOCK ( _mutex );
+
+        if ( ! _free )
+        {
+            ++getNumPoolHeapBlocks();
+            return ::operator new ( sizeof ( Block ) );
+        }
+
+        Block *block = _free;
+        _free = block->next;
+        --_numFree;
+        return block;
+    }
+
+    void deallocate ( void *ptr )
+    {
+        LOCK ( _mutex );
+
+        if ( _numFree >= MESSAGE_POOL_MAX_FREE )
+        {
+            ::operator delete ( ptr );
+            return;
+        }
+
+        Block *block = ( Block * ) ptr;
+        block->next = _free;
+        _free = block;
+        ++_numFree;
+    }
+
+    size_t getNumFree() const { return _numFree; }
+
+private:
+
+    Mutex _mutex;
+
+    Block *_free = 0;
+
+    size_t _numFree = 0;
+
+    BlockPool() {}
+};
+
+
+// Allocator that takes single objects from the BlockPool for their size.
+// Used with std::allocate_shared, so the object and its shared_ptr control block are one pooled block.
+template<typename T>
+struct PoolAllocator
+{
+    typedef T value_type;
+
+    PoolAllocator() {}
+
+    template<typename U>
+    PoolAllocator ( const PoolAllocator<U>& ) {}
+
+    T *allocate ( size_t n )
+    {
+        if ( n != 1 )
+            return ( T * ) ::operator new ( n * sizeof ( T ) );
+
+        return ( T * ) BlockPool<sizeof ( T )>::get().allocate();
+    }
+
+    void deallocate ( T *ptr, size_t n )
+    {
+        if ( n != 1 )
+            ::operator delete ( ptr );
+        else
+            BlockPool<sizeof ( T )>::get().deallocate ( ptr );
+    }
+
+    template<typename U>
+    bool operator== ( const PoolAllocator<U>& ) const { return true; }
+
+    template<typename U>
+    bool operator!= ( const PoolAllocator<U>& ) const { return false; }
+};
+
+
+// Create a message in pooled memory, which goes back to the pool when the last reference is dropped
+template<typename T, typename ... Args>
+inline std::shared_ptr<T> makePooled ( Args&& ... args )
+{
+    return std::allocate_shared<T> ( PoolAllocator<T>(), std::forward<Args> ( args )... );
+}
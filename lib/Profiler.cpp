@@ -0,0 +1,187 @@
+#include "Profiler.hpp"
+#include "StringUtils.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <fstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+using namespace std;
+
+
+static const char *sectionNames[] =
+{
+    "RollbackSave",
+    "RollbackLoad",
+    "FrameStepNormal",
+    "FrameStepRerun",
+    "SocketCheck",
+    "PresentFrameEnd",
+};
+
+static_assert ( sizeof ( sectionNames ) / sizeof ( sectionNames[0] ) == Profiler::NumSections,
+                "sectionNames must have a name for each section" );
+
+// Short names for the overlay
+static const char *sectionLabels[] = { "save", "load", "step", "rerun", "socket", "present" };
+
+static_assert ( sizeof ( sectionLabels ) / sizeof ( sectionLabels[0] ) == Profiler::NumSections,
+                "sectionLabels must have a label for each section" );
+
+
+bool Profiler::enabled = false;
+
+uint64_t Profiler::getTicks()
+{
+#ifdef _WIN32
+    uint64_t ticks;
+    QueryPerformanceCounter ( ( LARGE_INTEGER * ) &ticks );
+    return ticks;
+#else
+    timespec ts;
+    clock_gettime ( CLOCK_MONOTONIC, &ts );
+    return uint64_t ( ts.tv_sec ) * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+uint64_t Profiler::getTicksPerSecond()
+{
+#ifdef _WIN32
+    static uint64_t ticksPerSecond = 0;
+
+    if ( ! ticksPerSecond )
+        QueryPerformanceFrequency ( ( LARGE_INTEGER * ) &ticksPerSecond );
+
+    return ticksPerSecond;
+#else
+    return 1000000000ULL;
+#endif
+}
+
+const char *Profiler::getName ( Section section )
+{
+    ASSERT ( section < NumSections );
+
+    return sectionNames[section];
+}
+
+Profiler::Profiler()
+{
+    reset();
+}
+
+void Profiler::clearSlot ( uint32_t frame )
+{
+    for ( auto& time : _slots[frame % NUM_PROFILER_FRAMES] )
+        time.store ( 0, memory_order_relaxed );
+}
+
+void Profiler::add ( Section section, uint64_t ticks )
+{
+    ASSERT ( section < NumSections );
+
+    const uint32_t microseconds = uint32_t ( ( ticks * 1000000ULL ) / getTicksPerSecond() );
+    const uint32_t frame = _frame.load ( memory_order_acquire );
+
+    _slots[frame % NUM_PROFILER_FRAMES][section].fetch_add ( microseconds, memory_order_relaxed );
+}
+
+void Profiler::nextFrame()
+{
+    const uint32_t frame = _frame.load ( memory_order_relaxed ) + 1;
+
+    clearSlot ( frame );
+
+    _frame.store ( frame, memory_order_release );
+
+    if ( _numFrames + 1 < NUM_PROFILER_FRAMES )
+        ++_numFrames;
+}
+
+void Profiler::reset()
+{
+    for ( uint32_t i = 0; i < NUM_PROFILER_FRAMES; ++i )
+        clearSlot ( i );
+
+    _frame.store ( 0, memory_order_release );
+    _numFrames = 0;
+}
+
+uint32_t Profiler::getPercentile ( Section section, double fraction ) const
+{
+    ASSERT ( section < NumSections );
+
+    const uint32_t count = min<uint32_t> ( _numFrames, PROFILER_WINDOW );
+
+    if ( count == 0 )
+        return 0;
+
+    // Only finished frames, the current frame is still being written
+    const uint32_t frame = _frame.load ( memory_order_acquire );
+
+    array<uint32_t, PROFILER_WINDOW> times;
+
+    for ( uint32_t i = 0; i < count; ++i )
+        times[i] = _slots[( frame - 1 - i ) % NUM_PROFILER_FRAMES][section].load ( memory_order_relaxed );
+
+    const uint32_t n = min<uint32_t> ( count - 1, uint32_t ( fraction * count ) );
+
+    nth_element ( times.begin(), times.begin() + n, times.begin() + count );
+
+    return times[n];
+}
+
+string Profiler::str() const
+{
+    string text;
+
+    for ( uint8_t i = 0; i < NumSections; ++i )
+    {
+        const Section section = Section ( i );
+
+        text += format ( "%s%s=%u/%u", ( i ? " " : "" ), sectionLabels[i],
+                         getPercentile ( section, 0.5 ), getPercentile ( section, 0.99 ) );
+    }
+
+    return text;
+}
+
+bool Profiler::saveCsv ( const string& file ) const
+{
+    ofstream fout ( file.c_str() );
+
+    if ( ! fout.good() )
+        return false;
+
+    fout << "frame";
+
+    for ( const char *name : sectionNames )
+        fout << ',' << name;
+
+    fout << '\n';
+
+    const uint32_t frame = _frame.load ( memory_order_acquire );
+
+    for ( uint32_t i = frame - _numFrames; i != frame; ++i )
+    {
+        fout << i;
+
+        for ( const auto& time : _slots[i % NUM_PROFILER_FRAMES] )
+            fout << ',' << time.load ( memory_order_relaxed );
+
+        fout << '\n';
+    }
+
+    return fout.good();
+}
+
+Profiler& Profiler::get()
+{
+    static Profiler instance;
+    return instance;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <string>
+
+
+// Number of frames kept by the profiler, these are written to the CSV file
+#define NUM_PROFILER_FRAMES     ( 3600 )
+
+// Number of most recent frames used for the rolling percentiles
+#define PROFILER_WINDOW         ( 120 )
+
+
+// Scope the profiler to the current block
+#define PROFILE_SCOPE(SECTION)  ProfilerScope _profilerScope ( Profiler::SECTION )
+
+
+// Lightweight profiler for hot path sections. Each frame has a slot with the total time spent in each section,
+// which can be written from any thread without locking. Frames are advanced by the game thread.
+class Profiler
+{
+public:
+
+    // Sections that are timed, nested sections are included in the time of the outer section
+    enum Section : uint8_t
+    {
+        RollbackSave,
+        RollbackLoad,
+        FrameStepNormal,
+        FrameStepRerun,
+        SocketCheck,
+        PresentFrameEnd,
+        NumSections
+    };
+
+    // Add the time spent in a section to the current frame
+    void add ( Section section, uint64_t ticks );
+
+    // Finish the current frame, the oldest frame slot is reused for the next frame
+    void nextFrame();
+
+    // Clear all frames
+    void reset();
+
+    // Get the percentile of the time spent in a section per frame, over the most recent frames, in microseconds
+    uint32_t getPercentile ( Section section, double fraction ) const;
+
+    // Get the rolling p50 / p99 of each section
+    std::string str() const;
+
+    // Write the time spent in each section of each kept frame, returns false if the file couldn't be written
+    bool saveCsv ( const std::string& file ) const;
+
+    // Get the name of a section
+    static const char *getName ( Section section );
+
+    // Get the current high resolution time in ticks, and the number of ticks per second
+    static uint64_t getTicks();
+    static uint64_t getTicksPerSecond();
+
+    // Get the singleton instance
+    static Profiler& get();
+
+    // Whether profiler scopes are recorded, only enabled in the DLL, which is the only place that advances frames
+    static bool enabled;
+
+private:
+
+    // Time spent in each section in microseconds
+    typedef std::array<std::atomic<uint32_t>, NumSections> Slot;
+
+    std::array<Slot, NUM_PROFILER_FRAMES> _slots;
+
+    // Index of the current frame, and the number of finished frames kept
+    std::atomic<uint32_t> _frame;
+    uint32_t _numFrames = 0;
+
+    Profiler();
+
+    void clearSlot ( uint32_t frame );
+};
+
+
+// Scoped timer that adds the time spent in the enclosing scope to a section
+class ProfilerScope
+{
+public:
+
+    ProfilerScope ( Profiler::Section section )
+        : _section ( section ), _start ( Profiler::enabled ? Profiler::getTicks() : 0 ) {}
+
+    ~ProfilerScope()
+    {
+        if ( _start )
+            Profiler::get().add ( _section, Profiler::getTicks() - _start );
+    }
+
+private:
+
+    const Profiler::Section _section;
+
+    // Start time, 0 if the profiler was disabled
+    const uint64_t _start;
+};
@@ -2,12 +2,61 @@
 #include "Protocol.include.hpp"
 #include "Protocol.inlineimpl.hpp"
 #include "Compression.hpp"
+#include "MessagePool.hpp"
 #include "Logger.hpp"
 #include "Enum.hpp"
 
+#include <cstring>
+
 using namespace std;
 using namespace cereal;
 
+// Output stream buffer that appends to a string, so the string's capacity is reused between messages
+class StringOutputBuffer : public streambuf
+{
+public:
+
+    StringOutputBuffer ( string& str ) : _str ( str ) {}
+
+protected:
+
+    int_type overflow ( int_type c ) override
+    {
+        if ( c != traits_type::eof() )
+            _str.push_back ( traits_type::to_char_type ( c ) );
+
+        return traits_type::not_eof ( c );
+    }
+
+    streamsize xsputn ( const char *bytes, streamsize len ) override
+    {
+        _str.append ( bytes, len );
+        return len;
+    }
+
+private:
+
+    string& _str;
+};
+
+// Input stream buffer that reads directly from an existing array of bytes, without copying them
+class ArrayInputBuffer : public streambuf
+{
+public:
+
+    ArrayInputBuffer ( const char *bytes, size_t len )
+    {
+        char *begin = const_cast<char *> ( bytes );
+        setg ( begin, begin, begin + len );
+    }
+
+    // The next bytes to read, for reading directly without the stream
+    const char *next() const { return gptr(); }
+
+    void skip ( size_t len ) { gbump ( len ); }
+};
+
+
 // Useful options for debugging and testing
 // #define LOG_PROTOCOL
 // #define FORCE_COMPRESSION
@@ -17,38 +66,73 @@ using namespace cereal;
 
 /* Message binary structure:
 
+Framed:
+
+    1 byte  frame marker
+    4 byte  message size
+    ...     compressed or not compressed message
+
 Compressed:
 
     1 byte  message type
-    1 byte  compression level
+    1 byte  compression level (lower 4 bits) + checksum type (upper 4 bits)
     4 byte  uncompressed size
     4 byte  compressed data size
     ...     compressed data
             ========================
             ...     raw data
-            16 byte hash
+            16 byte MD5 hash / 4 byte checksum
             ========================
 
 Not compressed:
 
     1 byte  message type
-    1 byte  compression level
+    1 byte  compression level (0) + checksum type (upper 4 bits)
     ========================
     ...     raw data
-    16 byte hash
+    16 byte MD5 hash / 4 byte checksum
     ========================
 
 */
 
 
-// Encode with compression
-string encodeStageTwo ( const MsgPtr& msg, const string& msgData );
+// Number of bytes for the message type and compression level at the start of each message
+#define MESSAGE_HEADER_SIZE ( 2 )
+
+// The compression level byte also contains the checksum type, which is 0 (MD5) for older versions
+#define COMPRESSION_LEVEL_MASK ( 0x0F )
+#define CHECKSUM_TYPE_SHIFT ( 4 )
+
+// Compress the message data after the header at pos in the buffer, if needed
+void encodeStageTwo ( const MsgPtr& msg, string& buffer, size_t pos );
 
 // Result of the decode
 ENUM ( DecodeResult, Failed, NotCompressed, Compressed );
 
-// Decode with compression. Must manually update the value of consumed if the data was not compressed.
-DecodeResult decodeStageTwo ( const char *bytes, size_t len, size_t& consumed, MsgType& type, string& msgData );
+// Maximum uncompressed message size that is decompressed on the stack
+#define DECOMPRESS_STACK_SIZE ( 1024 )
+
+// Buffer for decompressed message data, only larger messages are decompressed on the heap
+struct DecompressBuffer
+{
+    char stack[DECOMPRESS_STACK_SIZE];
+
+    string heap;
+
+    char *get ( size_t size )
+    {
+        if ( size <= sizeof ( stack ) )
+            return stack;
+
+        heap.resize ( size );
+        return &heap[0];
+    }
+};
+
+// Decode with compression, data points to the message data in either bytes or buffer.
+// Must manually update the value of consumed if the data was not compressed.
+DecodeResult decodeStageTwo ( const char *bytes, size_t len, size_t& consumed, MsgType& type, ChecksumType& checksum,
+                              const char *& data, size_t& dataLen, DecompressBuffer& buffer );
 
 
 string Protocol::encode ( const Serializable& message )
@@ -68,39 +152,115 @@ string Protocol::encode ( Serializable *message )
 
 string Protocol::encode ( const MsgPtr& msg )
 {
+    string buffer;
+    encode ( msg, buffer );
+    return buffer;
+}
+
+size_t Protocol::encode ( const Serializable& message, string& buffer, ChecksumType checksum )
+{
+    MsgPtr msg ( const_cast<Serializable *> ( &message ), ignoreMsgPtr );
+    return encode ( msg, buffer, checksum );
+}
+
+size_t Protocol::encode ( const MsgPtr& msg, string& buffer, ChecksumType checksum )
+{
+    buffer.clear();
+
     if ( ! msg.get() )
-        return "";
+        return 0;
+
+    return encodeAt ( msg, buffer, 0, checksum );
+}
+
+size_t Protocol::encodeFrame ( const MsgPtr& msg, string& buffer, ChecksumType checksum )
+{
+    buffer.clear();
+
+    if ( ! msg.get() )
+        return 0;
+
+    // Encode the message after the space for the frame header, then fill in the header
+    buffer.resize ( FRAME_HEADER_SIZE );
+
+    const uint32_t size = encodeAt ( msg, buffer, FRAME_HEADER_SIZE, checksum ) - FRAME_HEADER_SIZE;
+
+    buffer[0] = char ( FRAME_MARKER );
+    memcpy ( &buffer[1], &size, sizeof ( size ) );
+    return buffer.size();
+}
+
+size_t Protocol::getFrameSize ( const char *header )
+{
+    ASSERT ( uint8_t ( header[0] ) == FRAME_MARKER );
+
+    uint32_t size;
+    memcpy ( &size, &header[1], sizeof ( size ) );
+    return FRAME_HEADER_SIZE + size;
+}
+
+size_t Protocol::encodeAt ( const MsgPtr& msg, string& buffer, size_t pos, ChecksumType checksum )
+{
+    ASSERT ( buffer.size() == pos );
+
+    const MsgType type = msg->getMsgType();
+    const uint8_t flags = ( ( msg->compressionLevel & COMPRESSION_LEVEL_MASK )
+                            | ( uint8_t ( checksum ) << CHECKSUM_TYPE_SHIFT ) );
 
-    ostringstream ss ( stringstream::binary );
-    BinaryOutputArchive archive ( ss );
+    if ( const size_t fixedSize = msg->getFixedSize() )
+    {
+        // Fixed layout messages are written directly into the buffer, so no stream or archive is needed
+        const size_t baseSize = msg->getFixedBaseSize();
+        buffer.resize ( pos + MESSAGE_HEADER_SIZE + baseSize + fixedSize );
+
+        char *const dst = &buffer[pos];
+        dst[0] = char ( type );
+        dst[1] = char ( flags );
+        msg->saveFixedBase ( dst + MESSAGE_HEADER_SIZE );
+        msg->saveFixed ( dst + MESSAGE_HEADER_SIZE + baseSize );
+    }
+    else
+    {
+        StringOutputBuffer streamBuffer ( buffer );
+        ostream os ( &streamBuffer );
+        BinaryOutputArchive archive ( os );
+
+        // Encode the header, the message data is encoded directly after it
+        archive ( type );
+        archive ( flags );
 
-    // Encode base message data
-    msg->saveBase ( archive );
+        // Encode base message data
+        msg->saveBase ( archive );
 
-    // Encode actual message data
-    msg->save ( archive );
+        // Encode actual message data
+        msg->save ( archive );
+    }
 
 #ifndef DISABLE_UPDATE_HASH
-    // Update the hash
-    if ( msg->_hashValid )
+    // Update the hash, also if it was cached for a different checksum type
+    if ( msg->_hashValid || msg->_hashType != checksum )
     {
-        getMD5 ( ss.str(), &msg->_hash[0] );
+        const size_t headerEnd = pos + MESSAGE_HEADER_SIZE;
+
+        Checksum::calculate ( checksum, &buffer[headerEnd], buffer.size() - headerEnd, &msg->_hash[0] );
         msg->_hashValid = false;
+        msg->_hashType = checksum;
 
 #ifdef LOG_PROTOCOL
-        LOG ( "%s", msg->getMsgType() );
-        if ( ss.str().size() <= 256 )
-            LOG ( "data=[ %s ]", formatAsHex ( ss.str() ) );
-        LOG ( "hash=[ %s ]", formatAsHex ( msg->_hash, msg->_hash.size() ) );
+        LOG ( "%s", type );
+        if ( buffer.size() <= 256 + headerEnd )
+            LOG ( "data=[ %s ]", formatAsHex ( &buffer[headerEnd], buffer.size() - headerEnd ) );
+        LOG ( "hash=[ %s ]", formatAsHex ( msg->_hash, Checksum::getSize ( checksum ) ) );
 #endif
     }
 #endif // NOT DISABLE_UPDATE_HASH
 
     // Encode hash at the end of message data
-    archive ( msg->_hash );
+    buffer.append ( &msg->_hash[0], Checksum::getSize ( checksum ) );
 
     // Encode with compression
-    return encodeStageTwo ( msg, ss.str() );
+    encodeStageTwo ( msg, buffer, pos );
+    return buffer.size();
 }
 
 MsgPtr Protocol::decode ( const char *bytes, size_t len, size_t& consumed )
@@ -114,10 +274,13 @@ MsgPtr Protocol::decode ( const char *bytes, size_t len, size_t& consumed )
     }
 
     MsgType type;
-    string data;
+    ChecksumType checksum;
+    const char *data = 0;
+    size_t dataLen = 0;
+    DecompressBuffer buffer;
 
     // Decode with compression
-    DecodeResult result = decodeStageTwo ( bytes, len, consumed, type, data );
+    DecodeResult result = decodeStageTwo ( bytes, len, consumed, type, checksum, data, dataLen, buffer );
 
 #ifdef LOG_PROTOCOL
     LOG ( "decodeStageTwo: result=%s", result );
@@ -130,12 +293,13 @@ MsgPtr Protocol::decode ( const char *bytes, size_t len, size_t& consumed )
     }
 
 #ifdef LOG_PROTOCOL
-    if ( data.size() <= 256 )
-        LOG ( "decodeStageTwo: data=[ %s ]", formatAsHex ( data ) );
+    if ( dataLen <= 256 )
+        LOG ( "decodeStageTwo: data=[ %s ]", formatAsHex ( data, dataLen ) );
 #endif
 
-    istringstream ss ( data, stringstream::binary );
-    BinaryInputArchive archive ( ss );
+    ArrayInputBuffer streamBuffer ( data, dataLen );
+    istream is ( &streamBuffer );
+    BinaryInputArchive archive ( is );
 
     try
     {
@@ -152,12 +316,26 @@ MsgPtr Protocol::decode ( const char *bytes, size_t len, size_t& consumed )
         // Decode base message data
         msg->loadBase ( archive );
 
-        // Decode actual message data
-        msg->load ( archive );
+        // Decode actual message data, fixed layout messages are read directly from the data
+        if ( const size_t fixedSize = msg->getFixedSize() )
+        {
+            const size_t remaining = streamBuffer.in_avail();
+
+            if ( remaining < fixedSize )
+                throw cereal::Exception ( format ( "fixedSize=%u; remaining=%u", fixedSize, remaining ) );
+
+            msg->loadFixed ( streamBuffer.next() );
+            streamBuffer.skip ( fixedSize );
+        }
+        else
+        {
+            msg->load ( archive );
+        }
 
         // Decode hash at end of message data
-        archive ( msg->_hash );
+        archive ( binary_data ( &msg->_hash[0], Checksum::getSize ( checksum ) ) );
         msg->_hashValid = false;
+        msg->_hashType = checksum;
     }
     catch ( const cereal::Exception& exc )
     {
@@ -187,31 +365,33 @@ MsgPtr Protocol::decode ( const char *bytes, size_t len, size_t& consumed )
         return NullMsg;
     }
 
-    size_t dataSize = data.size();
+    size_t dataSize = dataLen;
 
     // decodeStageTwo does not update the value of consumed if the data was not compressed
     if ( result == DecodeResult::NotCompressed )
     {
         // Check for unread bytes
-        size_t remaining = ss.rdbuf()->in_avail();
+        size_t remaining = streamBuffer.in_avail();
         ASSERT ( len >= remaining );
         consumed = ( len - remaining );
-        dataSize = ( data.size() - remaining );
+        dataSize = ( dataLen - remaining );
     }
 
 #ifndef DISABLE_UPDATE_HASH
+    const size_t hashSize = Checksum::getSize ( checksum );
+
     // Check if the hash is correct
-    if ( ! checkMD5 ( &data[0], dataSize - msg->_hash.size(), &msg->_hash[0] ) )
+    if ( ! Checksum::check ( checksum, data, dataSize - hashSize, &msg->_hash[0] ) )
     {
 #ifdef LOG_PROTOCOL
         LOG ( "hash check failed for %s", type );
-        LOG ( "data=[ %s ]", formatAsHex ( &data[0], dataSize - msg->_hash.size() ) );
-        LOG ( "hash    =[ %s ]", formatAsHex ( msg->_hash, msg->_hash.size() ) );
+        LOG ( "data=[ %s ]", formatAsHex ( data, dataSize - hashSize ) );
+        LOG ( "hash    =[ %s ]", formatAsHex ( msg->_hash, hashSize ) );
 
-        char hash[msg->_hash.size()];
-        gethash ( &data[0], dataSize - msg->_hash.size(), hash );
+        char hash[CHECKSUM_MAX_SIZE];
+        Checksum::calculate ( checksum, data, dataSize - hashSize, hash );
 
-        LOG ( "expected=[ %s ]", formatAsHex ( hash, msg->_hash.size() ) );
+        LOG ( "expected=[ %s ]", formatAsHex ( hash, hashSize ) );
 #endif
         return NullMsg;
     }
@@ -220,48 +400,64 @@ MsgPtr Protocol::decode ( const char *bytes, size_t len, size_t& consumed )
     return msg;
 }
 
-string encodeStageTwo ( const MsgPtr& msg, const string& msgData )
+void encodeStageTwo ( const MsgPtr& msg, string& buffer, size_t pos )
 {
-    ostringstream ss ( stringstream::binary );
-    BinaryOutputArchive archive ( ss );
+    if ( ! msg->compressionLevel )
+        return;
 
-    // Encode message type first without compression
-    archive ( msg->getMsgType() );
+    // Everything below is relative to the message header at pos
+    const size_t headerEnd = pos + MESSAGE_HEADER_SIZE;
 
-    // Compress message data if needed
-    if ( msg->compressionLevel )
-    {
-        string buffer ( compressBound ( msgData.size() ), ( char ) 0 );
-        size_t size = compress ( &msgData[0], msgData.size(), &buffer[0], buffer.size(), msg->compressionLevel );
-        buffer.resize ( size );
+    // Compressed messages replace the data with the uncompressed size, then the compressed size + compressed data
+    const size_t msgSize = buffer.size() - headerEnd;
+    const size_t sizesSize = sizeof ( uint32_t ) + sizeof ( size_type );
+
+    // Compress into the space after the message data, so no other buffer is needed
+    buffer.resize ( headerEnd + msgSize + sizesSize + compressBound ( msgSize ) );
+
+    char *const compressed = &buffer[headerEnd + msgSize + sizesSize];
+    const size_t size = compress ( &buffer[headerEnd], msgSize, compressed,
+                                   buffer.size() - ( headerEnd + msgSize + sizesSize ),
+                                   msg->compressionLevel );
 
-        // Only use compressed message data if actually smaller after the overhead
+    // Only use compressed message data if actually smaller after the overhead
 #ifndef FORCE_COMPRESSION
-        if ( sizeof ( msgData.size() ) + sizeof ( buffer.size() ) + buffer.size() < msgData.size() )
+    if ( size && sizesSize + size < msgSize )
+#else
+    if ( size )
 #endif
-        {
-            archive ( msg->compressionLevel );
-            archive ( msgData.size() );         // uncompressed size
-            archive ( buffer );                 // compressed size + compressed data
-            return ss.str();
-        }
+    {
+        const uint32_t uncompressedSize = msgSize;
+        const size_type compressedSize = size;
 
-        // Otherwise update compression level so we don't try to compress this again
-        msg->compressionLevel = 0;
+        char *const sizes = &buffer[headerEnd];
+
+        memcpy ( sizes, &uncompressedSize, sizeof ( uncompressedSize ) );
+        memcpy ( sizes + sizeof ( uncompressedSize ), &compressedSize, sizeof ( compressedSize ) );
+        memmove ( sizes + sizesSize, compressed, size );
+
+        buffer.resize ( headerEnd + sizesSize + size );
+        return;
     }
 
+    // Otherwise update compression level so we don't try to compress this again
+    msg->compressionLevel = 0;
+
     // uncompressed data does not include uncompressedSize or any other sizes
-    archive ( msg->compressionLevel );
-    return ss.str() + msgData;
+    buffer.resize ( headerEnd + msgSize );
+    buffer[headerEnd - 1] &= ~COMPRESSION_LEVEL_MASK;
 }
 
-DecodeResult decodeStageTwo ( const char *bytes, size_t len, size_t& consumed, MsgType& type, string& msgData )
+DecodeResult decodeStageTwo ( const char *bytes, size_t len, size_t& consumed, MsgType& type, ChecksumType& checksum,
+                              const char *& data, size_t& dataLen, DecompressBuffer& buffer )
 {
-    istringstream ss ( string ( bytes, len ), stringstream::binary );
-    BinaryInputArchive archive ( ss );
+    ArrayInputBuffer streamBuffer ( bytes, len );
+    istream is ( &streamBuffer );
+    BinaryInputArchive archive ( is );
 
     uint8_t compressionLevel;
     uint32_t uncompressedSize;
+    size_type compressedSize;
 
     try
     {
@@ -269,11 +465,21 @@ DecodeResult decodeStageTwo ( const char *bytes, size_t len, size_t& consumed, M
         archive ( type );
         archive ( compressionLevel );
 
+        // Split the checksum type from the compression level
+        checksum = ChecksumType ( compressionLevel >> CHECKSUM_TYPE_SHIFT );
+        compressionLevel &= COMPRESSION_LEVEL_MASK;
+
+        if ( checksum > ChecksumType::XXHash32 )
+        {
+            consumed = 0;
+            return DecodeResult::Failed;
+        }
+
         // Only compressed data includes uncompressedSize + a compressed data buffer
         if ( compressionLevel )
         {
             archive ( uncompressedSize );       // uncompressed size
-            archive ( msgData );                // compressed size + compressed data
+            archive ( compressedSize );         // compressed size, the compressed data is read in place
         }
     }
     catch ( const cereal::Exception& exc )
@@ -302,14 +508,21 @@ DecodeResult decodeStageTwo ( const char *bytes, size_t len, size_t& consumed, M
     }
 
     // Get remaining bytes
-    size_t remaining = ss.rdbuf()->in_avail();
+    size_t remaining = streamBuffer.in_avail();
     ASSERT ( len >= remaining );
 
     // Decompress message data if needed
     if ( compressionLevel )
     {
-        string buffer ( uncompressedSize, ( char ) 0 );
-        size_t size = uncompress ( &msgData[0], msgData.size(), &buffer[0], buffer.size() );
+        // Wait for the rest of the compressed data
+        if ( remaining < compressedSize )
+        {
+            consumed = 0;
+            return DecodeResult::Failed;
+        }
+
+        char *const uncompressed = buffer.get ( uncompressedSize );
+        size_t size = uncompress ( &bytes[len - remaining], compressedSize, uncompressed, uncompressedSize );
 
         if ( size != uncompressedSize )
         {
@@ -318,14 +531,15 @@ DecodeResult decodeStageTwo ( const char *bytes, size_t len, size_t& consumed, M
         }
 
         // Update consumed bytes
-        consumed = len - remaining;
-        msgData = buffer;
+        consumed = len - remaining + compressedSize;
+        data = uncompressed;
+        dataLen = uncompressedSize;
         return DecodeResult::Compressed;
     }
 
-    // Get remaining bytes
-    msgData.resize ( remaining );
-    ss.rdbuf()->sgetn ( &msgData[0], remaining );
+    // Uncompressed data is read directly from the remaining bytes
+    data = &bytes[len - remaining];
+    dataLen = remaining;
     return DecodeResult::NotCompressed;
 }
 
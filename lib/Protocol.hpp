@@ -1,6 +1,8 @@
 #pragma once
 
 #include "Enum.hpp"
+#include "Checksum.hpp"
+#include "FixedLayout.hpp"
 
 #include <cereal/archives/binary.hpp>
 
@@ -23,7 +25,10 @@
 #define PROTOCOL_MESSAGE_BOILERPLATE(NAME, ...)                                                             \
     EMPTY_MESSAGE_BOILERPLATE(NAME)                                                                         \
     void save ( cereal::BinaryOutputArchive& ar ) const override { ar ( __VA_ARGS__ ); }                    \
-    void load ( cereal::BinaryInputArchive& ar ) override { ar ( __VA_ARGS__ ); }
+    void load ( cereal::BinaryInputArchive& ar ) override { ar ( __VA_ARGS__ ); }                           \
+    size_t getFixedSize() const override { return FixedLayout::size ( __VA_ARGS__ ); }                      \
+    void saveFixed ( char *dst ) const override { FixedLayout::save ( dst, __VA_ARGS__ ); }                 \
+    void loadFixed ( const char *src ) override { FixedLayout::load ( src, __VA_ARGS__ ); }
 
 #define CEREAL_CLASS_BOILERPLATE(...)                                                                       \
     void save ( cereal::BinaryOutputArchive& ar ) const { ar ( __VA_ARGS__ ); }                             \
@@ -40,6 +45,14 @@ enum class MsgType : uint8_t
     LastType
 };
 
+// Framed messages start with this byte instead of the message type, followed by the 4 byte message size
+#define FRAME_MARKER ( 0xFF )
+
+// Number of bytes for the frame marker and message size before each framed message
+#define FRAME_HEADER_SIZE ( 5 )
+
+static_assert ( uint8_t ( MsgType::LastType ) < FRAME_MARKER, "The frame marker must not be a valid message type" );
+
 // Base message type
 ENUM ( BaseType, SerializableMessage, SerializableSequence );
 
@@ -68,6 +81,20 @@ public:
     static std::string encode ( Serializable *message );
     static std::string encode ( const MsgPtr& msg );
 
+    // Encode a message into the given buffer, replacing its contents, and return the number of bytes.
+    // The buffer's capacity is reused, so this doesn't allocate once the buffer fits the largest message.
+    // Checksums other than MD5 should only be used if the remote negotiated ClientMode::FastChecksum.
+    static size_t encode ( const Serializable& message, std::string& buffer,
+                           ChecksumType checksum = ChecksumType::MD5 );
+    static size_t encode ( const MsgPtr& msg, std::string& buffer, ChecksumType checksum = ChecksumType::MD5 );
+
+    // Encode a message after a frame header with its size, so a stream reader can tell when it has fully arrived.
+    // Framed messages should only be sent if the remote negotiated ClientMode::FramedMessages.
+    static size_t encodeFrame ( const MsgPtr& msg, std::string& buffer, ChecksumType checksum = ChecksumType::MD5 );
+
+    // Get the total number of bytes of a framed message, including the FRAME_HEADER_SIZE bytes of the header
+    static size_t getFrameSize ( const char *header );
+
     // Decode a series of bytes into a message, consumed indicates the number of bytes read.
     // This returns null if the message failed to decode, NOTE consumed will still be updated.
     static MsgPtr decode ( const char *bytes, size_t len, size_t& consumed );
@@ -76,6 +103,11 @@ public:
     {
         return ( type > MsgType::FirstType && type < MsgType::LastType );
     }
+
+private:
+
+    // Encode a message into the buffer after the first pos bytes, which are kept
+    static size_t encodeAt ( const MsgPtr& msg, std::string& buffer, size_t pos, ChecksumType checksum );
 };
 
 
@@ -99,6 +131,12 @@ public:
     virtual void save ( cereal::BinaryOutputArchive& ar ) const {}
     virtual void load ( cereal::BinaryInputArchive& ar ) {}
 
+    // Fixed layout serialization, which writes the same bytes as save without an archive.
+    // Only messages where every field has a fixed size support this, otherwise getFixedSize returns 0.
+    virtual size_t getFixedSize() const { return 0; }
+    virtual void saveFixed ( char *dst ) const {}
+    virtual void loadFixed ( const char *src ) {}
+
     // Cast this to another another type
     template<typename T> T& getAs() { return *static_cast<T *> ( this ); }
     template<typename T> const T& getAs() const { return *static_cast<const T *> ( this ); }
@@ -114,16 +152,23 @@ public:
 
 private:
 
-    typedef std::array<char, 16> HashType;
+    typedef std::array<char, CHECKSUM_MAX_SIZE> HashType;
 
     // Cached hash data
     mutable HashType _hash;
     mutable bool _hashValid = true;
 
+    // Checksum type of the cached hash data
+    mutable ChecksumType _hashType = ChecksumType::MD5;
+
     // Serialize and deserialize the base type
     virtual void saveBase ( cereal::BinaryOutputArchive& ar ) const {}
     virtual void loadBase ( cereal::BinaryInputArchive& ar ) {}
 
+    // Fixed layout serialization of the base type, which writes the same bytes as saveBase
+    virtual size_t getFixedBaseSize() const { return 0; }
+    virtual void saveFixedBase ( char *dst ) const {}
+
     friend struct Protocol;
     friend struct SerializableMessage;
     friend struct SerializableSequence;
@@ -174,4 +219,7 @@ private:
 
     void saveBase ( cereal::BinaryOutputArchive& ar ) const override { ar ( _sequence ); };
     void loadBase ( cereal::BinaryInputArchive& ar ) override { ar ( _sequence ); };
+
+    size_t getFixedBaseSize() const override { return sizeof ( _sequence ); }
+    void saveFixedBase ( char *dst ) const override { memcpy ( dst, &_sequence, sizeof ( _sequence ) ); }
 };
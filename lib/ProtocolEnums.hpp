@@ -32,3 +32,5 @@ VersionConfig,
 JoysticksChanged,
 TransitionIndex,
 PaletteManager,
+DeltaInputs,
+TimelineIndex,
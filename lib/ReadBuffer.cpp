@@ -0,0 +1,141 @@
+#include "ReadBuffer.hpp"
+#include "Logger.hpp"
+
+#include <cstring>
+
+using namespace std;
+
+
+#define READ_BUFFER_SIZE ( 1024 * 4096 )
+
+
+void ReadBuffer::reset()
+{
+    _buffer.reserve ( READ_BUFFER_SIZE );
+    _buffer.resize ( READ_BUFFER_SIZE, ( char ) 0 );
+    _start = _end = _frameSize = 0;
+}
+
+void ReadBuffer::free()
+{
+    _buffer.clear();
+    _buffer.shrink_to_fit();
+    _start = _end = _frameSize = 0;
+}
+
+void ReadBuffer::assign ( const char *bytes, size_t len )
+{
+    reset();
+
+    if ( len > _buffer.size() )
+        _buffer.resize ( len );
+
+    memcpy ( &_buffer[0], bytes, len );
+    _end = len;
+}
+
+char *ReadBuffer::getSpace ( size_t& len )
+{
+    // Only move the unconsumed bytes once at least half the buffer is used up,
+    // which is rare since the buffer is rewound whenever all the bytes are consumed.
+    if ( _start && _buffer.size() - _end < _buffer.size() / 2 )
+        compact();
+
+    ASSERT ( _end < _buffer.size() );
+
+    len = _buffer.size() - _end;
+    return &_buffer[_end];
+}
+
+void ReadBuffer::commit ( size_t len )
+{
+    ASSERT ( _end + len <= _buffer.size() );
+
+    _end += len;
+}
+
+void ReadBuffer::consume ( size_t len )
+{
+    if ( len == 0 )
+        return;
+
+    ASSERT ( len <= getSize() );
+
+    _start += len;
+
+    // Rewind to the front when everything was consumed, which doesn't need to move anything
+    if ( _start == _end )
+        _start = _end = 0;
+}
+
+void ReadBuffer::compact()
+{
+    memmove ( &_buffer[0], &_buffer[_start], _end - _start );
+    _end -= _start;
+    _start = 0;
+}
+
+MsgPtr ReadBuffer::decode ( size_t& consumed )
+{
+    for ( ;; )
+    {
+        consumed = 0;
+
+        if ( getSize() == 0 )
+            return NullMsg;
+
+        const char *data = getData();
+
+        // Unframed messages are decoded from all the unconsumed bytes, like older versions
+        if ( uint8_t ( data[0] ) != FRAME_MARKER )
+        {
+            if ( ! Protocol::checkMsgType ( MsgType ( data[0] ) ) )
+            {
+                LOG ( "Clearing invalid buffer!" );
+                reset();
+                return NullMsg;
+            }
+
+            MsgPtr msg = Protocol::decode ( data, getSize(), consumed );
+            consume ( consumed );
+            return msg;
+        }
+
+        // Parse the frame header once, after that only wait until the whole frame has arrived
+        if ( ! _frameSize )
+        {
+            if ( getSize() < FRAME_HEADER_SIZE )
+                return NullMsg;
+
+            _frameSize = Protocol::getFrameSize ( data );
+
+            if ( _frameSize > _buffer.size() )
+            {
+                LOG ( "Clearing buffer for frame of [ %u bytes ]", _frameSize );
+                reset();
+                return NullMsg;
+            }
+        }
+
+        if ( getSize() < _frameSize )
+            return NullMsg;
+
+        const size_t frameSize = _frameSize;
+        const size_t msgSize = frameSize - FRAME_HEADER_SIZE;
+        size_t msgConsumed = 0;
+
+        MsgPtr msg = Protocol::decode ( data + FRAME_HEADER_SIZE, msgSize, msgConsumed );
+
+        _frameSize = 0;
+        consume ( frameSize );
+
+        if ( msg.get() && msgConsumed == msgSize )
+        {
+            consumed = frameSize;
+            return msg;
+        }
+
+        // The frame size says where the next message starts, so a bad message doesn't stall the stream
+        LOG ( "Skipping invalid frame of [ %u bytes ]", frameSize );
+    }
+}
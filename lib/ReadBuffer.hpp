@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Protocol.hpp"
+
+#include <string>
+
+
+// Read buffer for a stream of messages, with a cursor for the consumed bytes, so decoding doesn't shift the buffer.
+// The unconsumed bytes are only moved to the front when the space after them gets small.
+// Framed messages are decoded once all their bytes have arrived, using the size from the already parsed header.
+class ReadBuffer
+{
+public:
+
+    // Allocate the buffer at its full size and clear it
+    void reset();
+
+    // Free the buffer
+    void free();
+
+    // Replace the contents with the given unconsumed bytes
+    void assign ( const char *bytes, size_t len );
+
+    // Get the space for the next read, len is set to the number of bytes available
+    char *getSpace ( size_t& len );
+
+    // Add the given number of bytes that were read into the space
+    void commit ( size_t len );
+
+    // Get the unconsumed bytes
+    const char *getData() const { return &_buffer[_start]; }
+    size_t getSize() const { return _end - _start; }
+
+    // Consume bytes from the front of the unconsumed bytes
+    void consume ( size_t len );
+
+    // Decode the next message, consumed is the number of bytes used. Returns null if more bytes are needed.
+    // The buffer is cleared if it doesn't start with a message, and framed messages that fail to decode are skipped.
+    MsgPtr decode ( size_t& consumed );
+
+private:
+
+    std::string _buffer;
+
+    // Range of the unconsumed bytes
+    size_t _start = 0, _end = 0;
+
+    // Total size of the frame at the start, if its header was already parsed, otherwise 0
+    size_t _frameSize = 0;
+
+    // Move the unconsumed bytes to the front of the buffer
+    void compact();
+};
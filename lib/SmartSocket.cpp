@@ -336,8 +336,9 @@ void SmartSocket::socketRead ( Socket *socket, const char *buffer, size_t len, c
 {
     ASSERT ( socket == _vpsSocket.get() );
 
-    _vpsSocket->_readPos += len;
-    LOG ( "Read [ %u bytes ] from '%s'; %u bytes remaining in buffer", len, address, _vpsSocket->_readPos );
+    _vpsSocket->_readBuffer.commit ( len );
+    LOG ( "Read [ %u bytes ] from '%s'; %u bytes remaining in buffer",
+          len, address, _vpsSocket->_readBuffer.getSize() );
 
     if ( len > 0 && len <= 256 )
         LOG ( "Hex: %s", formatAsHex ( buffer, len ) );
@@ -348,7 +349,7 @@ void SmartSocket::socketRead ( Socket *socket, const char *buffer, size_t len, c
 
     for ( ;; )
     {
-        id = MatchInfo::decode ( &_vpsSocket->_readBuffer[0], _vpsSocket->_readPos, consumed );
+        id = MatchInfo::decode ( _vpsSocket->_readBuffer.getData(), _vpsSocket->_readBuffer.getSize(), consumed );
 
         if ( id )
         {
@@ -360,7 +361,7 @@ void SmartSocket::socketRead ( Socket *socket, const char *buffer, size_t len, c
             continue;
         }
 
-        tun = TunInfo::decode ( &_vpsSocket->_readBuffer[0], _vpsSocket->_readPos, consumed );
+        tun = TunInfo::decode ( _vpsSocket->_readBuffer.getData(), _vpsSocket->_readBuffer.getSize(), consumed );
 
         if ( tun.matchId )
         {
@@ -572,6 +573,26 @@ SocketPtr SmartSocket::accept ( Socket::Owner *owner )
     return socket;
 }
 
+void SmartSocket::setChecksumType ( ChecksumType type )
+{
+    Socket::setChecksumType ( type );
+
+    if ( _directSocket )
+        _directSocket->setChecksumType ( type );
+
+    if ( _tunSocket )
+        _tunSocket->setChecksumType ( type );
+}
+
+void SmartSocket::setFramed ( bool framed )
+{
+    Socket::setFramed ( framed );
+
+    // Only the direct socket can be TCP, the tunnel is always UDP
+    if ( _directSocket )
+        _directSocket->setFramed ( framed );
+}
+
 #define BOILERPLATE_SEND(...)                                                           \
     do {                                                                                \
         if ( ! isConnected() )                                                          \
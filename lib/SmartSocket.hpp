@@ -43,6 +43,12 @@ public:
     // If this client UDP socket is connected over the UDP tunnel
     bool isTunnel() const;
 
+    // Set the checksum for both the direct and tunnel sockets
+    void setChecksumType ( ChecksumType type ) override;
+
+    // Set if the direct socket frames sent messages
+    void setFramed ( bool framed ) override;
+
     // Send raw bytes directly, a return value of false indicates socket is disconnected
     bool send ( const char *buffer, size_t len );
     bool send ( const char *buffer, size_t len, const IpAddrPort& address );
@@ -18,8 +18,6 @@
 using namespace std;
 
 
-#define READ_BUFFER_SIZE ( 1024 * 4096 )
-
 #define SET_NON_BLOCKING_MODE(VALUE)                                                                                \
     do {                                                                                                            \
         u_long flag = VALUE;                                                                                        \
@@ -345,37 +343,23 @@ int Socket::recvfrom ( char *buffer, size_t& len, IpAddrPort& address )
 
 void Socket::resetBuffer()
 {
-    _readBuffer.reserve ( READ_BUFFER_SIZE );
-    _readBuffer.resize ( READ_BUFFER_SIZE, ( char ) 0 );
-    _readPos = 0;
+    _readBuffer.reset();
 }
 
 void Socket::freeBuffer()
 {
-    _readBuffer.clear();
-    _readBuffer.shrink_to_fit();
-    _readPos = 0;
+    _readBuffer.free();
 }
 
 void Socket::consumeBuffer ( size_t bytes )
 {
-    if ( bytes == 0 )
-        return;
-
-    // Erase the consumed bytes (shifting the array)
-    ASSERT ( bytes <= _readPos );
-    _readBuffer.erase ( 0, bytes );
-    _readBuffer.reserve ( READ_BUFFER_SIZE );
-    _readBuffer.resize ( READ_BUFFER_SIZE, ( char ) 0 );
-    _readPos -= bytes;
+    _readBuffer.consume ( bytes );
 }
 
 void Socket::socketRead()
 {
-    ASSERT ( _readPos < _readBuffer.size() );
-
-    char *bufferStart = &_readBuffer[_readPos];
-    size_t bufferLen = _readBuffer.size() - _readPos;
+    size_t bufferLen = 0;
+    char *bufferStart = _readBuffer.getSpace ( bufferLen );
 
     IpAddrPort address = getRemoteAddress();
     int error = 0;
@@ -428,9 +412,9 @@ void Socket::socketRead()
         return;
     }
 
-    // Increment the buffer position
-    _readPos += bufferLen;
-    LOG ( "Read [ %u bytes ] from '%s'; %u bytes remaining in buffer", bufferLen, address, _readPos );
+    // Add the read bytes to the buffer
+    _readBuffer.commit ( bufferLen );
+    LOG ( "Read [ %u bytes ] from '%s'; %u bytes remaining in buffer", bufferLen, address, _readBuffer.getSize() );
 
     // Handle zero byte packets
     if ( bufferLen == 0 )
@@ -443,26 +427,18 @@ void Socket::socketRead()
     if ( bufferLen <= 256 )
         LOG ( "Hex: %s", formatAsHex ( bufferStart, bufferLen ) );
 
-    // Check if the first byte is a valid message type
-    if ( _readPos >= sizeof ( MsgType ) && ! ::Protocol::checkMsgType ( * ( MsgType * ) &_readBuffer[0] ) )
-    {
-        LOG ( "Clearing invalid buffer!" );
-        resetBuffer();
-        return;
-    }
-
-    // Try to decode as many messages from the buffer as possible
+    // Try to decode as many messages from the buffer as possible, this also clears the buffer if it's invalid
     for ( ;; )
     {
         size_t consumedBytes = 0;
-        MsgPtr msg = ::Protocol::decode ( &_readBuffer[0], _readPos, consumedBytes );
-        consumeBuffer ( consumedBytes );
+        MsgPtr msg = _readBuffer.decode ( consumedBytes );
 
         // Abort if a message could not be decoded
         if ( ! msg.get() )
             return;
 
-        LOG ( "Decoded '%s' using [ %u bytes ]; %u bytes remaining in buffer", msg, consumedBytes, _readPos );
+        LOG ( "Decoded '%s' using [ %u bytes ]; %u bytes remaining in buffer",
+              msg, consumedBytes, _readBuffer.getSize() );
         socketRead ( msg, address );
 
         // Abort if the socket is de-allocated
@@ -499,7 +475,10 @@ MsgPtr Socket::share ( int processId )
     LOG ( "Sharing:" );
     LOG ( "address='%s'; protocol=%s; state=%s", address, protocol, _state );
 
-    return MsgPtr ( new SocketShareData ( address, protocol, _readBuffer, _readPos, _state, info ) );
+    // Only the unconsumed bytes are shared
+    const string readBuffer ( _readBuffer.getData(), _readBuffer.getSize() );
+
+    return MsgPtr ( new SocketShareData ( address, protocol, readBuffer, readBuffer.size(), _state, info ) );
 }
 
 SocketShareData::SocketShareData ( const IpAddrPort& address,
@@ -2,6 +2,7 @@
 
 #include "IpAddrPort.hpp"
 #include "GoBackN.hpp"
+#include "ReadBuffer.hpp"
 #include "Enum.hpp"
 
 #include <vector>
@@ -116,6 +117,14 @@ public:
     // Set the check sum fail percentage for testing purposes
     void setCheckSumFail ( uint8_t percentage );
 
+    // Set the checksum for sent messages, anything other than MD5 requires the remote to support it
+    virtual void setChecksumType ( ChecksumType type ) { _checksumType = type; }
+    ChecksumType getChecksumType() const { return _checksumType; }
+
+    // Set if sent messages are framed, which requires the remote to support it, only affects TCP sockets
+    virtual void setFramed ( bool framed ) { _isFramed = framed; }
+    bool isFramed() const { return _isFramed; }
+
     // Cast this to another socket type
     TcpSocket& getAsTCP();
     const TcpSocket& getAsTCP() const;
@@ -135,13 +144,19 @@ public:
 
 protected:
 
-    // Socket read buffer
-    std::string _readBuffer;
+    // Socket read buffer.
+    // In raw mode, read bytes should be manually committed, otherwise each read will be at the same position.
+    // In message mode, this is automatically managed, and is only reset when the buffer is invalid.
+    ReadBuffer _readBuffer;
+
+    // Buffer that messages are encoded into before sending, reused so sending doesn't allocate
+    std::string _sendBuffer;
+
+    // Checksum for sent messages
+    ChecksumType _checksumType = ChecksumType::MD5;
 
-    // The position for the next read event.
-    // In raw mode, this should be manually updated, otherwise each read will at the same position.
-    // In message mode, this is automatically managed, and is only reset when a decode fails.
-    size_t _readPos = 0;
+    // Frame sent messages with their size
+    bool _isFramed = false;
 
     // Raw socket type flag
     bool _isRaw = false;
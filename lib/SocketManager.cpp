@@ -3,6 +3,7 @@
 #include "TimerManager.hpp"
 #include "Exceptions.hpp"
 #include "ErrorStrings.hpp"
+#include "Profiler.hpp"
 
 #include <winsock2.h>
 #include <windows.h>
@@ -71,6 +72,9 @@ void SocketManager::check ( uint64_t timeout )
     if ( count == 0 )
         return;
 
+    // Only profile handling the socket events, not the time spent waiting in select
+    PROFILE_SCOPE ( SocketCheck );
+
     ASSERT ( TimerManager::get().isInitialized() == true );
     TimerManager::get().updateNow();
 
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <array>
+
+
+// Fixed size lock-free ring buffer between exactly one producer thread and one consumer thread.
+// The head is only written by the consumer and the tail only by the producer, so neither side takes a lock.
+// Multiple producers (or consumers) must be serialized externally, eg by a mutex on their side only.
+template<typename T, size_t N>
+class SpscRing
+{
+    static_assert ( N > 1 && ( N & ( N - 1 ) ) == 0, "N must be a power of 2" );
+
+public:
+
+    // Push an element from the producer thread, returns false and drops the element if full
+    bool push ( const T& t )
+    {
+        const size_t tail = _tail.load ( std::memory_order_relaxed );
+
+        if ( tail - _head.load ( std::memory_order_acquire ) == N )
+            return false;
+
+        _buffer[tail & ( N - 1 )] = t;
+        _tail.store ( tail + 1, std::memory_order_release );
+        return true;
+    }
+
+    // Pop the oldest element from the consumer thread, returns false if empty
+    bool pop ( T& t )
+    {
+        const size_t head = _head.load ( std::memory_order_relaxed );
+
+        if ( head == _tail.load ( std::memory_order_acquire ) )
+            return false;
+
+        t = _buffer[head & ( N - 1 )];
+        _head.store ( head + 1, std::memory_order_release );
+        return true;
+    }
+
+    // Approximate number of elements, exact only from the producer or consumer thread
+    size_t size() const
+    {
+        return _tail.load ( std::memory_order_acquire ) - _head.load ( std::memory_order_acquire );
+    }
+
+    bool empty() const { return ( size() == 0 ); }
+
+    static constexpr size_t capacity() { return N; }
+
+private:
+
+    std::array<T, N> _buffer;
+
+    // Keep the indices on separate cache lines, so the threads don't contend on the same line
+    alignas ( 64 ) std::atomic<size_t> _head { 0 };
+    alignas ( 64 ) std::atomic<size_t> _tail { 0 };
+};
@@ -2,10 +2,13 @@
 
 #include "Protocol.hpp"
 #include "Logger.hpp"
+#include "StringUtils.hpp"
 
 #include <cmath>
 #include <limits>
 #include <algorithm>
+#include <array>
+#include <string>
 
 
 // Template class to calculate stats with an online algorithm
@@ -100,3 +103,88 @@ private:
     double _sumOfSquaredDeltas = 0.0;
 };
 
+
+
+// Histogram of unsigned samples, the last bucket counts all samples that are too large for the others
+template<size_t N>
+class Histogram
+{
+public:
+
+    void addSample ( uint32_t value )
+    {
+        ++_counts[std::min<size_t> ( value, N - 1 )];
+        ++_count;
+    }
+
+    void reset()
+    {
+        _counts.fill ( 0 );
+        _count = 0;
+    }
+
+    // Halve all the counts, so older samples matter less than newer ones
+    void decay()
+    {
+        _count = 0;
+
+        for ( uint32_t& count : _counts )
+        {
+            count /= 2;
+            _count += count;
+        }
+    }
+
+    size_t getNumSamples() const
+    {
+        return _count;
+    }
+
+    uint32_t getCount ( size_t bucket ) const
+    {
+        return _counts[bucket];
+    }
+
+    // Smallest bucket that is at or above the given fraction of samples
+    uint32_t getPercentile ( double fraction ) const
+    {
+        const double target = fraction * _count;
+        size_t sum = 0;
+
+        for ( size_t i = 0; i < N; ++i )
+        {
+            sum += _counts[i];
+
+            if ( sum >= target )
+                return i;
+        }
+
+        return N - 1;
+    }
+
+    // Non-zero buckets formatted as "bucket:count", the last bucket is suffixed with "+"
+    std::string str() const
+    {
+        std::string result;
+
+        for ( size_t i = 0; i < N; ++i )
+        {
+            if ( ! _counts[i] )
+                continue;
+
+            if ( ! result.empty() )
+                result += ' ';
+
+            result += format ( "%u%s:%u", uint32_t ( i ), ( i + 1 == N ? "+" : "" ), _counts[i] );
+        }
+
+        return result;
+    }
+
+private:
+
+    std::array<uint32_t, N> _counts = {{ 0 }};
+
+    // Total number of samples
+    size_t _count = 0;
+};
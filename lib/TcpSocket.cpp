@@ -54,8 +54,7 @@ TcpSocket::TcpSocket ( Socket::Owner *owner, const SocketShareData& data )
 
     _connectTimeout = data.connectTimeout;
     _state = data.state;
-    _readBuffer = data.readBuffer;
-    _readPos = data.readPos;
+    _readBuffer.assign ( &data.readBuffer[0], data.readPos );
 
     ASSERT ( data.info->iSocketType == SOCK_STREAM );
     ASSERT ( data.info->iProtocol == IPPROTO_TCP );
@@ -128,14 +127,17 @@ bool TcpSocket::send ( SerializableSequence *message, const IpAddrPort& address
 
 bool TcpSocket::send ( const MsgPtr& msg, const IpAddrPort& address )
 {
-    const string buffer = ::Protocol::encode ( msg );
+    if ( _isFramed )
+        ::Protocol::encodeFrame ( msg, _sendBuffer, _checksumType );
+    else
+        ::Protocol::encode ( msg, _sendBuffer, _checksumType );
 
-    LOG ( "Encoded '%s' to [ %u bytes ]", msg, buffer.size() );
+    LOG ( "Encoded '%s' to [ %u bytes ]", msg, _sendBuffer.size() );
 
-    if ( !buffer.empty() && buffer.size() <= 256 )
-        LOG ( "Hex: %s", formatAsHex ( buffer ) );
+    if ( !_sendBuffer.empty() && _sendBuffer.size() <= 256 )
+        LOG ( "Hex: %s", formatAsHex ( _sendBuffer ) );
 
-    return Socket::send ( &buffer[0], buffer.size() );
+    return Socket::send ( &_sendBuffer[0], _sendBuffer.size() );
 }
 
 SocketPtr TcpSocket::shared ( Socket::Owner *owner, const SocketShareData& data )
@@ -54,8 +54,7 @@ UdpSocket::UdpSocket ( Socket::Owner *owner, const SocketShareData& data )
 
     _connectTimeout = data.connectTimeout;
     _state = data.state;
-    _readBuffer = data.readBuffer;
-    _readPos = data.readPos;
+    _readBuffer.assign ( &data.readBuffer[0], data.readPos );
 
     ASSERT ( data.info->iSocketType == SOCK_DGRAM );
     ASSERT ( data.info->iProtocol == IPPROTO_UDP );
@@ -271,20 +270,23 @@ bool UdpSocket::sendRaw ( const MsgPtr& msg, const IpAddrPort& address )
     }
 #endif // NOT RELEASE
 
-    const string buffer = ::Protocol::encode ( msg );
+    ::Protocol::encode ( msg, _sendBuffer, _checksumType );
 
-    LOG ( "Encoded '%s' to [ %u bytes ]", msg, buffer.size() );
+    LOG ( "Encoded '%s' to [ %u bytes ]", msg, _sendBuffer.size() );
 
-    if ( !buffer.empty() && buffer.size() <= 256 )
-        LOG ( "Hex: %s", formatAsHex ( buffer ) );
+    if ( !_sendBuffer.empty() && _sendBuffer.size() <= 256 )
+        LOG ( "Hex: %s", formatAsHex ( _sendBuffer ) );
 
     // Real UDP sockets send directly
     if ( isReal()  )
-        return Socket::send ( &buffer[0], buffer.size(), address.empty() ? this->address : address );
+        return Socket::send ( &_sendBuffer[0], _sendBuffer.size(), address.empty() ? this->address : address );
 
     // Child UDP sockets send via parent if not disconnected
     if ( isChild() && _parentSocket )
-        return _parentSocket->Socket::send ( &buffer[0], buffer.size(), address.empty() ? this->address : address );
+    {
+        return _parentSocket->Socket::send ( &_sendBuffer[0], _sendBuffer.size(),
+                                             address.empty() ? this->address : address );
+    }
 
     LOG_UDP_SOCKET ( this, "Cannot send over disconnected socket" );
     return false;
@@ -9,6 +9,9 @@
 // Number of frames of inputs to send per message
 #define NUM_INPUTS                  ( 30 )
 
+// Max number of frames of inputs to send per DeltaInputs message, at most NUM_INPUTS
+#define MAX_INPUTS_WINDOW           ( NUM_INPUTS )
+
 // Max allow rollback frames
 #define MAX_ROLLBACK                ( 15 )
 
@@ -19,6 +22,36 @@
 #define NUM_ROLLBACK_STATES         ( 256 )
 #endif
 
+// Number of rollback states between each full keyframe, the states in between are stored as deltas.
+// Set to 1 to store every state as a full keyframe.
+#define ROLLBACK_KEYFRAME_INTERVAL  ( 8 )
+
+// Size of the blocks used to detect changes between rollback states
+#define ROLLBACK_BLOCK_SIZE         ( 256 )
+
+// Number of keyframes to allocate for a pool of rollback states, enough for the pinned chain plus a partial chain
+#define NUM_ROLLBACK_KEYFRAMES(NUM_STATES) ( 2 + ( NUM_STATES ) / ROLLBACK_KEYFRAME_INTERVAL )
+
+// Number of newest rollback states that keep their keyframes uncompressed, older keyframes are compressed in the
+// background and uncompressed on demand when loading.
+#define ROLLBACK_RAW_STATES         ( MAX_ROLLBACK + 1 )
+
+// Number of uncompressed keyframes to allocate, enough for the newest raw states plus the one being saved
+#define NUM_ROLLBACK_RAW_KEYFRAMES  ( 3 + ROLLBACK_RAW_STATES / ROLLBACK_KEYFRAME_INTERVAL )
+
+// Minimum number of rollback states to allocate, NUM_ROLLBACK_STATES is the maximum.
+// The pool is sized between these on entering InGame, from the rollback distances measured so far.
+#define MIN_ROLLBACK_STATES         ( 2 * ROLLBACK_RAW_STATES )
+
+// Number of measured rollbacks needed before sizing the pool below the maximum
+#define MIN_ROLLBACK_SAMPLES        ( 100 )
+
+// Fraction of measured rollbacks the pool is sized to cover
+#define ROLLBACK_SIZING_PERCENTILE  ( 0.99 )
+
+// zlib compression level for older rollback keyframes
+#define ROLLBACK_COMPRESSION_LEVEL  ( 1 )
+
 
 // Game constants and addresses are prefixed CC
 #define CC_VERSION                  "1.4.0"
@@ -0,0 +1,85 @@
+#include "InputPredictor.hpp"
+#include "StringUtils.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+
+void InputPredictor::gotInput ( const uint16_t *inputs, size_t n, uint16_t actual )
+{
+    if ( n == 0 )
+        return;
+
+    _numHits += ( predict ( inputs, n ) == actual );
+    ++_numInputs;
+
+    train ( inputs, n, actual );
+}
+
+uint32_t MarkovPredictor::getState ( const uint16_t *inputs, size_t n )
+{
+    size_t run = 1;
+
+    while ( run < min<size_t> ( n, MARKOV_MAX_RUN ) && inputs[n - 1 - run] == inputs[n - 1] )
+        ++run;
+
+    return ( uint32_t ( run ) << 16 ) | inputs[n - 1];
+}
+
+uint16_t MarkovPredictor::predict ( const uint16_t *inputs, size_t n ) const
+{
+    const auto it = _best.find ( getState ( inputs, n ) );
+
+    if ( it == _best.end() )
+        return inputs[n - 1];
+
+    return it->second.first;
+}
+
+void MarkovPredictor::train ( const uint16_t *inputs, size_t n, uint16_t actual )
+{
+    const uint32_t state = getState ( inputs, n );
+    const uint32_t count = ++_counts [ ( uint64_t ( state ) << 16 ) | actual ];
+
+    pair<uint16_t, uint32_t>& best = _best[state];
+
+    if ( count > best.second )
+        best = { actual, count };
+}
+
+void MarkovPredictor::clear()
+{
+    _best.clear();
+    _counts.clear();
+}
+
+InputPredictors::InputPredictors()
+{
+    _predictors[0].reset ( new RepeatLastPredictor() );
+    _predictors[1].reset ( new HoldDirectionPredictor() );
+    _predictors[2].reset ( new MarkovPredictor() );
+}
+
+void InputPredictors::gotInput ( const uint16_t *inputs, size_t n, uint16_t actual )
+{
+    for ( const auto& predictor : _predictors )
+        predictor->gotInput ( inputs, n, actual );
+
+    // Only switch strategies when another one is strictly better
+    for ( size_t i = 0; i < _predictors.size(); ++i )
+    {
+        if ( _predictors[i]->getHitRate() > _predictors[_best]->getHitRate() )
+            _best = i;
+    }
+}
+
+string InputPredictors::str() const
+{
+    string str = format ( "predict=%s", getBest().name() );
+
+    for ( const auto& predictor : _predictors )
+        str += format ( "; %s=%.1f%%", predictor->name(), 100 * predictor->getHitRate() );
+
+    return str;
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+
+// Max number of previous inputs given to each prediction
+#define INPUT_PREDICTOR_HISTORY     ( 8 )
+
+// Inputs held longer than this are the same state in the Markov model
+#define MARKOV_MAX_RUN              ( 8 )
+
+
+// Predicts a missing remote input from the inputs before it, and keeps its own hit rate
+class InputPredictor
+{
+public:
+
+    virtual ~InputPredictor() {}
+
+    // Name of the prediction strategy
+    virtual const char *name() const = 0;
+
+    // Predict the input after the given previous inputs, oldest first, there is at least one previous input
+    virtual uint16_t predict ( const uint16_t *inputs, size_t n ) const = 0;
+
+    // Train with the actual input that followed the given previous inputs
+    virtual void train ( const uint16_t *inputs, size_t n, uint16_t actual ) {}
+
+    // Train and score this predictor with the actual input that followed the given previous inputs
+    void gotInput ( const uint16_t *inputs, size_t n, uint16_t actual );
+
+    // Get the fraction of inputs predicted correctly, and the number of inputs scored
+    double getHitRate() const { return ( _numInputs ? double ( _numHits ) / _numInputs : 0 ); }
+    uint32_t getNumInputs() const { return _numInputs; }
+
+    // Clear the hit rate
+    void resetHitRate() { _numHits = _numInputs = 0; }
+
+private:
+
+    uint32_t _numHits = 0, _numInputs = 0;
+};
+
+
+// Predicts the same input as the last input
+class RepeatLastPredictor : public InputPredictor
+{
+public:
+
+    const char *name() const override { return "RepeatLast"; }
+
+    uint16_t predict ( const uint16_t *inputs, size_t n ) const override { return inputs[n - 1]; }
+};
+
+
+// Predicts the last direction is still held, but all the buttons are released
+class HoldDirectionPredictor : public InputPredictor
+{
+public:
+
+    const char *name() const override { return "HoldDirection"; }
+
+    uint16_t predict ( const uint16_t *inputs, size_t n ) const override { return ( inputs[n - 1] & 0xF ); }
+};
+
+
+// Predicts the most frequent input after the last input and how long it was held, from the actual inputs so far.
+// Falls back to repeating the last input for states that were never seen.
+class MarkovPredictor : public InputPredictor
+{
+public:
+
+    const char *name() const override { return "Markov"; }
+
+    uint16_t predict ( const uint16_t *inputs, size_t n ) const override;
+
+    void train ( const uint16_t *inputs, size_t n, uint16_t actual ) override;
+
+    // Forget all the trained transitions
+    void clear();
+
+private:
+
+    // Mapping: state -> most frequent next input and its count
+    std::unordered_map<uint32_t, std::pair<uint16_t, uint32_t>> _best;
+
+    // Mapping: state and next input -> count
+    std::unordered_map<uint64_t, uint32_t> _counts;
+
+    // The state is the last input and the number of frames it was held
+    static uint32_t getState ( const uint16_t *inputs, size_t n );
+};
+
+
+// Predicts the inputs of one player with the strategy that has the best hit rate so far.
+// Every strategy is trained and scored on each actual input, by predicting it from the actual inputs before it.
+class InputPredictors
+{
+public:
+
+    InputPredictors();
+
+    // Train and score every strategy with the actual input that followed the given previous inputs
+    void gotInput ( const uint16_t *inputs, size_t n, uint16_t actual );
+
+    // Predict the input after the given previous inputs with the best strategy
+    uint16_t predict ( const uint16_t *inputs, size_t n ) const { return getBest().predict ( inputs, n ); }
+
+    // Get the strategy with the best hit rate, RepeatLast until any inputs were scored
+    const InputPredictor& getBest() const { return *_predictors[_best]; }
+
+    // Get all the strategies
+    const std::array<std::shared_ptr<InputPredictor>, 3>& getAll() const { return _predictors; }
+
+    // Get the hit rate of each strategy
+    std::string str() const;
+
+private:
+
+    std::array<std::shared_ptr<InputPredictor>, 3> _predictors;
+
+    size_t _best = 0;
+};
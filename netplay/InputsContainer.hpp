@@ -2,11 +2,30 @@
 
 #include "Constants.hpp"
 #include "Logger.hpp"
+#include "MemKernels.hpp"
 
+#include <array>
+#include <deque>
 #include <vector>
 #include <algorithm>
 
 
+// Number of frames of inputs in each chunk
+#define INPUTS_CHUNK_SIZE ( 256 )
+
+// Number of newest indices that are kept uncompressed
+#define INPUTS_HOT_INDICES ( 2 )
+
+// Number of runs of inputs between each random access point in a compressed index
+#define INPUTS_RUN_BLOCK ( 32 )
+
+
+// Inputs for each index:frame. The inputs of each index are stored in fixed size chunks of frames, and the indices
+// are stored in a ring, so erasing older indices doesn't move any inputs. Chunks of erased indices are reused,
+// so no memory is allocated once enough chunks have been allocated.
+//
+// Only the newest indices are kept in chunks. Older indices are run-length encoded, since inputs are usually held
+// for many frames, and their chunks are reused. Compressed indices can still be read, and are uncompressed if changed.
 template<typename T>
 class InputsContainer
 {
@@ -15,34 +34,123 @@ public:
     // Get a single input for the given index:frame, returns 0 if none.
     T get ( uint32_t index, uint32_t frame ) const
     {
-        if ( index >= _inputs.size() || _inputs[index].empty() )
+        if ( index >= _numIndices || at ( index ).size == 0 )
             return lastInputBefore ( index );
 
-        if ( frame >= _inputs[index].size() )
-            return _inputs[index].back();
+        const Index& inputs = at ( index );
+
+        if ( frame >= inputs.size )
+            return value ( inputs, inputs.size - 1 );
 
-        return _inputs[index][frame];
+        return value ( inputs, frame );
     }
 
     // Get n inputs starting from the given index:frame, ASSERTS if not enough.
     void get ( uint32_t index, uint32_t frame, T *t, size_t n ) const
     {
-        ASSERT ( index < _inputs.size() );
-        ASSERT ( frame + n <= _inputs[index].size() );
+        ASSERT ( index < _numIndices );
+        ASSERT ( frame + n <= at ( index ).size );
+
+        const Index& inputs = at ( index );
+
+        if ( inputs.isCompressed() )
+        {
+            uint32_t start;
+            size_t run = findRun ( inputs, frame, start );
+
+            for ( size_t i = 0; i < n; ++i, ++frame )
+            {
+                if ( frame >= start + inputs.runs[run].length )
+                    start += inputs.runs[run++].length;
+
+                t[i] = inputs.runs[run].value;
+            }
 
-        std::copy ( _inputs[index].begin() + frame,
-                    _inputs[index].begin() + frame + n, t );
+            return;
+        }
+
+        while ( n > 0 )
+        {
+            const size_t count = std::min<size_t> ( n, INPUTS_CHUNK_SIZE - frame % INPUTS_CHUNK_SIZE );
+            const T *src = &input ( inputs, frame );
+
+            std::copy ( src, src + count, t );
+
+            frame += count;
+            t += count;
+            n -= count;
+        }
+    }
+
+    // Contiguous inputs of a single index
+    struct Span
+    {
+        const T *data;
+        size_t size;
+
+        const T *begin() const { return data; }
+        const T *end() const { return data + size; }
+    };
+
+    // Get the contiguous inputs starting from the given index:frame, ASSERTS if not enough or compressed.
+    // Inputs are only contiguous within a chunk, so this returns fewer than n inputs at the end of a chunk.
+    Span getSpan ( uint32_t index, uint32_t frame, size_t n ) const
+    {
+        ASSERT ( index < _numIndices );
+        ASSERT ( frame + n <= at ( index ).size );
+        ASSERT ( ! at ( index ).isCompressed() );
+
+        const Index& inputs = at ( index );
+
+        return { &input ( inputs, frame ), std::min<size_t> ( n, INPUTS_CHUNK_SIZE - frame % INPUTS_CHUNK_SIZE ) };
+    }
+
+    // Call f ( const T *, size_t ) with each contiguous span of n inputs starting from the given index:frame,
+    // ASSERTS if not enough. Compressed indices are uncompressed into a buffer one chunk at a time.
+    template<typename F>
+    void forEachSpan ( uint32_t index, uint32_t frame, size_t n, F f ) const
+    {
+        ASSERT ( index < _numIndices );
+        ASSERT ( frame + n <= at ( index ).size );
+
+        if ( at ( index ).isCompressed() )
+        {
+            Chunk buffer;
+
+            while ( n > 0 )
+            {
+                const size_t count = std::min<size_t> ( n, buffer.size() );
+
+                get ( index, frame, &buffer[0], count );
+                f ( &buffer[0], count );
+
+                frame += count;
+                n -= count;
+            }
+
+            return;
+        }
+
+        while ( n > 0 )
+        {
+            const Span span = getSpan ( index, frame, n );
+
+            f ( span.data, span.size );
+
+            frame += span.size;
+            n -= span.size;
+        }
     }
 
     // Set a single input for the given index:frame, CANNOT change existing inputs.
     void set ( uint32_t index, uint32_t frame, T t )
     {
-        if ( _inputs.size() > index && _inputs[index].size() > frame )
+        if ( _numIndices > index && at ( index ).size > frame )
             return;
 
         resize ( index, frame );
 
-        _inputs[index][frame] = t;
+        input ( uncompressed ( index ), frame ) = t;
     }
 
     // Assign a single input for the given index:frame, CAN change existing inputs
@@ -50,7 +158,7 @@ public:
     {
         resize ( index, frame );
 
-        _inputs[index][frame] = t;
+        input ( uncompressed ( index ), frame ) = t;
     }
 
     // Fill n inputs with the same given value starting from the given index:frame, CAN change existing inputs.
@@ -58,8 +166,18 @@ public:
     {
         resize ( index, frame, n );
 
-        std::fill ( _inputs[index].begin() + frame,
-                    _inputs[index].begin() + frame + n, t );
+        Index& inputs = uncompressed ( index );
+
+        while ( n > 0 )
+        {
+            const size_t count = std::min<size_t> ( n, INPUTS_CHUNK_SIZE - frame % INPUTS_CHUNK_SIZE );
+            T *dst = &input ( inputs, frame );
+
+            std::fill ( dst, dst + count, t );
+
+            frame += count;
+            n -= count;
+        }
     }
 
     // Set n inputs starting from the given index:frame, CAN change existing inputs.
@@ -67,23 +185,30 @@ public:
     {
         if ( index >= checkStartingFromIndex )
         {
-            IndexedFrame f;
-            size_t i;
+            const size_t i = findChanged ( index, frame, t, n );
 
-            for ( i = 0, f = {{ frame, index }}; i < n; ++i, ++f.parts.frame )
+            // Indicate changed if the input is different from the last known input
+            if ( i < n )
             {
-                if ( get ( f.parts.index, f.parts.frame ) == t[i] )
-                    continue;
-
-                // Indicate changed if the input is different from the last known input
+                const IndexedFrame f = {{ uint32_t ( frame + i ), index }};
                 _lastChangedFrame.value = std::min ( _lastChangedFrame.value, f.value );
-                break;
             }
         }
 
         resize ( index, frame, n );
 
-        std::copy ( t, t + n, &_inputs[index][frame] );
+        Index& inputs = uncompressed ( index );
+
+        while ( n > 0 )
+        {
+            const size_t count = std::min<size_t> ( n, INPUTS_CHUNK_SIZE - frame % INPUTS_CHUNK_SIZE );
+
+            std::copy ( t, t + count, &input ( inputs, frame ) );
+
+            frame += count;
+            t += count;
+            n -= count;
+        }
     }
 
     // Resize the container so that it can contain inputs up to index:frame+n.
@@ -91,65 +216,80 @@ public:
     {
         T last = 0;
 
-        if ( index >= _inputs.size() )
+        if ( index >= _numIndices )
         {
-            last = lastInputBefore ( _inputs.size() );
-            _inputs.resize ( index + 1 );
+            last = lastInputBefore ( _numIndices );
+            resizeIndices ( index + 1 );
         }
-        else if ( ! _inputs[index].empty() )
+        else if ( at ( index ).size > 0 )
         {
-            last = _inputs[index].back();
+            last = value ( at ( index ), at ( index ).size - 1 );
         }
 
-        if ( frame + n > _inputs[index].size() )
-            _inputs[index].resize ( frame + n, last );
+        if ( frame + n > at ( index ).size )
+            resizeFrames ( uncompressed ( index ), frame + n, last );
     }
 
     void clear()
     {
-        _inputs.clear();
+        eraseIndices ( _numIndices );
     }
 
     bool empty() const
     {
-        return _inputs.empty();
+        return ( _numIndices == 0 );
     }
 
     bool empty ( size_t index ) const
     {
-        if ( index >= _inputs.size() )
+        if ( index >= _numIndices )
             return true;
 
-        return _inputs[index].empty();
+        return ( at ( index ).size == 0 );
     }
 
     uint32_t getEndIndex() const
     {
-        return _inputs.size();
+        return _numIndices;
     }
 
     uint32_t getEndFrame() const
     {
-        if ( _inputs.empty() )
+        if ( _numIndices == 0 )
             return 0;
 
-        return _inputs.back().size();
+        return at ( _numIndices - 1 ).size;
     }
 
     uint32_t getEndFrame ( size_t index ) const
     {
-        if ( index >= _inputs.size() )
+        if ( index >= _numIndices )
             return 0;
 
-        return _inputs[index].size();
+        return at ( index ).size;
     }
 
+    // Erase the given number of older indices, the remaining indices start from 0
     void eraseIndexOlderThan ( size_t index )
     {
-        if ( index + 1 >= _inputs.size() )
-            _inputs.clear();
+        if ( index + 1 >= _numIndices )
+            clear();
         else
-            _inputs.erase ( _inputs.begin(), _inputs.begin() + index );
+            eraseIndices ( index );
+    }
+
+    // Get the number of bytes used by the inputs, including unused chunks
+    size_t getMemorySize() const
+    {
+        size_t size = _chunks.size() * sizeof ( Chunk ) + _indices.capacity() * sizeof ( Index );
+
+        for ( const Index& inputs : _indices )
+        {
+            size += inputs.chunks.capacity() * sizeof ( uint32_t ) + inputs.runs.capacity() * sizeof ( Run )
+                    + inputs.blocks.capacity() * sizeof ( uint32_t );
+        }
+
+        return size;
     }
 
     IndexedFrame getLastChangedFrame() const
@@ -164,26 +304,314 @@ public:
 
 private:
 
-    // Mapping: index -> frame -> input
-    std::vector<std::vector<T>> _inputs;
+    typedef std::array<T, INPUTS_CHUNK_SIZE> Chunk;
+
+    // Run of the same input for a number of frames
+    struct Run
+    {
+        T value;
+        uint16_t length;
+    };
+
+    // Inputs for a single index
+    struct Index
+    {
+        // Number of frames of inputs
+        uint32_t size = 0;
+
+        // Chunks containing the inputs in frame order, this keeps its capacity when the index is erased
+        std::vector<uint32_t> chunks;
+
+        // Runs of inputs in frame order, only used when compressed
+        std::vector<Run> runs;
+
+        // Starting frame of every INPUTS_RUN_BLOCK runs, only used when compressed
+        std::vector<uint32_t> blocks;
+
+        bool isCompressed() const { return ! runs.empty(); }
+    };
+
+    // Ring of indices, starting from the oldest index
+    std::vector<Index> _indices;
+    size_t _firstIndex = 0, _numIndices = 0;
+
+    // Indices before this have been compressed, unless uncompressed again to be changed
+    size_t _numColdIndices = 0;
+
+    // All allocated chunks, appending to a deque doesn't move the existing chunks
+    std::deque<Chunk> _chunks;
+
+    // Chunks that aren't used by any index
+    std::vector<uint32_t> _freeChunks;
+
+    // Buffers for compressing an index
+    std::vector<Run> _runs;
+    std::vector<uint32_t> _blocks;
 
     // Last frame of input that changed
     IndexedFrame _lastChangedFrame = MaxIndexedFrame;
 
+    Index& at ( size_t index ) { return _indices[( _firstIndex + index ) % _indices.size()]; }
+    const Index& at ( size_t index ) const { return _indices[( _firstIndex + index ) % _indices.size()]; }
+
+    T& input ( Index& inputs, uint32_t frame )
+    {
+        return _chunks[inputs.chunks[frame / INPUTS_CHUNK_SIZE]][frame % INPUTS_CHUNK_SIZE];
+    }
+
+    const T& input ( const Index& inputs, uint32_t frame ) const
+    {
+        return _chunks[inputs.chunks[frame / INPUTS_CHUNK_SIZE]][frame % INPUTS_CHUNK_SIZE];
+    }
+
+    // Find the run containing the given frame of a compressed index, and the frame that run starts at
+    size_t findRun ( const Index& inputs, uint32_t frame, uint32_t& start ) const
+    {
+        ASSERT ( frame < inputs.size );
+
+        // Find the last block starting at or before the frame, then scan its runs
+        const size_t block = std::upper_bound ( inputs.blocks.begin(), inputs.blocks.end(), frame )
+                             - inputs.blocks.begin() - 1;
+
+        size_t run = block * INPUTS_RUN_BLOCK;
+        start = inputs.blocks[block];
+
+        while ( start + inputs.runs[run].length <= frame )
+            start += inputs.runs[run++].length;
+
+        return run;
+    }
+
+    // Get the input for the given frame of an index, which can be compressed
+    T value ( const Index& inputs, uint32_t frame ) const
+    {
+        if ( inputs.isCompressed() )
+        {
+            uint32_t start;
+            return inputs.runs[findRun ( inputs, frame, start )].value;
+        }
+
+        return input ( inputs, frame );
+    }
+
+    // Get an index that can be changed, uncompressing it if needed
+    Index& uncompressed ( uint32_t index )
+    {
+        Index& inputs = at ( index );
+
+        if ( ! inputs.isCompressed() )
+            return inputs;
+
+        std::vector<Run> runs;
+        runs.swap ( inputs.runs );
+        std::vector<uint32_t>().swap ( inputs.blocks );
+
+        const uint32_t size = inputs.size;
+        inputs.size = 0;
+
+        resizeFrames ( inputs, size, 0 );
+
+        uint32_t frame = 0;
+
+        for ( const Run& run : runs )
+        {
+            for ( uint32_t end = frame + run.length; frame < end; ++frame )
+                input ( inputs, frame ) = run.value;
+        }
+
+        // Compress it again once it is older than the newest indices
+        _numColdIndices = std::min<size_t> ( _numColdIndices, index );
+
+        return inputs;
+    }
+
+    // Run-length encode an index, and free its chunks
+    void compress ( Index& inputs )
+    {
+        if ( inputs.isCompressed() || inputs.size == 0 )
+            return;
+
+        // Encode into reused buffers first, so the runs of the index are allocated with the exact size
+        _runs.clear();
+        _blocks.clear();
+
+        for ( uint32_t frame = 0; frame < inputs.size; ++frame )
+        {
+            const T t = input ( inputs, frame );
+
+            if ( ! _runs.empty() && _runs.back().value == t && _runs.back().length < UINT16_MAX )
+            {
+                ++_runs.back().length;
+                continue;
+            }
+
+            if ( _runs.size() % INPUTS_RUN_BLOCK == 0 )
+                _blocks.push_back ( frame );
+
+            _runs.push_back ( { t, 1 } );
+        }
+
+        inputs.runs.assign ( _runs.begin(), _runs.end() );
+        inputs.blocks.assign ( _blocks.begin(), _blocks.end() );
+
+        _freeChunks.insert ( _freeChunks.end(), inputs.chunks.begin(), inputs.chunks.end() );
+
+        std::vector<uint32_t>().swap ( inputs.chunks );
+    }
+
+    // Compress all indices except the newest ones
+    void compressColdIndices()
+    {
+        for ( ; _numColdIndices + INPUTS_HOT_INDICES < _numIndices; ++_numColdIndices )
+            compress ( at ( _numColdIndices ) );
+    }
+
+    // Add empty indices up to the given number of indices, the ring doubles in size if full
+    void resizeIndices ( size_t numIndices )
+    {
+        if ( numIndices > _indices.size() )
+        {
+            std::vector<Index> indices ( std::max ( numIndices, 2 * _indices.size() ) );
+
+            for ( size_t i = 0; i < _numIndices; ++i )
+                indices[i] = std::move ( at ( i ) );
+
+            _indices.swap ( indices );
+            _firstIndex = 0;
+        }
+
+        _numIndices = numIndices;
+
+        compressColdIndices();
+    }
+
+    // Add frames to an index up to the given size, filling the new frames with the given input
+    void resizeFrames ( Index& inputs, uint32_t size, T last )
+    {
+        while ( inputs.chunks.size() * INPUTS_CHUNK_SIZE < size )
+        {
+            if ( _freeChunks.empty() )
+            {
+                _freeChunks.push_back ( _chunks.size() );
+                _chunks.emplace_back();
+            }
+
+            inputs.chunks.push_back ( _freeChunks.back() );
+            _freeChunks.pop_back();
+        }
+
+        for ( uint32_t frame = inputs.size; frame < size; ++frame )
+            input ( inputs, frame ) = last;
+
+        inputs.size = size;
+    }
+
+    // Erase the given number of older indices, their chunks are reused by newer indices
+    void eraseIndices ( size_t count )
+    {
+        ASSERT ( count <= _numIndices );
+
+        for ( size_t i = 0; i < count; ++i )
+        {
+            Index& inputs = at ( i );
+
+            _freeChunks.insert ( _freeChunks.end(), inputs.chunks.begin(), inputs.chunks.end() );
+
+            inputs.chunks.clear();
+            std::vector<Run>().swap ( inputs.runs );
+            std::vector<uint32_t>().swap ( inputs.blocks );
+            inputs.size = 0;
+        }
+
+        if ( ! _indices.empty() )
+            _firstIndex = ( _firstIndex + count ) % _indices.size();
+
+        _numIndices -= count;
+        _numColdIndices -= std::min ( _numColdIndices, count );
+    }
+
+    // Find the first of n inputs starting from index:frame that differs from the known inputs, returns n if none
+    size_t findChanged ( uint32_t index, uint32_t frame, const T *t, size_t n ) const
+    {
+        size_t i = 0;
+
+        // Compare against the known inputs of the index, one chunk at a time
+        if ( index < _numIndices )
+        {
+            const Index& inputs = at ( index );
+
+            // Compressed indices are compared one input at a time
+            if ( inputs.isCompressed() )
+            {
+                for ( ; i < n; ++i )
+                {
+                    if ( get ( index, frame + i ) != t[i] )
+                        return i;
+                }
+
+                return n;
+            }
+
+            while ( i < n && frame + i < inputs.size )
+            {
+                const uint32_t f = frame + i;
+                const size_t count = std::min<size_t> ( std::min<size_t> ( n - i, inputs.size - f ),
+                                                        INPUTS_CHUNK_SIZE - f % INPUTS_CHUNK_SIZE );
+
+                const size_t j = firstDifference ( &input ( inputs, f ), t + i, count );
+
+                if ( j < count )
+                    return i + j;
+
+                i += count;
+            }
+        }
+
+        if ( i == n )
+            return n;
+
+        // Inputs after the known inputs are all the same as the last known input
+        return i + findNotEqual ( t + i, n - i, get ( index, frame + i ) );
+    }
+
+    // Scalar comparisons for any input type
+    template<typename U>
+    static size_t firstDifference ( const U *a, const U *b, size_t n )
+    {
+        return std::mismatch ( a, a + n, b ).first - a;
+    }
+
+    template<typename U>
+    static size_t findNotEqual ( const U *src, size_t n, U value )
+    {
+        return std::find_if ( src, src + n, [value] ( U x ) { return x != value; } ) - src;
+    }
+
+    // SSE2 comparisons for 16-bit inputs
+    static size_t firstDifference ( const uint16_t *a, const uint16_t *b, size_t n )
+    {
+        return MemKernels::firstDifference16 ( a, b, n );
+    }
+
+    static size_t findNotEqual ( const uint16_t *src, size_t n, uint16_t value )
+    {
+        return MemKernels::findNotEqual16 ( src, n, value );
+    }
+
     // Get the last known input BEFORE the given index. Defaults to 0 if unknown.
     T lastInputBefore ( uint32_t index ) const
     {
-        if ( _inputs.empty() || index == 0 )
+        if ( _numIndices == 0 || index == 0 )
             return 0;
 
-        if ( index > _inputs.size() )
-            index = _inputs.size();
+        if ( index > _numIndices )
+            index = _numIndices;
 
         do
         {
             --index;
-            if ( ! _inputs[index].empty() )
-                return _inputs[index].back();
+            if ( at ( index ).size > 0 )
+                return value ( at ( index ), at ( index ).size - 1 );
         }
         while ( index > 0 );
 
@@ -0,0 +1,89 @@
+#include "InputsWindow.hpp"
+#include "StringUtils.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+
+void InputsWindow::gotRemoteFrame ( IndexedFrame remoteFrame )
+{
+    // Frames restart from 0 in each index, so just start tracking the new index
+    if ( remoteFrame.parts.index != _remoteFrame.parts.index )
+    {
+        if ( remoteFrame.parts.index > _remoteFrame.parts.index )
+            _remoteFrame = remoteFrame;
+        return;
+    }
+
+    // Ignore resent and reordered messages
+    if ( remoteFrame.parts.frame <= _remoteFrame.parts.frame )
+        return;
+
+    // Longer gaps are more likely to be the remote pausing than packet loss
+    const uint32_t numLost = min<uint32_t> ( remoteFrame.parts.frame - _remoteFrame.parts.frame - 1, maxWindow );
+
+    for ( uint32_t i = 0; i < numLost; ++i )
+        _packetLoss += INPUTS_WINDOW_SMOOTHING * ( 1 - _packetLoss );
+
+    _packetLoss -= INPUTS_WINDOW_SMOOTHING * _packetLoss;
+
+    _remoteFrame = remoteFrame;
+}
+
+void InputsWindow::gotRemoteAck ( IndexedFrame remoteAck, IndexedFrame localFrame )
+{
+    if ( remoteAck.parts.index != localFrame.parts.index || remoteAck.parts.frame > localFrame.parts.frame + 1 )
+        return;
+
+    const double numUnacked = localFrame.parts.frame + 1 - remoteAck.parts.frame;
+
+    _roundTrip += INPUTS_WINDOW_SMOOTHING * ( numUnacked - _roundTrip );
+}
+
+uint8_t InputsWindow::getNumInputs ( IndexedFrame localFrame, IndexedFrame remoteAck ) const
+{
+    const uint32_t endFrame = localFrame.parts.frame + 1;
+
+    // Send as many inputs as possible until the remote has inputs in this index, so there are never any gaps
+    if ( remoteAck.parts.index != localFrame.parts.index || remoteAck.parts.frame == 0 )
+        return min<uint32_t> ( endFrame, maxWindow );
+
+    const uint32_t numUnacked = ( remoteAck.parts.frame < endFrame ? endFrame - remoteAck.parts.frame : 1 );
+    const uint32_t window = getWindow();
+
+    // The ack is overdue, so the remote is probably missing the oldest unacked input
+    if ( numUnacked > _roundTrip + window + 1 )
+        return min<uint32_t> ( numUnacked, maxWindow );
+
+    return min ( numUnacked, window );
+}
+
+uint8_t InputsWindow::getWindow() const
+{
+    if ( _packetLoss <= 0 )
+        return min<uint32_t> ( MIN_INPUTS_WINDOW, maxWindow );
+
+    if ( _packetLoss >= 1 )
+        return maxWindow;
+
+    // Smallest number of messages so the chance of losing all of them is below the target
+    const double window = ceil ( log ( INPUTS_WINDOW_LOSS_TARGET ) / log ( _packetLoss ) );
+
+    if ( window >= maxWindow )
+        return maxWindow;
+
+    return min<uint32_t> ( max<uint32_t> ( MIN_INPUTS_WINDOW, uint32_t ( window ) ), maxWindow );
+}
+
+void InputsWindow::reset()
+{
+    _remoteFrame = {{ 0, 0 }};
+    _packetLoss = _roundTrip = 0;
+}
+
+string InputsWindow::str() const
+{
+    return format ( "window=%u; loss=%.1f%%; rtt=%.1f", getWindow(), 100 * _packetLoss, _roundTrip );
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Constants.hpp"
+
+#include <string>
+
+
+// Minimum number of inputs to send per message, once the remote has acked inputs in the same index
+#define MIN_INPUTS_WINDOW           ( 4 )
+
+// Target probability that every message with a given input is lost
+#define INPUTS_WINDOW_LOSS_TARGET   ( 0.000001 )
+
+// Packet loss above which each inputs message is sent twice
+#define DUPLICATE_INPUTS_LOSS       ( 0.2 )
+
+// Weight of each new sample in the moving averages
+#define INPUTS_WINDOW_SMOOTHING     ( 1.0 / 32 )
+
+
+// Sizes the number of inputs sent per DeltaInputs message from the live packet loss and round trip time, which are
+// measured from the inputs messages and acks received from the remote. Both sides send one message per frame, so
+// any skipped remote frames are counted as lost messages, and the number of unacked local frames is the round trip.
+class InputsWindow
+{
+public:
+
+    // Maximum number of inputs to send per message, at most NUM_INPUTS
+    uint8_t maxWindow = MAX_INPUTS_WINDOW;
+
+    // Update the packet loss from the newest frame in a remote inputs message
+    void gotRemoteFrame ( IndexedFrame remoteFrame );
+
+    // Update the round trip from a remote ack, given the newest local frame sent
+    void gotRemoteAck ( IndexedFrame remoteAck, IndexedFrame localFrame );
+
+    // Get the number of inputs to send for the given newest local frame.
+    // Inputs already acked are never sent, and the remaining inputs are sent until enough messages were sent to
+    // reach the loss target. If an ack is overdue, the inputs since the ack are resent, up to the max window.
+    uint8_t getNumInputs ( IndexedFrame localFrame, IndexedFrame remoteAck ) const;
+
+    // Get the number of messages each input should be sent in to reach the loss target
+    uint8_t getWindow() const;
+
+    // True if each inputs message should be sent twice
+    bool shouldDuplicate() const { return ( _packetLoss > DUPLICATE_INPUTS_LOSS ); }
+
+    // Get the measured packet loss, from 0 to 1, and round trip in frames
+    double getPacketLoss() const { return _packetLoss; }
+    double getRoundTrip() const { return _roundTrip; }
+
+    // Clear the measured stats
+    void reset();
+
+    // Get the window and measured stats
+    std::string str() const;
+
+private:
+
+    // Newest remote frame received
+    IndexedFrame _remoteFrame = {{ 0, 0 }};
+
+    // Moving averages of the packet loss and round trip
+    double _packetLoss = 0, _roundTrip = 0;
+};
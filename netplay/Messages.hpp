@@ -13,6 +13,7 @@
 #include <cereal/types/string.hpp>
 #include <cereal/types/unordered_map.hpp>
 
+#include <algorithm>
 #include <array>
 #include <cstring>
 
@@ -33,7 +34,8 @@ struct ClientMode : public SerializableSequence
 {
     ENUM_BOILERPLATE ( ClientMode, Host, Client, SpectateNetplay, SpectateBroadcast, Broadcast, Offline )
 
-    enum { Training = 0x01, GameStarted = 0x02, UdpTunnel = 0x04, IsWine = 0x08, VersusCPU = 0x10 };
+    enum { Training = 0x01, GameStarted = 0x02, UdpTunnel = 0x04, IsWine = 0x08, VersusCPU = 0x10, DeltaInputs = 0x20,
+           FastChecksum = 0x40, FramedMessages = 0x80 };
 
     uint8_t flags = 0;
 
@@ -61,6 +63,9 @@ struct ClientMode : public SerializableSequence
     bool isGameStarted() const { return ( flags & GameStarted ); }
     bool isUdpTunnel() const { return ( flags & UdpTunnel ); }
     bool isWine() const { return ( flags & IsWine ); }
+    bool isDeltaInputs() const { return ( flags & DeltaInputs ); }
+    bool isFastChecksum() const { return ( flags & FastChecksum ); }
+    bool isFramedMessages() const { return ( flags & FramedMessages ); }
     bool isSinglePlayer() const { return ( isNetplay() || isVersusCPU() ); }
 
     std::string flagString() const
@@ -82,6 +87,15 @@ struct ClientMode : public SerializableSequence
         if ( flags & VersusCPU )
             str += std::string ( str.empty() ? "" : ", " ) + "VersusCPU";
 
+        if ( flags & DeltaInputs )
+            str += std::string ( str.empty() ? "" : ", " ) + "DeltaInputs";
+
+        if ( flags & FastChecksum )
+            str += std::string ( str.empty() ? "" : ", " ) + "FastChecksum";
+
+        if ( flags & FramedMessages )
+            str += std::string ( str.empty() ? "" : ", " ) + "FramedMessages";
+
         return str;
     }
 
@@ -478,6 +492,106 @@ struct PlayerInputs : public SerializableMessage, public BaseInputs
 };
 
 
+// Replaces PlayerInputs when both sides negotiated ClientMode::DeltaInputs. Only the inputs after the frames acked
+// by the remote are sent, run-length encoded, and each message acks the inputs received from the remote.
+struct DeltaInputs : public SerializableMessage
+{
+    IndexedFrame indexedFrame = {{ 0, 0 }};
+
+    // All remote inputs before ack.frame in ack.index have been received
+    IndexedFrame ack = {{ 0, 0 }};
+
+    // Number of inputs, at most NUM_INPUTS
+    uint8_t numInputs = 0;
+
+    // Represents the input range [frame - numInputs + 1, frame + 1)
+    std::array<uint16_t, NUM_INPUTS> inputs;
+
+    // Include the inputs not acked by the remote yet, but always at least the input for the given frame
+    DeltaInputs ( IndexedFrame indexedFrame, IndexedFrame ack, IndexedFrame remoteAck )
+        : indexedFrame ( indexedFrame ), ack ( ack )
+    {
+        uint32_t startFrame =
+            ( indexedFrame.parts.frame + 1 < NUM_INPUTS ) ? 0 : indexedFrame.parts.frame + 1 - NUM_INPUTS;
+
+        if ( remoteAck.parts.index == indexedFrame.parts.index && remoteAck.parts.frame > startFrame )
+            startFrame = std::min ( remoteAck.parts.frame, indexedFrame.parts.frame );
+
+        numInputs = indexedFrame.parts.frame + 1 - startFrame;
+    }
+
+    // Include the given number of inputs ending at the given frame
+    DeltaInputs ( IndexedFrame indexedFrame, IndexedFrame ack, uint8_t numInputs )
+        : indexedFrame ( indexedFrame ), ack ( ack ), numInputs ( numInputs )
+    {
+        ASSERT ( numInputs >= 1 );
+        ASSERT ( numInputs <= NUM_INPUTS );
+        ASSERT ( numInputs <= indexedFrame.parts.frame + 1 );
+    }
+
+    uint32_t getIndex() const { return indexedFrame.parts.index; }
+    uint32_t getFrame() const { return indexedFrame.parts.frame; }
+    uint32_t getStartFrame() const { return indexedFrame.parts.frame + 1 - numInputs; }
+    uint32_t getEndFrame() const { return indexedFrame.parts.frame + 1; }
+    size_t size() const { return numInputs; }
+
+    std::string str() const override { return format ( "DeltaInputs[%s,%u,%s]", indexedFrame, numInputs, ack ); }
+
+    EMPTY_MESSAGE_BOILERPLATE ( DeltaInputs )
+
+    // Runs are stored as { input, length } pairs
+    void save ( cereal::BinaryOutputArchive& ar ) const override
+    {
+        uint8_t numRuns = 0;
+
+        for ( uint8_t i = 0; i < numInputs; ++i )
+            numRuns += ( i == 0 || inputs[i] != inputs[i - 1] );
+
+        ar ( indexedFrame.value, ack.value, numInputs, numRuns );
+
+        for ( uint8_t i = 0; i < numInputs; )
+        {
+            uint8_t length = 1;
+
+            while ( i + length < numInputs && inputs[i + length] == inputs[i] )
+                ++length;
+
+            ar ( inputs[i], length );
+            i += length;
+        }
+    }
+
+    void load ( cereal::BinaryInputArchive& ar ) override
+    {
+        uint8_t numRuns = 0;
+
+        ar ( indexedFrame.value, ack.value, numInputs, numRuns );
+
+        if ( numInputs > NUM_INPUTS || numInputs > indexedFrame.parts.frame + 1 )
+            throw cereal::Exception ( format ( "numInputs=%u", numInputs ) );
+
+        uint8_t i = 0;
+
+        for ( ; numRuns > 0; --numRuns )
+        {
+            uint16_t input = 0;
+            uint8_t length = 0;
+
+            ar ( input, length );
+
+            if ( i + length > numInputs )
+                throw cereal::Exception ( format ( "run=%u+%u; numInputs=%u", i, length, numInputs ) );
+
+            std::fill ( inputs.begin() + i, inputs.begin() + i + length, input );
+            i += length;
+        }
+
+        if ( i != numInputs )
+            throw cereal::Exception ( format ( "runs=%u; numInputs=%u", i, numInputs ) );
+    }
+};
+
+
 struct BothInputs : public SerializableSequence, public BaseInputs
 {
     // Represents the input range [frame - NUM_INPUTS + 1, frame + 1)
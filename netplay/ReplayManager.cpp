@@ -313,6 +313,14 @@ uint32_t ReplayManager::getLastFrame() const
     return _inputs.back().size() - 1;
 }
 
+uint32_t ReplayManager::getNumFrames ( uint32_t index ) const
+{
+    if ( index >= _inputs.size() )
+        return 0;
+
+    return _inputs[index].size();
+}
+
 MsgPtr ReplayManager::getInitialStateBefore ( uint32_t index ) const
 {
     for ( int i = _initialStates.size() - 1; i >= 0; --i )
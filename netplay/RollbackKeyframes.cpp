@@ -0,0 +1,300 @@
+#include "RollbackKeyframes.hpp"
+#include "Compression.hpp"
+#include "MemKernels.hpp"
+#include "Logger.hpp"
+#include "Exceptions.hpp"
+#include "ErrorStrings.hpp"
+
+using namespace std;
+
+
+template<typename T>
+static inline void deleteArray ( T *ptr ) { delete[] ptr; }
+
+
+void RollbackKeyframes::allocate ( size_t numKeyframes, size_t numRawBuffers, size_t size, int compressionLevel )
+{
+    ASSERT ( numRawBuffers > 0 );
+
+    deallocate();
+
+    LOCK ( _mutex );
+
+    _keyframes.resize ( numKeyframes );
+    _numRawBuffers = numRawBuffers;
+    _size = size;
+    _compressionLevel = compressionLevel;
+    _sequence = 0;
+    _numStalls = 0;
+
+    _rawPool.reset ( new char[numRawBuffers * size], deleteArray<char> );
+
+    _freeRaw.reserve ( numRawBuffers );
+
+    for ( size_t i = 0; i < numRawBuffers; ++i )
+        _freeRaw.push_back ( i );
+
+    _thread.reset ( new CompressThread ( *this ) );
+    _thread->start();
+}
+
+void RollbackKeyframes::deallocate()
+{
+    if ( _thread )
+    {
+        _thread->join();
+        _thread.reset();
+    }
+
+    LOCK ( _mutex );
+
+    _keyframes.clear();
+    _rawPool.reset();
+    _freeRaw.clear();
+    _numRawBuffers = _size = 0;
+}
+
+uint32_t RollbackKeyframes::allocateRaw()
+{
+    bool stalled = false;
+
+    for ( ;; )
+    {
+        if ( ! _freeRaw.empty() )
+        {
+            const uint32_t raw = _freeRaw.back();
+            _freeRaw.pop_back();
+            return raw;
+        }
+
+        // Reuse the raw buffer of the oldest keyframe that is already compressed
+        Keyframe *oldest = 0;
+
+        for ( Keyframe& keyframe : _keyframes )
+        {
+            if ( keyframe.tier == Tier::Compressed && keyframe.raw != NO_RAW_BUFFER
+                    && ( ! oldest || keyframe.sequence < oldest->sequence ) )
+            {
+                oldest = &keyframe;
+            }
+        }
+
+        if ( oldest )
+        {
+            _freeRaw.push_back ( oldest->raw );
+            oldest->raw = NO_RAW_BUFFER;
+            continue;
+        }
+
+        if ( ! stalled )
+        {
+            stalled = true;
+            ++_numStalls;
+        }
+
+        // Wait for the background thread if it still has keyframes to compress
+        bool pending = false;
+
+        for ( const Keyframe& keyframe : _keyframes )
+        {
+            if ( keyframe.tier == Tier::Queued || keyframe.tier == Tier::Compressing )
+            {
+                pending = true;
+                break;
+            }
+        }
+
+        if ( pending )
+        {
+            _cond.wait ( _mutex );
+            continue;
+        }
+
+        // Otherwise compress the oldest raw keyframe on this thread
+        for ( Keyframe& keyframe : _keyframes )
+        {
+            if ( keyframe.tier == Tier::Raw && ( ! oldest || keyframe.sequence < oldest->sequence ) )
+                oldest = &keyframe;
+        }
+
+        ASSERT ( oldest != 0 );
+
+        oldest->compressed.resize ( compressBound ( _size ) );
+
+        const size_t len = ::compress ( getRaw ( oldest->raw ), _size, &oldest->compressed[0],
+                                        oldest->compressed.size(), _compressionLevel );
+
+        if ( ! len )
+            THROW_EXCEPTION ( "Failed to compress rollback keyframe!", ERROR_INTERNAL );
+
+        oldest->compressed.resize ( len );
+        oldest->tier = Tier::Compressed;
+    }
+}
+
+char *RollbackKeyframes::store ( uint32_t keyframe )
+{
+    LOCK ( _mutex );
+
+    ASSERT ( keyframe < _keyframes.size() );
+    ASSERT ( _keyframes[keyframe].tier == Tier::Unused );
+
+    const uint32_t raw = allocateRaw();
+
+    Keyframe& k = _keyframes[keyframe];
+    k.tier = Tier::Raw;
+    k.raw = raw;
+    k.sequence = ++_sequence;
+
+    return getRaw ( raw );
+}
+
+void RollbackKeyframes::compress ( uint32_t keyframe )
+{
+    LOCK ( _mutex );
+
+    ASSERT ( keyframe < _keyframes.size() );
+
+    Keyframe& k = _keyframes[keyframe];
+
+    if ( k.tier != Tier::Raw )
+        return;
+
+    k.tier = Tier::Queued;
+    _thread->jobs.push ( { keyframe, k.generation } );
+}
+
+bool RollbackKeyframes::isRaw ( uint32_t keyframe ) const
+{
+    LOCK ( _mutex );
+
+    ASSERT ( keyframe < _keyframes.size() );
+
+    return ( _keyframes[keyframe].raw != NO_RAW_BUFFER );
+}
+
+bool RollbackKeyframes::load ( uint32_t keyframe, char *dst ) const
+{
+    LOCK ( _mutex );
+
+    ASSERT ( keyframe < _keyframes.size() );
+
+    const Keyframe& k = _keyframes[keyframe];
+
+    ASSERT ( k.tier != Tier::Unused );
+
+    if ( k.raw != NO_RAW_BUFFER )
+    {
+        MemKernels::copy ( dst, getRaw ( k.raw ), _size );
+        return true;
+    }
+
+    ASSERT ( k.tier == Tier::Compressed );
+
+    return ( uncompress ( &k.compressed[0], k.compressed.size(), dst, _size ) == _size );
+}
+
+void RollbackKeyframes::erase ( uint32_t keyframe )
+{
+    LOCK ( _mutex );
+
+    ASSERT ( keyframe < _keyframes.size() );
+
+    Keyframe& k = _keyframes[keyframe];
+
+    // The background thread frees the raw buffer when it finishes compressing
+    if ( k.raw != NO_RAW_BUFFER && k.tier != Tier::Compressing )
+        _freeRaw.push_back ( k.raw );
+
+    k.tier = Tier::Unused;
+    k.raw = NO_RAW_BUFFER;
+    ++k.generation;
+}
+
+RollbackKeyframes::Stats RollbackKeyframes::getStats() const
+{
+    LOCK ( _mutex );
+
+    Stats stats;
+
+    for ( const Keyframe& keyframe : _keyframes )
+    {
+        if ( keyframe.raw != NO_RAW_BUFFER )
+        {
+            ++stats.numRaw;
+            stats.rawBytes += _size;
+        }
+
+        if ( keyframe.tier == Tier::Compressed )
+        {
+            ++stats.numCompressed;
+            stats.compressedBytes += keyframe.compressed.size();
+        }
+    }
+
+    stats.numStalls = _numStalls;
+
+    return stats;
+}
+
+
+void RollbackKeyframes::CompressThread::run()
+{
+    for ( ;; )
+    {
+        const Job job = jobs.pop();
+
+        if ( job.keyframe == NO_KEYFRAME )
+            return;
+
+        uint32_t raw;
+
+        {
+            Lock lock ( context._mutex );
+
+            Keyframe& keyframe = context._keyframes[job.keyframe];
+
+            // Skip keyframes that were freed or compressed since this job was queued
+            if ( keyframe.generation != job.generation || keyframe.tier != Tier::Queued )
+                continue;
+
+            keyframe.tier = Tier::Compressing;
+            raw = keyframe.raw;
+        }
+
+        // Compress without holding the lock, the raw buffer can't be reused while compressing
+        buffer.resize ( compressBound ( context._size ) );
+
+        const size_t len = ::compress ( context.getRaw ( raw ), context._size, &buffer[0], buffer.size(),
+                                        context._compressionLevel );
+
+        Lock lock ( context._mutex );
+
+        Keyframe& keyframe = context._keyframes[job.keyframe];
+
+        if ( keyframe.generation != job.generation )
+        {
+            // The keyframe was freed while compressing
+            context._freeRaw.push_back ( raw );
+        }
+        else if ( len )
+        {
+            keyframe.compressed.assign ( &buffer[0], len );
+            keyframe.tier = Tier::Compressed;
+        }
+        else
+        {
+            // Keep the keyframe raw if it failed to compress
+            keyframe.tier = Tier::Raw;
+        }
+
+        context._cond.broadcast();
+    }
+}
+
+void RollbackKeyframes::CompressThread::join()
+{
+    jobs.push ( { NO_KEYFRAME, 0 } );
+    Thread::join();
+    jobs.clear();
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "RollbackStates.hpp"
+#include "Thread.hpp"
+#include "BlockingQueue.hpp"
+
+#include <memory>
+#include <vector>
+#include <string>
+
+
+// Index of a raw buffer, used for keyframes that are only compressed
+#define NO_RAW_BUFFER ( 0xFFFFFFFFu )
+
+
+// Tiered storage for rollback keyframes. New keyframes are stored raw in a small pool of buffers, and older keyframes
+// are compressed by a background thread, which lets their raw buffer be reused. Compressed keyframes are uncompressed
+// on demand when loaded. Keyframes are identified by the keyframe slots allocated by RollbackStates.
+class RollbackKeyframes
+{
+public:
+
+    // Memory used by each tier
+    struct Stats
+    {
+        // Number of raw keyframes and their total size, this includes raw keyframes that are also compressed
+        uint32_t numRaw = 0;
+        size_t rawBytes = 0;
+
+        // Number of compressed keyframes and their total size
+        uint32_t numCompressed = 0;
+        size_t compressedBytes = 0;
+
+        // Number of times a raw buffer was needed before the background thread finished compressing
+        uint32_t numStalls = 0;
+    };
+
+    // Allocate / deallocate the raw buffers and start / stop the background thread, this frees all keyframes
+    void allocate ( size_t numKeyframes, size_t numRawBuffers, size_t size, int compressionLevel );
+    void deallocate();
+
+    // Get a raw buffer to store a new keyframe in
+    char *store ( uint32_t keyframe );
+
+    // Queue a keyframe to be compressed by the background thread, after which its raw buffer can be reused
+    void compress ( uint32_t keyframe );
+
+    // Check if a keyframe can be loaded without uncompressing it
+    bool isRaw ( uint32_t keyframe ) const;
+
+    // Copy a keyframe into the destination buffer, returns false if the compressed bytes are invalid
+    bool load ( uint32_t keyframe, char *dst ) const;
+
+    // Free a keyframe, its raw buffer can be reused immediately
+    void erase ( uint32_t keyframe );
+
+    // Get the memory used by each tier
+    Stats getStats() const;
+
+private:
+
+    enum class Tier : uint8_t { Unused, Raw, Queued, Compressing, Compressed };
+
+    struct Keyframe
+    {
+        Tier tier = Tier::Unused;
+
+        // Index of the raw buffer, NO_RAW_BUFFER if the keyframe is only compressed
+        uint32_t raw = NO_RAW_BUFFER;
+
+        // Incremented every time the keyframe slot is reused, so stale compression jobs are ignored
+        uint32_t generation = 0;
+
+        // Order the keyframe was stored in, the oldest one is compressed first if no buffer is available
+        uint64_t sequence = 0;
+
+        // Compressed bytes, these keep their capacity between keyframes
+        std::string compressed;
+    };
+
+    struct Job
+    {
+        uint32_t keyframe;
+        uint32_t generation;
+    };
+
+    // Thread to compress older keyframes
+    struct CompressThread : public Thread
+    {
+        RollbackKeyframes& context;
+
+        // Compression jobs, a job with NO_KEYFRAME stops the thread
+        BlockingQueue<Job> jobs;
+
+        // Buffer for the compressed bytes
+        std::string buffer;
+
+        CompressThread ( RollbackKeyframes& context ) : context ( context ) {}
+
+        // ~Thread calls Thread::join, so this must call CompressThread::join to stop the thread
+        ~CompressThread() { join(); }
+
+        // Thread functions
+        void run() override;
+        void join() override;
+    };
+
+    // Protects the keyframes and raw buffers, which are shared with the background thread
+    mutable Mutex _mutex;
+
+    // Signalled when the background thread finishes a job
+    CondVar _cond;
+
+    std::vector<Keyframe> _keyframes;
+
+    // Pool of raw buffers, each with the size of a keyframe
+    std::shared_ptr<char> _rawPool;
+
+    // Unused raw buffers
+    std::vector<uint32_t> _freeRaw;
+
+    size_t _numRawBuffers = 0, _size = 0;
+
+    int _compressionLevel = 0;
+
+    uint64_t _sequence = 0;
+
+    uint32_t _numStalls = 0;
+
+    std::shared_ptr<CompressThread> _thread;
+
+    char *getRaw ( uint32_t raw ) const { return _rawPool.get() + raw * _size; }
+
+    // Get an unused raw buffer, waiting for or doing compression if needed. The mutex must be locked.
+    uint32_t allocateRaw();
+};
@@ -0,0 +1,193 @@
+#include "RollbackStates.hpp"
+#include "Logger.hpp"
+
+using namespace std;
+
+
+void RollbackStates::allocate ( size_t numStates, size_t numKeyframes, uint32_t keyframeInterval )
+{
+    ASSERT ( numStates > 0 );
+    ASSERT ( numKeyframes >= 2 );
+    ASSERT ( keyframeInterval > 0 );
+
+    clear();
+
+    _ring.resize ( numStates );
+    _numKeyframes = numKeyframes;
+    _keyframeInterval = keyframeInterval;
+
+    _freeSlots.clear();
+    _freeSlots.reserve ( numStates );
+
+    for ( size_t i = 0; i < numStates; ++i )
+        _freeSlots.push_back ( i );
+
+    _freeKeyframes.clear();
+    _freeKeyframes.reserve ( numKeyframes );
+
+    for ( size_t i = 0; i < numKeyframes; ++i )
+        _freeKeyframes.push_back ( i );
+}
+
+void RollbackStates::deallocate()
+{
+    clear();
+
+    _ring.clear();
+    _freeSlots.clear();
+    _freeKeyframes.clear();
+    _numKeyframes = 0;
+}
+
+void RollbackStates::clear()
+{
+    for ( size_t i = 0; i < _size; ++i )
+        freeState ( at ( i ) );
+
+    _head = _size = 0;
+}
+
+void RollbackStates::freeState ( const State& state )
+{
+    if ( owner )
+        owner->rollbackStateFreed ( state );
+
+    if ( state.isKeyframe() )
+        _freeKeyframes.push_back ( state.keyframe );
+
+    _freeSlots.push_back ( state.slot );
+}
+
+bool RollbackStates::eraseChain ( size_t pos )
+{
+    ASSERT ( pos < _size );
+    ASSERT ( at ( pos ).isKeyframe() == true );
+
+    size_t end = pos;
+
+    do
+    {
+        freeState ( at ( end ) );
+        ++end;
+    }
+    while ( end < _size && ! at ( end ).isKeyframe() );
+
+    const size_t count = end - pos;
+
+    // Shift the states before the chain forward, this is at most one pinned chain
+    for ( size_t i = pos; i > 0; --i )
+        at ( i - 1 + count ) = at ( i - 1 );
+
+    _head = ( _head + count ) % _ring.size();
+    _size -= count;
+
+    return ( end == _size + count );
+}
+
+const RollbackStates::State& RollbackStates::push ( NetplayState netplayState, uint32_t startWorldTime,
+                                                    IndexedFrame indexedFrame, uint32_t remoteFrame )
+{
+    ASSERT ( _ring.empty() == false );
+
+    bool isKeyframe = empty() || ( back().keyframeDistance + 1 >= _keyframeInterval );
+
+    while ( _freeSlots.empty() || ( isKeyframe && _freeKeyframes.empty() ) )
+    {
+        ASSERT ( empty() == false );
+
+        size_t pos = 0;
+
+        // Keep the oldest chain of states if the remote has confirmed it, and erase the next chain instead
+        if ( front().indexedFrame.parts.frame <= remoteFrame )
+        {
+            do { ++pos; } while ( pos < _size && ! at ( pos ).isKeyframe() );
+
+            if ( pos == _size )
+                pos = 0;
+        }
+
+        // The next state can't be a delta if the newest state was erased
+        if ( eraseChain ( pos ) )
+            isKeyframe = true;
+    }
+
+    State state = { netplayState, startWorldTime, indexedFrame, _freeSlots.back(), NO_KEYFRAME, 0 };
+
+    _freeSlots.pop_back();
+
+    if ( isKeyframe )
+    {
+        state.keyframe = _freeKeyframes.back();
+        _freeKeyframes.pop_back();
+    }
+    else
+    {
+        state.keyframeDistance = back().keyframeDistance + 1;
+    }
+
+    ASSERT ( _size < _ring.size() );
+
+    at ( _size ) = state;
+    ++_size;
+
+    return back();
+}
+
+size_t RollbackStates::find ( IndexedFrame indexedFrame ) const
+{
+    if ( empty() )
+        return 0;
+
+    const State& last = back();
+
+    if ( last.indexedFrame.value <= indexedFrame.value )
+        return _size - 1;
+
+    // States are usually saved every frame, so try the position at the same distance from the newest state
+    if ( last.indexedFrame.parts.index == indexedFrame.parts.index
+            && last.indexedFrame.parts.frame - indexedFrame.parts.frame < _size )
+    {
+        const size_t pos = _size - 1 - ( last.indexedFrame.parts.frame - indexedFrame.parts.frame );
+
+        if ( ( *this ) [pos].indexedFrame.value == indexedFrame.value )
+            return pos;
+    }
+
+    // Otherwise binary search for the first state after the given frame
+    size_t lo = 0, hi = _size;
+
+    while ( lo < hi )
+    {
+        const size_t mid = ( lo + hi ) / 2;
+
+        if ( ( *this ) [mid].indexedFrame.value <= indexedFrame.value )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return ( lo == 0 ? _size : lo - 1 );
+}
+
+size_t RollbackStates::findKeyframe ( size_t pos ) const
+{
+    ASSERT ( pos < _size );
+
+    while ( ! ( *this ) [pos].isKeyframe() )
+    {
+        ASSERT ( pos > 0 );
+        --pos;
+    }
+
+    return pos;
+}
+
+void RollbackStates::eraseAfter ( size_t pos )
+{
+    ASSERT ( pos < _size );
+
+    for ( size_t i = pos + 1; i < _size; ++i )
+        freeState ( at ( i ) );
+
+    _size = pos + 1;
+}
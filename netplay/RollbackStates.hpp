@@ -0,0 +1,102 @@
+#pragma once
+
+#include "Constants.hpp"
+#include "NetplayStates.hpp"
+
+#include <vector>
+
+
+// Index of a keyframe slot, used for delta states that don't have a keyframe
+#define NO_KEYFRAME ( 0xFFFFFFFFu )
+
+
+// Fixed capacity ring buffer of rollback states in chronological order, which also allocates their storage slots.
+// Each keyframe starts a chain of delta states, and states are always evicted in whole chains.
+class RollbackStates
+{
+public:
+
+    struct State
+    {
+        // Each game state is uniquely identified by (netplayState, startWorldTime, indexedFrame).
+        // They are chronologically ordered by index and then frame.
+        NetplayState netplayState;
+        uint32_t startWorldTime;
+        IndexedFrame indexedFrame;
+
+        // Index of the state slot, which owns the delta buffer
+        uint32_t slot;
+
+        // Index of the keyframe slot, NO_KEYFRAME if this state is a delta
+        uint32_t keyframe;
+
+        // Number of states since the last keyframe, 0 if this state is a keyframe
+        uint32_t keyframeDistance;
+
+        bool isKeyframe() const { return ( keyframe != NO_KEYFRAME ); }
+    };
+
+    struct Owner
+    {
+        // Called before the storage of a state is freed
+        virtual void rollbackStateFreed ( const State& state ) {}
+    };
+
+    Owner *owner = 0;
+
+    // Allocate / deallocate the ring buffer and storage slots, this clears all states
+    void allocate ( size_t numStates, size_t numKeyframes, uint32_t keyframeInterval );
+    void deallocate();
+
+    // Free all states
+    void clear();
+
+    // Add a new state after the newest one, evicting a chain of states if out of storage slots.
+    // The oldest chain is kept if the remote has confirmed its keyframe, and the next chain is evicted instead.
+    const State& push ( NetplayState netplayState, uint32_t startWorldTime, IndexedFrame indexedFrame,
+                        uint32_t remoteFrame );
+
+    // Find the position of the newest state at or before the given frame, returns size() if there isn't one
+    size_t find ( IndexedFrame indexedFrame ) const;
+
+    // Find the position of the keyframe for the state at the given position
+    size_t findKeyframe ( size_t pos ) const;
+
+    // Erase all states after the given position
+    void eraseAfter ( size_t pos );
+
+    // Access states by position, 0 is the oldest state
+    const State& operator[] ( size_t pos ) const { return _ring[ ( _head + pos ) % _ring.size()]; }
+    const State& front() const { return ( *this ) [0]; }
+    const State& back() const { return ( *this ) [_size - 1]; }
+
+    size_t size() const { return _size; }
+    bool empty() const { return ( _size == 0 ); }
+    size_t capacity() const { return _ring.size(); }
+    size_t numKeyframes() const { return _numKeyframes; }
+
+private:
+
+    // Ring buffer of states
+    std::vector<State> _ring;
+
+    // Position of the oldest state in the ring buffer, and the number of states
+    size_t _head = 0, _size = 0;
+
+    // Unused state and keyframe slots, used as stacks
+    std::vector<uint32_t> _freeSlots, _freeKeyframes;
+
+    // Total number of keyframe slots
+    size_t _numKeyframes = 0;
+
+    // Number of states between each keyframe
+    uint32_t _keyframeInterval = 1;
+
+    State& at ( size_t pos ) { return _ring[ ( _head + pos ) % _ring.size()]; }
+
+    // Free the storage slots of a state
+    void freeState ( const State& state );
+
+    // Erase the chain of states starting at the given keyframe, returns true if the newest state was erased
+    bool eraseChain ( size_t pos );
+};
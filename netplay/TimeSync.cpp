@@ -0,0 +1,93 @@
+#include "TimeSync.hpp"
+#include "StringUtils.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+
+void TimeSync::gotPingLatency ( double latency )
+{
+    _latency = latency * nominalFps / 1000;
+}
+
+void TimeSync::gotRoundTrip ( double roundTrip )
+{
+    if ( roundTrip > 0 )
+        _latency = roundTrip / 2;
+}
+
+void TimeSync::gotLocalAdvantage ( int advantage )
+{
+    // Start from the first sample instead of averaging it with zero
+    if ( _numSamples == 0 )
+        _localAdvantage = advantage;
+    else
+        _localAdvantage += TIME_SYNC_SMOOTHING * ( advantage - _localAdvantage );
+
+    ++_numSamples;
+
+    if ( _numSamples >= TIME_SYNC_MIN_SAMPLES )
+    {
+        _skewSlew += TIME_SYNC_INTEGRAL_GAIN * getExcessAdvantage();
+        _skewSlew = max ( -TIME_SYNC_MAX_SLEW, min ( TIME_SYNC_MAX_SLEW, _skewSlew ) );
+    }
+}
+
+void TimeSync::gotRemoteAdvantage ( int advantage )
+{
+    if ( ! _hasRemoteAdvantage )
+        _remoteAdvantage = advantage;
+    else
+        _remoteAdvantage += TIME_SYNC_SMOOTHING * ( advantage - _remoteAdvantage );
+
+    _hasRemoteAdvantage = true;
+}
+
+double TimeSync::getFrameAdvantage() const
+{
+    if ( _hasRemoteAdvantage )
+        return ( _localAdvantage - _remoteAdvantage ) / 2;
+
+    return _localAdvantage - _latency;
+}
+
+double TimeSync::getExcessAdvantage() const
+{
+    const double advantage = getFrameAdvantage();
+
+    if ( fabs ( advantage ) <= TIME_SYNC_DEADBAND )
+        return 0;
+
+    return advantage - ( advantage > 0 ? TIME_SYNC_DEADBAND : -TIME_SYNC_DEADBAND );
+}
+
+double TimeSync::getSlew() const
+{
+    if ( _numSamples < TIME_SYNC_MIN_SAMPLES )
+        return 0;
+
+    // Slow down when ahead and speed up when behind, proportionally to the advantage beyond the deadband
+    const double slew = _skewSlew + TIME_SYNC_GAIN * getExcessAdvantage();
+
+    return max ( -TIME_SYNC_MAX_SLEW, min ( TIME_SYNC_MAX_SLEW, slew ) );
+}
+
+double TimeSync::getDesiredFps() const
+{
+    return nominalFps * ( 1 - getSlew() );
+}
+
+void TimeSync::reset()
+{
+    _localAdvantage = _remoteAdvantage = _skewSlew = 0;
+    _numSamples = 0;
+    _hasRemoteAdvantage = false;
+}
+
+string TimeSync::str() const
+{
+    return format ( "advantage=%+.2f%s; latency=%.1f; fps=%.2f", getFrameAdvantage(),
+                    ( _hasRemoteAdvantage ? "" : " (est)" ), _latency, getDesiredFps() );
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+
+// Nominal frame rate of the game
+#define TIME_SYNC_NOMINAL_FPS       ( 60.0 )
+
+// Frame advantage that is left alone, since it can't be measured more accurately than about a frame
+#define TIME_SYNC_DEADBAND          ( 0.5 )
+
+// Fraction of the frame rate to slew per frame of advantage beyond the deadband
+#define TIME_SYNC_GAIN              ( 0.01 )
+
+// Fraction of the frame rate added to the slew each frame, per frame of advantage beyond the deadband.
+// This removes the advantage left by a constant clock skew, which the proportional slew alone can't.
+#define TIME_SYNC_INTEGRAL_GAIN     ( 0.0002 )
+
+// Max fraction of the frame rate to slew in either direction
+#define TIME_SYNC_MAX_SLEW          ( 0.03 )
+
+// Weight of each new sample in the moving averages
+#define TIME_SYNC_SMOOTHING         ( 1.0 / 16 )
+
+// Number of local samples before the frame rate is adjusted
+#define TIME_SYNC_MIN_SAMPLES       ( 30 )
+
+
+// Estimates how many frames the local game is ahead of the remote game, and slews the local frame rate so both
+// sides converge on the same frame at the same time. An ahead side rolls back less and makes the other side roll
+// back more, so keeping the advantage near zero spreads the rollbacks evenly.
+//
+// The advantages are counted in input frames, ie the newest input sent minus the newest input received, so any
+// input delay cancels. If the remote reports its own advantage, the local advantage is half the difference, which
+// cancels the network latency. Otherwise the one-way latency is subtracted from the local advantage.
+class TimeSync
+{
+public:
+
+    // Frame rate to run at when the advantage is zero
+    double nominalFps = TIME_SYNC_NOMINAL_FPS;
+
+    // Update the one-way latency from the ping stats, in milliseconds
+    void gotPingLatency ( double latency );
+
+    // Update the one-way latency from a measured round trip, in frames
+    void gotRoundTrip ( double roundTrip );
+
+    // Update the local advantage, once per frame
+    void gotLocalAdvantage ( int advantage );
+
+    // Update the advantage the remote reported for itself
+    void gotRemoteAdvantage ( int advantage );
+
+    // Get the estimated number of frames the local game is ahead of the remote game
+    double getFrameAdvantage() const;
+
+    // Get the frame rate to run at, which is slower when ahead and faster when behind
+    double getDesiredFps() const;
+
+    // Get the fraction of the frame rate to slow down by, negative to speed up
+    double getSlew() const;
+
+    // Get the one-way latency in frames
+    double getLatency() const { return _latency; }
+
+    // True if the remote reported its own advantage
+    bool hasRemoteAdvantage() const { return _hasRemoteAdvantage; }
+
+    // Clear the advantages and slew, but keep the latency
+    void reset();
+
+    // Get the advantage and desired frame rate
+    std::string str() const;
+
+private:
+
+    // Moving averages of the local and remote advantages
+    double _localAdvantage = 0, _remoteAdvantage = 0;
+
+    // One-way latency in frames
+    double _latency = 0;
+
+    // Accumulated slew that cancels the clock skew
+    double _skewSlew = 0;
+
+    uint32_t _numSamples = 0;
+
+    bool _hasRemoteAdvantage = false;
+
+    // Get the advantage beyond the deadband
+    double getExcessAdvantage() const;
+};
@@ -0,0 +1,131 @@
+#include "TimelineIndex.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+
+// Find the last entry where the given field is at or before the value
+template<typename T>
+static const TimelineEntry *findLast ( const vector<TimelineEntry>& entries, T TimelineEntry::*field, T value )
+{
+    auto it = upper_bound ( entries.begin(), entries.end(), value,
+                            [field] ( T value, const TimelineEntry& entry ) { return value < entry.*field; } );
+
+    if ( it == entries.begin() )
+        return 0;
+
+    return & ( * ( it - 1 ) );
+}
+
+
+string TimelineEntry::str() const
+{
+    return format ( "[%u:%u] worldTime=%u; wallTime=%u; offset=%u; state=%u",
+                    index, startFrame, worldTime, wallTime, offset, state );
+}
+
+void TimelineIndex::push ( IndexedFrame start, uint32_t worldTime, uint64_t now, uint8_t state,
+                           uint32_t previousEndFrame )
+{
+    // Drop the entries that are being re-entered
+    while ( ! entries.empty() && entries.back().index >= start.parts.index )
+        entries.pop_back();
+
+    TimelineEntry entry;
+    entry.index = start.parts.index;
+    entry.startFrame = start.parts.frame;
+    entry.worldTime = worldTime;
+    entry.state = state;
+
+    if ( entries.empty() )
+    {
+        startWallTime = now;
+    }
+    else
+    {
+        const TimelineEntry& previous = entries.back();
+
+        entry.offset = previous.offset + ( previousEndFrame - previous.startFrame ) * TIMELINE_BYTES_PER_FRAME;
+    }
+
+    entry.wallTime = uint32_t ( now - startWallTime );
+
+    entries.push_back ( entry );
+    invalidate();
+}
+
+const TimelineEntry *TimelineIndex::find ( uint32_t index ) const
+{
+    const TimelineEntry *entry = findLast ( entries, &TimelineEntry::index, index );
+
+    if ( ! entry || entry->index != index )
+        return 0;
+
+    return entry;
+}
+
+const TimelineEntry *TimelineIndex::findWorldTime ( uint32_t worldTime ) const
+{
+    return findLast ( entries, &TimelineEntry::worldTime, worldTime );
+}
+
+const TimelineEntry *TimelineIndex::findWallTime ( uint32_t wallTime ) const
+{
+    return findLast ( entries, &TimelineEntry::wallTime, wallTime );
+}
+
+const TimelineEntry *TimelineIndex::findOffset ( uint32_t offset ) const
+{
+    return findLast ( entries, &TimelineEntry::offset, offset );
+}
+
+IndexedFrame TimelineIndex::getIndexedFrame ( uint32_t worldTime ) const
+{
+    const TimelineEntry *entry = findWorldTime ( worldTime );
+
+    if ( ! entry )
+        return MaxIndexedFrame;
+
+    IndexedFrame indexedFrame = {{ entry->startFrame + ( worldTime - entry->worldTime ), entry->index }};
+    return indexedFrame;
+}
+
+IndexedFrame TimelineIndex::getIndexedFrameAtOffset ( uint32_t offset ) const
+{
+    const TimelineEntry *entry = findOffset ( offset );
+
+    if ( ! entry )
+        return MaxIndexedFrame;
+
+    IndexedFrame indexedFrame =
+        {{ entry->startFrame + uint32_t ( ( offset - entry->offset ) / TIMELINE_BYTES_PER_FRAME ), entry->index }};
+    return indexedFrame;
+}
+
+uint32_t TimelineIndex::getWorldTime ( IndexedFrame indexedFrame ) const
+{
+    const TimelineEntry *entry = find ( indexedFrame.parts.index );
+
+    if ( ! entry || indexedFrame.parts.frame < entry->startFrame )
+        return UINT_MAX;
+
+    return entry->worldTime + ( indexedFrame.parts.frame - entry->startFrame );
+}
+
+uint32_t TimelineIndex::getOffset ( IndexedFrame indexedFrame ) const
+{
+    const TimelineEntry *entry = find ( indexedFrame.parts.index );
+
+    if ( ! entry || indexedFrame.parts.frame < entry->startFrame )
+        return UINT_MAX;
+
+    return entry->offset + ( indexedFrame.parts.frame - entry->startFrame ) * TIMELINE_BYTES_PER_FRAME;
+}
+
+void TimelineIndex::clear()
+{
+    startWallTime = 0;
+    entries.clear();
+    invalidate();
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Protocol.hpp"
+#include "Constants.hpp"
+#include "StringUtils.hpp"
+
+#include <cereal/types/vector.hpp>
+
+#include <vector>
+
+
+// Number of bytes in the input stream per frame, ie the inputs of both players
+#define TIMELINE_BYTES_PER_FRAME    ( 2 * sizeof ( uint16_t ) )
+
+
+// The start of a transition index in the session
+struct TimelineEntry
+{
+    // Transition index and the frame it starts on
+    uint32_t index = 0, startFrame = 0;
+
+    // Value of the world timer on the start frame
+    uint32_t worldTime = 0;
+
+    // Milliseconds since the start of the timeline
+    uint32_t wallTime = 0;
+
+    // Byte offset of the start frame in the input stream
+    uint32_t offset = 0;
+
+    // NetplayState entered on this index
+    uint8_t state = 0;
+
+    std::string str() const;
+
+    CEREAL_CLASS_BOILERPLATE ( index, startFrame, worldTime, wallTime, offset, state )
+};
+
+
+// Compact timeline of the session, with one entry per transition index. Maps between index:frame, world time,
+// wall-clock time, and byte offsets in the input stream, which is both players' inputs for each frame since the
+// start of the timeline. All of these increase with the index, so each lookup is a binary search.
+class TimelineIndex : public SerializableSequence
+{
+public:
+
+    // Wall-clock time of the first entry, in milliseconds
+    uint64_t startWallTime = 0;
+
+    // Entries sorted by index
+    std::vector<TimelineEntry> entries;
+
+    // Add an entry for the index that starts at the given index:frame. The previous index ended on previousEndFrame,
+    // which is ignored for the first entry. Re-entering an index after a rollback replaces the entries from it on.
+    void push ( IndexedFrame start, uint32_t worldTime, uint64_t now, uint8_t state, uint32_t previousEndFrame );
+
+    // Find the entry for the given index, returns null if not found
+    const TimelineEntry *find ( uint32_t index ) const;
+
+    // Find the last entry that started at or before the given time / offset, returns null if before the first entry
+    const TimelineEntry *findWorldTime ( uint32_t worldTime ) const;
+    const TimelineEntry *findWallTime ( uint32_t wallTime ) const;
+    const TimelineEntry *findOffset ( uint32_t offset ) const;
+
+    // Convert between index:frame, world time, and byte offsets, returns MaxIndexedFrame or UINT_MAX if not found
+    IndexedFrame getIndexedFrame ( uint32_t worldTime ) const;
+    IndexedFrame getIndexedFrameAtOffset ( uint32_t offset ) const;
+    uint32_t getWorldTime ( IndexedFrame indexedFrame ) const;
+    uint32_t getOffset ( IndexedFrame indexedFrame ) const;
+
+    bool empty() const { return entries.empty(); }
+
+    size_t size() const { return entries.size(); }
+
+    void clear();
+
+    std::string str() const override
+    {
+        std::string str = format ( "TimelineIndex: %u entries", entries.size() );
+
+        for ( const TimelineEntry& entry : entries )
+            str += "\n" + entry.str();
+
+        return str;
+    }
+
+    PROTOCOL_MESSAGE_BOILERPLATE ( TimelineIndex, startWallTime, entries )
+};
@@ -4,6 +4,7 @@
 #include "DllAsmHacks.hpp"
 #include "KeyboardState.hpp"
 #include "CharacterSelect.hpp"
+#include "Profiler.hpp"
 
 #include <windows.h>
 
@@ -41,6 +42,45 @@ bool DllControllerManager::isNotMapping() const
             && ( !_playerControllers[1] || !_playerControllers[1]->isMapping() );
 }
 
+void DllControllerManager::latchControls ( uint64_t targetTicks )
+{
+    // Ignore samples that were queued more than a frame before the target, ie while nothing was consuming them
+    const uint64_t maxAge = Profiler::getTicksPerSecond() / 60;
+
+    array<uint64_t, 2> distances = {{ UINT64_MAX, UINT64_MAX }};
+
+    _latchedSamples[0].controller = _latchedSamples[1].controller = 0;
+
+    ControllerSample sample;
+
+    while ( ControllerManager::get().popSample ( sample ) )
+    {
+        if ( sample.ticks + maxAge < targetTicks )
+            continue;
+
+        const uint64_t distance = ( sample.ticks > targetTicks ? sample.ticks - targetTicks : targetTicks - sample.ticks );
+
+        for ( uint8_t i = 0; i < 2; ++i )
+        {
+            if ( sample.controller != _playerControllers[i] || distance > distances[i] )
+                continue;
+
+            _latchedSamples[i] = sample;
+            distances[i] = distance;
+        }
+    }
+}
+
+uint16_t DllControllerManager::getLatchedInput ( uint8_t player ) const
+{
+    const Controller *controller = _playerControllers[player - 1];
+
+    if ( _latchedSamples[player - 1].controller != controller )
+        return getInput ( controller );
+
+    return convertInputState ( _latchedSamples[player - 1].state, controller->isKeyboard() );
+}
+
 void DllControllerManager::updateControls ( uint16_t *localInputs )
 {
     if ( stopping )
@@ -157,10 +197,10 @@ void DllControllerManager::updateControls ( uint16_t *localInputs )
     if ( !DllOverlayUi::isEnabled() || ProcessManager::isWine() )
     {
         if ( _playerControllers[localPlayer - 1] )
-            localInputs[0] = getInput ( _playerControllers[localPlayer - 1] );
+            localInputs[0] = getLatchedInput ( localPlayer );
 
         if ( _playerControllers[remotePlayer - 1] )
-            localInputs[1] = getInput ( _playerControllers[remotePlayer - 1] );
+            localInputs[1] = getLatchedInput ( remotePlayer );
 
         return;
     }
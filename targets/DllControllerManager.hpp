@@ -30,6 +30,10 @@ public:
     // True only if both controllers are not mapping
     bool isNotMapping() const;
 
+    // Latch the state of each player controller that was polled nearest to the given Profiler ticks.
+    // This doesn't lock the controllers, and should be called once per frame before updateControls.
+    void latchControls ( uint64_t targetTicks );
+
     // Update local controls and overlay UI inputs
     void updateControls ( uint16_t *localInputs );
 
@@ -52,9 +56,15 @@ private:
 
     std::array<Controller *, 2> _playerControllers = {{ 0, 0 }};
 
+    // Latched state of each player controller, only valid if the controller matches
+    std::array<ControllerSample, 2> _latchedSamples = {{ { 0, 0, 0 }, { 0, 0, 0 } }};
+
     std::array<size_t, 2> _overlayPositions = {{ 0, 0 }};
 
     std::array<bool, 2> _finishedMapping = {{ false, false }};
 
     bool _controllerAttached = false;
+
+    // Get the latched input of the given player controller, or the current input if none was latched
+    uint16_t getLatchedInput ( uint8_t player ) const;
 };
@@ -3,6 +3,7 @@
 #include "Constants.hpp"
 #include "ProcessManager.hpp"
 #include "DllAsmHacks.hpp"
+#include "Profiler.hpp"
 
 #include <d3dx9.h>
 
@@ -19,6 +20,8 @@ double actualFps = 60.0;
 
 bool isEnabled = false;
 
+uint64_t lastFrameTicks = 0;
+
 
 void enable()
 {
@@ -42,6 +45,9 @@ void PresentFrameEnd ( IDirect3DDevice9 *device )
     if ( !isEnabled || *CC_SKIP_FRAMES_ADDR )
         return;
 
+    // This includes the time spent waiting to limit the frame rate
+    PROFILE_SCOPE ( PresentFrameEnd );
+
     static uint64_t last1f = 0, last5f = 0, last30f = 0, last60f = 0;
     static uint8_t counter = 0;
 
@@ -78,6 +84,8 @@ void PresentFrameEnd ( IDirect3DDevice9 *device )
 
     last1f = now;
 
+    lastFrameTicks = Profiler::getTicks();
+
     if ( counter >= 60 )
     {
         now = TimerManager::get().getNow ( true );
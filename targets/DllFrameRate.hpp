@@ -10,6 +10,11 @@ extern double desiredFps;
 
 extern double actualFps;
 
+extern bool isEnabled;
+
+// Profiler ticks at the end of the last frame, after waiting to limit the frame rate
+extern uint64_t lastFrameTicks;
+
 void enable();
 
 }
@@ -16,6 +16,7 @@
 #include "DllFrameRate.hpp"
 #include "ReplayManager.hpp"
 #include "DllRollbackManager.hpp"
+#include "Profiler.hpp"
 
 #include <windows.h>
 
@@ -29,6 +30,9 @@ using namespace std;
 // The main log file path
 #define LOG_FILE                    FOLDER "dll.log"
 
+// The profiler CSV file path, written when the session ends
+#define PROFILE_FILE                FOLDER "profile.csv"
+
 // The number of milliseconds to poll for events each frame
 #define POLL_TIMEOUT                ( 3 )
 
@@ -181,6 +185,8 @@ struct DllMain
 
     void frameStepNormal()
     {
+        PROFILE_SCOPE ( FrameStepNormal );
+
         switch ( netMan.getState().value )
         {
             case NetplayState::PreInitial:
@@ -225,8 +231,10 @@ struct DllMain
                     }
                 }
 
-                // Update controller state once per frame
+                // Update controller state once per frame, using the states polled nearest the end of the last frame,
+                // so the input latency doesn't depend on how long the frame step took to get here.
                 KeyboardState::update();
+                latchControls ( DllFrameRate::isEnabled ? DllFrameRate::lastFrameTicks : Profiler::getTicks() );
                 updateControls ( &localInputs[0] );
 
                 if ( DllOverlayUi::isEnabled() )                                            // Overlay UI controls
@@ -308,7 +316,13 @@ struct DllMain
                 }
 
 #ifndef RELEASE
-                DllOverlayUi::debugText = format ( "%+d [%s]", netMan.getRemoteFrameDelta(), netMan.getIndexedFrame() );
+                DllOverlayUi::debugText = format ( "%+d [%s] rollback=%u/%u\n%s\n%s\n%s\n%s",
+                                                   netMan.getRemoteFrameDelta(), netMan.getIndexedFrame(),
+                                                   rollMan.getRollbackDistances().getPercentile ( 1.0 ),
+                                                   rollMan.getNumStates(), Profiler::get().str(),
+                                                   netMan.getInputsWindow().str(),
+                                                   netMan.getInputPredictors().str(),
+                                                   netMan.getTimeSync().str() );
                 DllOverlayUi::debugTextAlign = 1;
 
                 // Replay inputs and rollback
@@ -454,7 +468,13 @@ struct DllMain
                         break;
                     }
 
-                    dataSocket->send ( netMan.getInputs ( localPlayer ) );
+                    const MsgPtr msgInputs = netMan.getInputs ( localPlayer );
+
+                    dataSocket->send ( msgInputs );
+
+                    // Send inputs twice on very lossy links
+                    if ( netMan.shouldDuplicateInputs() )
+                        dataSocket->send ( msgInputs );
                 }
                 else if ( clientMode.isLocal() )
                 {
@@ -529,6 +549,13 @@ struct DllMain
             }
         }
 
+        // Slew the frame rate towards the remote, once the remote inputs for this frame are ready
+        if ( clientMode.isNetplay() )
+        {
+            netMan.updateTimeSync();
+            DllFrameRate::desiredFps = netMan.getTimeSync().getDesiredFps();
+        }
+
         if ( rollbackTimer < minRollbackSpacing )
         {
             --rollbackTimer;
@@ -751,6 +778,7 @@ struct DllMain
             LOG_TO ( syncLog, "Desync:" );
             LOG_TO ( syncLog, "< %s", L.dump() );
             LOG_TO ( syncLog, "> %s", R.dump() );
+            LOG_TO ( syncLog, "%s", netMan.getTimeline().str() );
 
 #undef L
 #undef R
@@ -854,6 +882,8 @@ struct DllMain
 
     void frameStepRerun()
     {
+        PROFILE_SCOPE ( FrameStepRerun );
+
         // Here we don't save any game states while re-running because the inputs are faked
 
         // Save sound state during rollback re-run
@@ -888,6 +918,7 @@ struct DllMain
     void frameStep()
     {
         // New frame
+        Profiler::get().nextFrame();
         netMan.updateFrame();
         procMan.clearInputs();
 
@@ -977,6 +1008,17 @@ struct DllMain
             AsmHacks::numLoadedColors = 0;
         }
 
+        // Entering Initial, the data socket was just connected
+        if ( state == NetplayState::Initial && dataSocket && netMan.config.mode.isFastChecksum() )
+        {
+            // Use the faster checksum for the per-frame messages, since both sides support it
+            dataSocket->setChecksumType ( Checksum::getFastest() );
+        }
+
+        // Entering Initial, frame the control messages if both sides support it
+        if ( state == NetplayState::Initial && ctrlSocket && netMan.config.mode.isFramedMessages() )
+            ctrlSocket->setFramed ( true );
+
         // Entering InGame
         if ( state == NetplayState::InGame )
         {
@@ -1286,6 +1328,10 @@ struct DllMain
                     return;
                 }
 
+                // Frame the spectate stream, if the spectator can read framed messages
+                if ( msg->getAs<VersionConfig>().mode.isFramedMessages() )
+                    socket->setFramed ( true );
+
                 socket->send ( new SpectateConfig ( netMan.config, netMan.getState().value ) );
                 return;
             }
@@ -1333,6 +1379,10 @@ struct DllMain
                         netMan.setInputs ( remotePlayer, msg->getAs<PlayerInputs>() );
                         return;
 
+                    case MsgType::DeltaInputs:
+                        netMan.setInputs ( remotePlayer, msg->getAs<DeltaInputs>() );
+                        return;
+
                     case MsgType::MenuIndex:
                         netMan.setRemoteRetryMenuIndex ( msg->getAs<MenuIndex>().menuIndex );
                         return;
@@ -1558,6 +1608,10 @@ struct DllMain
 #endif // NOT RELEASE
                 break;
 
+            case MsgType::PingStats:
+                netMan.setPingLatency ( msg->getAs<PingStats>().latency.getMean() );
+                break;
+
             case MsgType::ControllerMappings:
                 KeyboardState::clear();
                 initControllers ( msg->getAs<ControllerMappings>() );
@@ -1862,6 +1916,9 @@ struct DllMain
     {
         rollMan.deallocateStates();
 
+        if ( ! Profiler::get().saveCsv ( ProcessManager::appDir + PROFILE_FILE ) )
+            LOG ( "Failed to save: %s", PROFILE_FILE );
+
         KeyboardManager::get().unhook();
 
         syncLog.deinitialize();
@@ -1904,6 +1961,9 @@ private:
 
 static void initializeDllMain()
 {
+    // Only the DLL advances profiler frames, so only record profiler scopes here
+    Profiler::enabled = true;
+
     mainApp.reset ( new DllMain() );
 }
 
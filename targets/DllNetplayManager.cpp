@@ -3,6 +3,7 @@
 #include "ProcessManager.hpp"
 #include "Exceptions.hpp"
 #include "CharacterSelect.hpp"
+#include "TimerManager.hpp"
 
 #include <algorithm>
 #include <cmath>
@@ -403,70 +404,83 @@ uint16_t NetplayManager::getMenuNavInput()
     return 0;
 }
 
-bool NetplayManager::hasUpDownInHistory ( uint8_t player, uint32_t start, uint32_t end ) const
+template<typename F>
+bool NetplayManager::forEachInputSpan ( uint8_t player, uint32_t start, uint32_t end, F f ) const
 {
-    for ( size_t i = start; i < end; ++i )
-    {
-        if ( i > getFrame() )
-            break;
+    ASSERT ( player == 1 || player == 2 );
+    ASSERT ( getIndex() >= _startIndex );
 
-        if ( player == 0 )
-        {
-            const uint16_t p1dir = 0xF & getRawInput ( 1, getFrame() - i );
+    if ( start >= end )
+        return true;
 
-            const uint16_t p2dir = 0xF & getRawInput ( 2, getFrame() - i );
+    if ( start > getFrame() )
+        return false;
 
-            if ( ( p1dir == 2 ) || ( p1dir == 8 ) || ( p2dir == 2 ) || ( p2dir == 8 ) )
-                return true;
-        }
-        else
-        {
-            ASSERT ( player == 1 || player == 2 );
+    // The frames counting backwards from the current frame, which stop at frame 0
+    const uint32_t first = getFrame() - min ( end - 1, getFrame() );
+    const uint32_t last = getFrame() - start + 1;
 
-            const uint16_t dir = 0xF & getRawInput ( player, getFrame() - i );
+    const uint32_t index = getIndex() - _startIndex;
+    uint32_t known = _inputs[player - 1].getEndFrame ( index );
 
-            if ( ( dir == 2 ) || ( dir == 8 ) )
-                return true;
-        }
+    if ( player == _remotePlayer && ! _predictedInputs.empty() && _predictedFrame.parts.index == getIndex() )
+        known = min ( known, _predictedFrame.parts.frame );
+
+    const uint32_t split = min ( max ( known, first ), last );
+
+    if ( first < split )
+        _inputs[player - 1].forEachSpan ( index, first, split - first, f );
+
+    // The rest are missing inputs, which are predicted or the last known input
+    for ( uint32_t frame = split; frame < last; ++frame )
+    {
+        const uint16_t input = getRawInput ( player, frame );
+        f ( &input, 1 );
     }
 
-    return false;
+    return ( end - 1 <= getFrame() );
 }
 
-bool NetplayManager::hasButtonInHistory ( uint8_t player, uint16_t button, uint32_t start, uint32_t end ) const
+bool NetplayManager::hasUpDownInHistory ( uint8_t player, uint32_t start, uint32_t end ) const
 {
-    ASSERT ( player == 1 || player == 2 );
+    if ( player == 0 )
+        return hasUpDownInHistory ( 1, start, end ) || hasUpDownInHistory ( 2, start, end );
 
-    for ( size_t i = start; i < end; ++i )
+    bool found = false;
+
+    forEachInputSpan ( player, start, end, [&] ( const uint16_t *inputs, size_t n )
     {
-        if ( i > getFrame() )
-            break;
+        for ( size_t i = 0; i < n; ++i )
+            found |= ( ( inputs[i] & 0xF ) == 2 ) | ( ( inputs[i] & 0xF ) == 8 );
+    } );
 
-        const uint16_t buttons = getRawInput ( player, getFrame() - i ) >> 4;
+    return found;
+}
 
-        if ( buttons & button )
-            return true;
-    }
+bool NetplayManager::hasButtonInHistory ( uint8_t player, uint16_t button, uint32_t start, uint32_t end ) const
+{
+    uint16_t inputs = 0;
 
-    return false;
+    forEachInputSpan ( player, start, end, [&] ( const uint16_t *span, size_t n )
+    {
+        for ( size_t i = 0; i < n; ++i )
+            inputs |= span[i];
+    } );
+
+    return ( ( inputs >> 4 ) & button );
 }
 
 bool NetplayManager::heldButtonInHistory ( uint8_t player, uint16_t button, uint32_t start, uint32_t end ) const
 {
-    ASSERT ( player == 1 || player == 2 );
+    bool held = true;
 
-    for ( size_t i = start; i < end; ++i )
+    const bool complete = forEachInputSpan ( player, start, end, [&] ( const uint16_t *inputs, size_t n )
     {
-        if ( i > getFrame() )
-            return false;
+        for ( size_t i = 0; i < n; ++i )
+            held &= ( ( ( inputs[i] >> 4 ) & button ) != 0 );
+    } );
 
-        const uint16_t buttons = getRawInput ( player, getFrame() - i ) >> 4;
-
-        if ( ! ( buttons & button ) )
-            return false;
-    }
-
-    return true;
+    return ( complete && held );
 }
 
 void NetplayManager::setRemotePlayer ( uint8_t player )
@@ -505,6 +519,8 @@ void NetplayManager::setState ( NetplayState state )
 
     if ( state.value >= NetplayState::CharaSelect )
     {
+        const uint32_t previousEndFrame = _indexedFrame.parts.frame;
+
         if ( _state == NetplayState::AutoCharaSelect )
         {
             // Start from the initial index and frame
@@ -522,6 +538,11 @@ void NetplayManager::setState ( NetplayState state )
             _indexedFrame.parts.frame = 0;
         }
 
+        _timeline.push ( _indexedFrame, _startWorldTime + _indexedFrame.parts.frame,
+                         TimerManager::get().getNow ( true ), state.value, previousEndFrame );
+
+        LOG ( "Timeline: %s", _timeline.entries.back().str() );
+
         // Entering CharaSelect
         if ( state == NetplayState::CharaSelect )
             _spectateStartIndex = getIndex();
@@ -584,6 +605,10 @@ uint16_t NetplayManager::getInput ( uint8_t player )
 {
     ASSERT ( player == 1 || player == 2 );
 
+    // The missing remote inputs must be predicted before any of them are read
+    if ( isInRollback() )
+        predictInputs();
+
     switch ( _state.value )
     {
         case NetplayState::PreInitial:
@@ -625,9 +650,96 @@ uint16_t NetplayManager::getRawInput ( uint8_t player, uint32_t frame ) const
     ASSERT ( player == 1 || player == 2 );
     ASSERT ( getIndex() >= _startIndex );
 
+    if ( player == _remotePlayer && ! _predictedInputs.empty()
+            && _predictedFrame.parts.index == getIndex() && frame >= _predictedFrame.parts.frame )
+    {
+        return _predictedInputs [ min<size_t> ( frame - _predictedFrame.parts.frame, _predictedInputs.size() - 1 ) ];
+    }
+
     return _inputs[player - 1].get ( getIndex() - _startIndex, frame );
 }
 
+void NetplayManager::predictInputs()
+{
+    ASSERT ( getIndex() >= _startIndex );
+
+    const InputsContainer<uint16_t>& remote = _inputs[_remotePlayer - 1];
+    const uint32_t index = getIndex() - _startIndex;
+
+    // Only predict while the remote has some, but not all, of its inputs for the current index
+    if ( remote.getEndIndex() != index + 1 || remote.getEndFrame() == 0 )
+    {
+        _predictedInputs.clear();
+        return;
+    }
+
+    const uint32_t endFrame = remote.getEndFrame();
+
+    if ( _predictedFrame.value != IndexedFrame {{ endFrame, getIndex() }}.value )
+    {
+        _predictedInputs.clear();
+        _predictedFrame = {{ endFrame, getIndex() }};
+    }
+
+    uint32_t next = endFrame + _predictedInputs.size();
+
+    if ( next > getFrame() )
+        return;
+
+    // Each input is predicted from the known and predicted inputs before it
+    array<uint16_t, INPUT_PREDICTOR_HISTORY> history;
+    size_t n = 0;
+
+    for ( uint32_t f = next - min<uint32_t> ( next, INPUT_PREDICTOR_HISTORY ); f < next; ++f )
+        history[n++] = ( f < endFrame ? remote.get ( index, f ) : _predictedInputs[f - endFrame] );
+
+    for ( ; next <= getFrame(); ++next )
+    {
+        const uint16_t input = _inputPredictors.predict ( &history[0], n );
+
+        _predictedInputs.push_back ( input );
+
+        if ( n == history.size() )
+            copy ( history.begin() + 1, history.end(), history.begin() );
+        else
+            ++n;
+
+        history[n - 1] = input;
+    }
+}
+
+void NetplayManager::trainPredictors ( uint32_t index, uint32_t frame )
+{
+    const InputsContainer<uint16_t>& remote = _inputs[_remotePlayer - 1];
+    const uint32_t endFrame = remote.getEndFrame ( index );
+
+    if ( frame >= endFrame )
+        return;
+
+    // Walk the new inputs with the history before them, keeping the previous inputs like predictInputs
+    const uint32_t first = frame - min<uint32_t> ( frame, INPUT_PREDICTOR_HISTORY );
+
+    array<uint16_t, INPUT_PREDICTOR_HISTORY> history;
+    size_t n = 0;
+    uint32_t f = first;
+
+    remote.forEachSpan ( index, first, endFrame - first, [&] ( const uint16_t *inputs, size_t count )
+    {
+        for ( size_t i = 0; i < count; ++i, ++f )
+        {
+            if ( f >= frame && n > 0 )
+                _inputPredictors.gotInput ( &history[0], n, inputs[i] );
+
+            if ( n == history.size() )
+                copy ( history.begin() + 1, history.end(), history.begin() );
+            else
+                ++n;
+
+            history[n - 1] = inputs[i];
+        }
+    } );
+}
+
 void NetplayManager::setInput ( uint8_t player, uint16_t input )
 {
     ASSERT ( player == 1 || player == 2 );
@@ -666,7 +778,25 @@ MsgPtr NetplayManager::getInputs ( uint8_t player ) const
     ASSERT ( getIndex() >= _startIndex );
     ASSERT ( _inputs[player - 1].getEndFrame ( getIndex() - _startIndex ) >= 1 );
 
-    PlayerInputs *playerInputs = new PlayerInputs ( { _inputs[player - 1].getEndFrame() - 1, getIndex() } );
+    const IndexedFrame indexedFrame = {{ _inputs[player - 1].getEndFrame() - 1, getIndex() }};
+
+    if ( config.mode.isDeltaInputs() )
+    {
+        // Ack the remote inputs received so far, which are always received in order
+        const uint32_t remoteEndIndex = _inputs[_remotePlayer - 1].getEndIndex();
+        const IndexedFrame ack = {{ _inputs[_remotePlayer - 1].getEndFrame(),
+                                    ( remoteEndIndex ? _startIndex + remoteEndIndex - 1 : 0 ) }};
+
+        DeltaInputs *deltaInputs =
+            new DeltaInputs ( indexedFrame, ack, _inputsWindow.getNumInputs ( indexedFrame, _remoteAck ) );
+
+        _inputs[player - 1].get ( deltaInputs->getIndex() - _startIndex, deltaInputs->getStartFrame(),
+                                  &deltaInputs->inputs[0], deltaInputs->size() );
+
+        return MsgPtr ( deltaInputs );
+    }
+
+    PlayerInputs *playerInputs = new PlayerInputs ( indexedFrame );
 
     ASSERT ( playerInputs->getIndex() >= _startIndex );
 
@@ -677,19 +807,113 @@ MsgPtr NetplayManager::getInputs ( uint8_t player ) const
 }
 
 void NetplayManager::setInputs ( uint8_t player, const PlayerInputs& playerInputs )
+{
+    setInputs ( player, { playerInputs.getStartFrame(), playerInputs.getIndex() },
+                &playerInputs.inputs[0], playerInputs.size() );
+}
+
+void NetplayManager::setInputs ( uint8_t player, const DeltaInputs& deltaInputs )
+{
+    // Acks can arrive out of order, so only keep the newest one
+    if ( deltaInputs.ack.value > _remoteAck.value )
+        _remoteAck = deltaInputs.ack;
+
+    if ( ! _inputs[_localPlayer - 1].empty() )
+    {
+        const IndexedFrame localFrame =
+        {{
+            _inputs[_localPlayer - 1].getEndFrame() - 1,
+            _inputs[_localPlayer - 1].getEndIndex() - 1 + _startIndex
+        }};
+
+        _inputsWindow.gotRemoteAck ( _remoteAck, localFrame );
+    }
+
+    _inputsWindow.gotRemoteFrame ( deltaInputs.indexedFrame );
+
+    // The remote advantage is its newest input minus the newest input of ours it had, if in the same index
+    if ( deltaInputs.ack.parts.index == deltaInputs.getIndex() )
+        _timeSync.gotRemoteAdvantage ( int ( deltaInputs.getEndFrame() ) - int ( deltaInputs.ack.parts.frame ) );
+
+    _timeSync.gotRoundTrip ( _inputsWindow.getRoundTrip() );
+
+    // Drop inputs that would leave a gap, the remote resends them once our ack is overdue.
+    // A full window means the remote can't resend older inputs, so the gap is filled like with PlayerInputs.
+    if ( deltaInputs.getIndex() >= _startIndex && deltaInputs.size() < MAX_INPUTS_WINDOW
+            && deltaInputs.getStartFrame() > _inputs[player - 1].getEndFrame ( deltaInputs.getIndex() - _startIndex ) )
+    {
+        return;
+    }
+
+    setInputs ( player, { deltaInputs.getStartFrame(), deltaInputs.getIndex() },
+                &deltaInputs.inputs[0], deltaInputs.size() );
+}
+
+void NetplayManager::setInputs ( uint8_t player, IndexedFrame start, const uint16_t *inputs, size_t n )
 {
     // Only keep remote inputs at most 1 transition index old, but at least as new as the startIndex
-    if ( playerInputs.getIndex() + 1 < getIndex() || playerInputs.getIndex() < _startIndex )
+    if ( start.parts.index + 1 < getIndex() || start.parts.index < _startIndex )
         return;
 
     ASSERT ( player == 1 || player == 2 );
     ASSERT ( getIndex() >= _startIndex );
-    ASSERT ( playerInputs.getIndex() >= _startIndex );
+    ASSERT ( start.parts.index >= _startIndex );
 
+    const uint32_t index = start.parts.index - _startIndex;
     const uint32_t checkStartingFromIndex = ( isInRollback() ? getIndex() - _startIndex : UINT_MAX );
+    const uint32_t endFrame = _inputs[player - 1].getEndFrame ( index );
+    const uint32_t newEndFrame = max<uint32_t> ( endFrame, start.parts.frame + n );
+
+    const bool isPredicted = ( player == _remotePlayer && ! _predictedInputs.empty()
+                               && _predictedFrame.value == IndexedFrame {{ endFrame, start.parts.index }}.value );
+
+    // Set the predicted inputs the game ran with first, so the actual inputs are checked against them.
+    // This also fills any gap with the predicted inputs.
+    const size_t numPredicted = ( isPredicted ? min<size_t> ( _predictedInputs.size(), newEndFrame - endFrame ) : 0 );
+
+    if ( numPredicted )
+        _inputs[player - 1].set ( index, endFrame, &_predictedInputs[0], numPredicted );
+
+    _inputs[player - 1].set ( index, start.parts.frame, inputs, n, checkStartingFromIndex );
+
+    if ( isPredicted )
+    {
+        const uint32_t first = max ( start.parts.frame, endFrame );
+        const uint32_t last = endFrame + numPredicted;
+
+        // The rest of the predicted inputs are only kept if every replaced prediction was correct,
+        // otherwise they are predicted again from the actual inputs after rolling back.
+        if ( first >= last || equal ( &inputs[first - start.parts.frame], &inputs[last - start.parts.frame],
+                                      &_predictedInputs[first - endFrame] ) )
+        {
+            _predictedInputs.erase ( _predictedInputs.begin(), _predictedInputs.begin() + numPredicted );
+        }
+        else
+        {
+            _predictedInputs.clear();
+        }
+
+        _predictedFrame.parts.frame = newEndFrame;
+    }
+
+    if ( player == _remotePlayer && isInRollback() )
+        trainPredictors ( index, max ( start.parts.frame, endFrame ) );
+}
+
+void NetplayManager::updateTimeSync()
+{
+    const InputsContainer<uint16_t>& localInputs = _inputs[_localPlayer - 1];
+    const InputsContainer<uint16_t>& remoteInputs = _inputs[_remotePlayer - 1];
+
+    // Only run at the nominal frame rate outside of netplay games, and start over each game
+    if ( ! config.mode.isNetplay() || ! isInGame() || localInputs.empty() || remoteInputs.empty()
+            || localInputs.getEndIndex() != remoteInputs.getEndIndex() )
+    {
+        _timeSync.reset();
+        return;
+    }
 
-    _inputs[player - 1].set ( playerInputs.getIndex() - _startIndex, playerInputs.getStartFrame(),
-                              &playerInputs.inputs[0], playerInputs.size(), checkStartingFromIndex );
+    _timeSync.gotLocalAdvantage ( int ( localInputs.getEndFrame() ) - int ( remoteInputs.getEndFrame() ) );
 }
 
 MsgPtr NetplayManager::getBothInputs ( IndexedFrame& pos ) const
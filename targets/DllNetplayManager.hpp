@@ -2,6 +2,10 @@
 
 #include "Messages.hpp"
 #include "InputsContainer.hpp"
+#include "InputsWindow.hpp"
+#include "InputPredictor.hpp"
+#include "TimeSync.hpp"
+#include "TimelineIndex.hpp"
 #include "NetplayStates.hpp"
 
 #include <vector>
@@ -63,6 +67,9 @@ public:
     bool isInGame() const { return _state == NetplayState::InGame; }
     bool isInRollback() const { return isInGame() && config.rollback && config.mode.isNetplay(); }
 
+    // Get the start frame, world time, wall-clock time, and input offset of each index in this session
+    const TimelineIndex& getTimeline() const { return _timeline; }
+
     // Get / set the input for the current frame given the player
     uint16_t getInput ( uint8_t player );
     uint16_t getRawInput ( uint8_t player ) const { return getRawInput ( player, getFrame() ); }
@@ -71,9 +78,28 @@ public:
     void assignInput ( uint8_t player, uint16_t input, uint32_t frame );
     void assignInput ( uint8_t player, uint16_t input, IndexedFrame indexedFrame );
 
-    // Get / set batch inputs for the given player
+    // Get / set batch inputs for the given player, this returns DeltaInputs if config.mode.isDeltaInputs()
     MsgPtr getInputs ( uint8_t player ) const;
     void setInputs ( uint8_t player, const PlayerInputs& playerInputs );
+    void setInputs ( uint8_t player, const DeltaInputs& deltaInputs );
+
+    // Get the window that sizes DeltaInputs from the measured packet loss and round trip
+    const InputsWindow& getInputsWindow() const { return _inputsWindow; }
+
+    // True if inputs messages should be sent twice on very lossy links
+    bool shouldDuplicateInputs() const { return config.mode.isDeltaInputs() && _inputsWindow.shouldDuplicate(); }
+
+    // Get the predictors for the missing remote inputs during rollback
+    const InputPredictors& getInputPredictors() const { return _inputPredictors; }
+
+    // Get the controller that slews the frame rate so both sides run the same frame at the same time
+    const TimeSync& getTimeSync() const { return _timeSync; }
+
+    // Update the frame advantage, should be called once per frame after the remote inputs are ready
+    void updateTimeSync();
+
+    // Set the one-way latency measured before the game started, in milliseconds
+    void setPingLatency ( double latency ) { _timeSync.gotPingLatency ( latency ); }
 
     // Get inputs both players. May return null if not enough inputs are ready for the given pos.
     // Otherwise this increments the given pos by at most NUM_INPUTS if returning non-null.
@@ -177,6 +203,37 @@ private:
     // The remote player, ie the one where setInputs gets called for each input message
     uint8_t _remotePlayer = 2;
 
+    // Most recent ack received from the remote, only inputs after this are included in DeltaInputs
+    IndexedFrame _remoteAck = {{ 0, 0 }};
+
+    // Number of inputs to include in DeltaInputs
+    InputsWindow _inputsWindow;
+
+    // Predicts the missing remote inputs during rollback, trained on the remote inputs of this session
+    InputPredictors _inputPredictors;
+
+    // Remote inputs predicted for the frames after the known remote inputs of the current index.
+    // These are the inputs the game ran with, so the actual inputs are checked against them once they arrive.
+    std::vector<uint16_t> _predictedInputs;
+
+    // Index:frame of the first predicted input, this is always the end of the known remote inputs
+    IndexedFrame _predictedFrame = {{ 0, 0 }};
+
+    // Estimates the frame advantage and the frame rate that cancels it
+    TimeSync _timeSync;
+
+    // Timeline of the indices in this session, including the ones erased from the inputs
+    TimelineIndex _timeline;
+
+    // Set batch inputs for the given player, starting from the given index:frame
+    void setInputs ( uint8_t player, IndexedFrame start, const uint16_t *inputs, size_t n );
+
+    // Predict the missing remote inputs up to the current frame
+    void predictInputs();
+
+    // Train the predictors with the actual remote inputs from the given frame to the end of the index
+    void trainPredictors ( uint32_t index, uint32_t frame );
+
     // Get the input for the specific NetplayState
     uint16_t getPreInitialInput ( uint8_t player );
     uint16_t getInitialInput ( uint8_t player );
@@ -195,6 +252,11 @@ private:
     bool hasButtonInHistory ( uint8_t player, uint16_t button, uint32_t start, uint32_t end ) const;
     bool heldButtonInHistory ( uint8_t player, uint16_t button, uint32_t start, uint32_t end ) const;
 
+    // Call f ( const uint16_t *, size_t ) with each contiguous span of raw inputs from the start to end frames
+    // before the current frame, oldest first. Returns false if any of the frames are before frame 0.
+    template<typename F>
+    bool forEachInputSpan ( uint8_t player, uint32_t start, uint32_t end, F f ) const;
+
     // Get the buffered preserveStartIndex
     uint32_t getBufferedPreserveStartIndex() const;
 };
@@ -2,6 +2,9 @@
 #include "MemDump.hpp"
 #include "DllAsmHacks.hpp"
 #include "ErrorStringsExt.hpp"
+#include "Compression.hpp"
+#include "MemKernels.hpp"
+#include "Profiler.hpp"
 
 #include <utility>
 #include <algorithm>
@@ -13,35 +16,55 @@ using namespace std;
 extern const unsigned char binary_res_rollback_bin_start;
 extern const unsigned char binary_res_rollback_bin_end;
 
-// Deserialized rollback memory data
-static MemDumpList allAddrs;
+// Rollback memory data, the ops are used in place from the linked data
+static MemDumpPlan allAddrs;
 
 template<typename T>
 static inline void deleteArray ( T *ptr ) { delete[] ptr; }
 
 
-void DllRollbackManager::GameState::save()
+// Same clock as the profiler, so the rollback stats and the profiler sections can be compared
+static uint64_t getMicroseconds()
 {
-    ASSERT ( rawBytes != 0 );
+    return uint64_t ( ( 1000000.0 * Profiler::getTicks() ) / Profiler::getTicksPerSecond() );
+}
+
 
-    char *dump = rawBytes;
+static void appendDelta ( const ChangedRange& range, const char *base, size_t& zeroRun, string& delta )
+{
+    if ( range.src )
+    {
+        deltaAppend ( range.src, base, range.size, zeroRun, delta );
+        return;
+    }
 
-    for ( const MemDump& mem : allAddrs.addrs )
-        mem.saveDump ( dump );
+    // Null sources are all zero
+    static const char zeros[ROLLBACK_BLOCK_SIZE] = { 0 };
 
-    ASSERT ( dump == rawBytes + allAddrs.totalSize );
+    for ( size_t i = 0; i < range.size; i += sizeof ( zeros ) )
+        deltaAppend ( zeros, base + i, min ( sizeof ( zeros ), range.size - i ), zeroRun, delta );
 }
 
-void DllRollbackManager::GameState::load()
+void DllRollbackManager::rollbackStateFreed ( const RollbackStates::State& state )
 {
-    ASSERT ( rawBytes != 0 );
+    if ( state.isKeyframe() )
+        _keyframes.erase ( state.keyframe );
+    else
+        _stats.storedBytes -= _deltas[state.slot].size();
+}
 
-    const char *dump = rawBytes;
+size_t DllRollbackManager::getPoolSize() const
+{
+    if ( _rollbackDistances.getNumSamples() < MIN_ROLLBACK_SAMPLES )
+        return NUM_ROLLBACK_STATES;
+
+    const size_t distance = _rollbackDistances.getPercentile ( ROLLBACK_SIZING_PERCENTILE );
 
-    for ( const MemDump& mem : allAddrs.addrs )
-        mem.loadDump ( dump );
+    // Twice the distance, since the oldest chain stays pinned until the remote confirms it,
+    // plus a partial chain of deltas.
+    const size_t numStates = 2 * ( distance + 1 ) + ROLLBACK_KEYFRAME_INTERVAL;
 
-    ASSERT ( dump == rawBytes + allAddrs.totalSize );
+    return min<size_t> ( NUM_ROLLBACK_STATES, max<size_t> ( MIN_ROLLBACK_STATES, numStates ) );
 }
 
 void DllRollbackManager::allocateStates()
@@ -49,19 +72,46 @@ void DllRollbackManager::allocateStates()
     if ( allAddrs.empty() )
     {
         const size_t size = ( ( char * ) &binary_res_rollback_bin_end ) - ( char * ) &binary_res_rollback_bin_start;
+
+        const uint64_t startTime = getMicroseconds();
+
         allAddrs.load ( ( char * ) &binary_res_rollback_bin_start, size );
+
+        LOG ( "Loaded rollback data: numOps=%u; totalSize=%u; heapSize=%u; loadTime=%llu us",
+              allAddrs.numOps, allAddrs.totalSize, allAddrs.getHeapSize(), getMicroseconds() - startTime );
     }
 
     if ( allAddrs.empty() )
         THROW_EXCEPTION ( "Failed to load rollback data!", ERROR_BAD_ROLLBACK_DATA );
 
-    if ( ! _memoryPool )
-        _memoryPool.reset ( new char[NUM_ROLLBACK_STATES * allAddrs.totalSize], deleteArray<char> );
+    if ( ! _lastState )
+        _lastState.reset ( new char[allAddrs.totalSize], deleteArray<char> );
 
-    for ( size_t i = 0; i < NUM_ROLLBACK_STATES; ++i )
-        _freeStack.push ( i * allAddrs.totalSize );
+    memset ( _lastState.get(), 0, allAddrs.totalSize );
 
-    _statesList.clear();
+    if ( ! _changeDetector )
+        _changeDetector.reset ( new CompareChangeDetector ( ROLLBACK_BLOCK_SIZE ) );
+
+    _changeDetector->reset();
+
+    // This is called on entering InGame, which is a safe point to resize the pool
+    const size_t numStates = getPoolSize();
+    const size_t numKeyframes = NUM_ROLLBACK_KEYFRAMES ( numStates );
+
+    LOG ( "Allocating rollback states: numStates=%u; numKeyframes=%u; rollbackDistances={ %s }",
+          numStates, numKeyframes, _rollbackDistances.str() );
+
+    _states.owner = this;
+    _states.allocate ( numStates, numKeyframes, ROLLBACK_KEYFRAME_INTERVAL );
+
+    _keyframes.allocate ( numKeyframes, NUM_ROLLBACK_RAW_KEYFRAMES, allAddrs.totalSize, ROLLBACK_COMPRESSION_LEVEL );
+
+    _deltas.resize ( numStates );
+
+    // Older rollbacks matter less for the next allocation
+    _rollbackDistances.decay();
+
+    _stats = Stats();
 
     for ( auto& sfxArray : _sfxHistory )
         memset ( &sfxArray[0], 0, CC_SFX_ARRAY_LEN );
@@ -69,111 +119,209 @@ void DllRollbackManager::allocateStates()
 
 void DllRollbackManager::deallocateStates()
 {
-    _memoryPool.reset();
+    if ( _stats.numSaves )
+    {
+        LOG ( "Rollback stats: numSaves=%u; avgSaveTime=%llu us; maxSaveTime=%llu us; "
+              "numLoads=%u; avgLoadTime=%llu us; maxLoadTime=%llu us",
+              _stats.numSaves, _stats.totalSaveTime / _stats.numSaves, _stats.maxSaveTime,
+              _stats.numLoads, ( _stats.numLoads ? _stats.totalLoadTime / _stats.numLoads : 0 ), _stats.maxLoadTime );
 
-    while ( ! _freeStack.empty() )
-        _freeStack.pop();
+        const RollbackKeyframes::Stats keyframeStats = _keyframes.getStats();
 
-    _statesList.clear();
+        LOG ( "Rollback keyframes: numRaw=%u; rawBytes=%u; numCompressed=%u; compressedBytes=%u; numStalls=%u; "
+              "numUncompresses=%u; maxUncompressTime=%llu us",
+              keyframeStats.numRaw, keyframeStats.rawBytes, keyframeStats.numCompressed,
+              keyframeStats.compressedBytes, keyframeStats.numStalls,
+              _stats.numUncompresses, _stats.maxUncompressTime );
+
+        LOG ( "Rollback distances: numStates=%u; percentile=%u; { %s }", _states.capacity(),
+              _rollbackDistances.getPercentile ( ROLLBACK_SIZING_PERCENTILE ), _rollbackDistances.str() );
+    }
+
+    _lastState.reset();
+
+    _changed.clear();
+
+    _states.deallocate();
+
+    _keyframes.deallocate();
+
+    _deltas.clear();
 }
 
 void DllRollbackManager::saveState ( const NetplayManager& netMan )
 {
-    if ( _freeStack.empty() )
+    PROFILE_SCOPE ( RollbackSave );
+
+    const uint64_t startTime = getMicroseconds();
+
+    const RollbackStates::State& state = _states.push ( netMan._state, netMan._startWorldTime, netMan._indexedFrame,
+                                                        netMan.getRemoteFrame() );
+
+    const bool isKeyframe = state.isKeyframe();
+
+    // Find the ranges of the game state that changed since the last state
+    _changed.clear();
+    _changeDetector->begin();
+
+    allAddrs.scanDump ( *_changeDetector, _lastState.get(), _changed );
+
+    // Only copy the changed ranges, the rest is the same as the last state
+    string& delta = _deltas[state.slot];
+    delta.clear();
+
+    size_t zeroRun = 0, pos = 0;
+
+    _stats.lastChangedBytes = 0;
+
+    for ( const ChangedRange& range : _changed )
     {
-        ASSERT ( _statesList.empty() == false );
+        char *last = _lastState.get() + range.offset;
 
-        if ( _statesList.front().indexedFrame.parts.frame <= netMan.getRemoteFrame() )
+        if ( ! isKeyframe )
         {
-            auto it = _statesList.begin();
-            ++it;
-            _freeStack.push ( it->rawBytes - _memoryPool.get() );
-            _statesList.erase ( it );
+            zeroRun += range.offset - pos;
+            appendDelta ( range, last, zeroRun, delta );
         }
+
+        if ( range.src )
+            MemKernels::copy ( last, range.src, range.size );
         else
-        {
-            _freeStack.push ( _statesList.front().rawBytes - _memoryPool.get() );
-            _statesList.pop_front();
-        }
+            memset ( last, 0, range.size );
+
+        pos = range.offset + range.size;
+        _stats.lastChangedBytes += range.size;
     }
 
-    GameState state =
+    if ( isKeyframe )
     {
-        netMan._state,
-        netMan._startWorldTime,
-        netMan._indexedFrame,
-        _memoryPool.get() + _freeStack.top()
-    };
+        MemKernels::copy ( _keyframes.store ( state.keyframe ), _lastState.get(), allAddrs.totalSize );
 
-    _freeStack.pop();
-    state.save();
-    _statesList.push_back ( state );
+        _stats.lastSaveBytes = allAddrs.totalSize;
+    }
+    else
+    {
+        _stats.lastSaveBytes = delta.size();
+        _stats.storedBytes += delta.size();
+    }
+
+    // Compress the keyframe of the chain that just left the newest raw states
+    if ( _states.size() > ROLLBACK_RAW_STATES )
+    {
+        const size_t pos = _states.size() - 1 - ROLLBACK_RAW_STATES;
+
+        if ( _states[pos + 1].isKeyframe() )
+            _keyframes.compress ( _states[_states.findKeyframe ( pos )].keyframe );
+    }
 
     uint8_t *currentSfxArray = &_sfxHistory [ netMan.getFrame() % NUM_ROLLBACK_STATES ][0];
     memcpy ( currentSfxArray, AsmHacks::sfxFilterArray, CC_SFX_ARRAY_LEN );
+
+    _stats.lastSaveTime = getMicroseconds() - startTime;
+    _stats.maxSaveTime = max ( _stats.maxSaveTime, _stats.lastSaveTime );
+    _stats.totalSaveTime += _stats.lastSaveTime;
+    ++_stats.numSaves;
 }
 
 bool DllRollbackManager::loadState ( IndexedFrame indexedFrame, NetplayManager& netMan )
 {
-    if ( _statesList.empty() )
+    PROFILE_SCOPE ( RollbackLoad );
+
+    if ( _states.empty() )
     {
         LOG ( "Failed to load state: indexedFrame=%s", indexedFrame );
         return false;
     }
 
-    LOG ( "Trying to load state: indexedFrame=%s; _statesList={ %s ... %s }",
-          indexedFrame, _statesList.front().indexedFrame, _statesList.back().indexedFrame );
+    LOG ( "Trying to load state: indexedFrame=%s; _states={ %s ... %s }",
+          indexedFrame, _states.front().indexedFrame, _states.back().indexedFrame );
+
+    const uint64_t startTime = getMicroseconds();
 
     const uint32_t origFrame = netMan.getFrame();
 
-    for ( auto it = _statesList.rbegin(); it != _statesList.rend(); ++it )
+    size_t pos = _states.find ( indexedFrame );
+
+    if ( pos == _states.size() )
     {
 #ifdef RELEASE
-        if ( ( it->indexedFrame.value <= indexedFrame.value ) || ( & ( *it ) == &_statesList.front() ) )
+        pos = 0;
 #else
-        if ( it->indexedFrame.value <= indexedFrame.value )
+        LOG ( "Failed to load state: indexedFrame=%s", indexedFrame );
+        return false;
 #endif
-        {
-            LOG ( "Loaded state: indexedFrame=%s", it->indexedFrame );
-
-            // Overwrite the current game state
-            netMan._state = it->netplayState;
-            netMan._startWorldTime = it->startWorldTime;
-            netMan._indexedFrame = it->indexedFrame;
-            it->load();
-
-            // Erase all other states after the current one.
-            // Note: it.base() returns 1 after the position of it, but moving forward.
-            for ( auto jt = it.base(); jt != _statesList.end(); ++jt )
-            {
-                _freeStack.push ( jt->rawBytes - _memoryPool.get() );
-            }
-
-            _statesList.erase ( it.base(), _statesList.end() );
-
-            // Initialize the SFX filter by flagging all played SFX flags in the range (R,S),
-            // where R is the actual reset frame, and S is the original starting frame.
-            // Note: we can skip frame S, because the current SFX filter array is already initialized by frame S.
-            for ( uint32_t i = netMan.getFrame() + 1; i < origFrame; ++i )
-            {
-                for ( uint32_t j = 0; j < CC_SFX_ARRAY_LEN; ++j )
-                    AsmHacks::sfxFilterArray[j] |= _sfxHistory [ i % NUM_ROLLBACK_STATES ][j];
-            }
-
-            // We set the SFX filter flag to 0x80. Since played (but filtered) SFX are incremented,
-            // unplayed sound effects in the filter will stay as 0 or 0x80.
-            for ( uint32_t j = 0; j < CC_SFX_ARRAY_LEN; ++j )
-            {
-                if ( AsmHacks::sfxFilterArray[j] )
-                    AsmHacks::sfxFilterArray[j] = 0x80;
-            }
-
-            return true;
-        }
     }
 
-    LOG ( "Failed to load state: indexedFrame=%s", indexedFrame );
-    return false;
+    const RollbackStates::State& state = _states[pos];
+
+    if ( state.indexedFrame.parts.index == netMan.getIndex() && state.indexedFrame.parts.frame <= origFrame )
+        _rollbackDistances.addSample ( origFrame - state.indexedFrame.parts.frame );
+
+    LOG ( "Loaded state: indexedFrame=%s; keyframeDistance=%u", state.indexedFrame, state.keyframeDistance );
+
+    // Overwrite the current game state
+    netMan._state = state.netplayState;
+    netMan._startWorldTime = state.startWorldTime;
+    netMan._indexedFrame = state.indexedFrame;
+
+    // Rebuild the state from the closest keyframe, applying each delta in the chain after it
+    size_t k = _states.findKeyframe ( pos );
+
+    const uint32_t keyframe = _states[k].keyframe;
+    const bool isRaw = _keyframes.isRaw ( keyframe );
+    const uint64_t uncompressTime = getMicroseconds();
+
+    if ( ! _keyframes.load ( keyframe, _lastState.get() ) )
+        THROW_EXCEPTION ( "Invalid rollback keyframe!", ERROR_BAD_ROLLBACK_DATA );
+
+    if ( ! isRaw )
+    {
+        _stats.lastUncompressTime = getMicroseconds() - uncompressTime;
+        _stats.maxUncompressTime = max ( _stats.maxUncompressTime, _stats.lastUncompressTime );
+        ++_stats.numUncompresses;
+    }
+
+    for ( ++k; k <= pos; ++k )
+    {
+        const string& delta = _deltas[_states[k].slot];
+
+        if ( ! deltaUncompress ( &delta[0], delta.size(), _lastState.get(), allAddrs.totalSize ) )
+            THROW_EXCEPTION ( "Invalid rollback delta!", ERROR_BAD_ROLLBACK_DATA );
+    }
+
+    allAddrs.loadDump ( _lastState.get() );
+
+    // The game memory was overwritten outside of the change detector
+    _changeDetector->reset();
+
+    // Erase all other states after the current one
+    _states.eraseAfter ( pos );
+
+    // Initialize the SFX filter by flagging all played SFX flags in the range (R,S),
+    // where R is the actual reset frame, and S is the original starting frame.
+    // Note: we can skip frame S, because the current SFX filter array is already initialized by frame S.
+    const uint8_t *sfxRows[NUM_ROLLBACK_STATES];
+    size_t numSfxRows = 0;
+
+    for ( uint32_t i = netMan.getFrame() + 1; i < origFrame && numSfxRows < NUM_ROLLBACK_STATES; ++i )
+        sfxRows[numSfxRows++] = &_sfxHistory [ i % NUM_ROLLBACK_STATES ][0];
+
+    MemKernels::orRows ( AsmHacks::sfxFilterArray, sfxRows, numSfxRows, CC_SFX_ARRAY_LEN );
+
+    // We set the SFX filter flag to 0x80. Since played (but filtered) SFX are incremented,
+    // unplayed sound effects in the filter will stay as 0 or 0x80.
+    for ( uint32_t j = 0; j < CC_SFX_ARRAY_LEN; ++j )
+    {
+        if ( AsmHacks::sfxFilterArray[j] )
+            AsmHacks::sfxFilterArray[j] = 0x80;
+    }
+
+    _stats.lastLoadTime = getMicroseconds() - startTime;
+    _stats.maxLoadTime = max ( _stats.maxLoadTime, _stats.lastLoadTime );
+    _stats.totalLoadTime += _stats.lastLoadTime;
+    ++_stats.numLoads;
+
+    return true;
 }
 
 void DllRollbackManager::saveRerunSounds ( uint32_t frame )
@@ -192,16 +340,18 @@ void DllRollbackManager::saveRerunSounds ( uint32_t frame )
 
 void DllRollbackManager::finishedRerunSounds()
 {
-    // Cancel unplayed sound effects after rollback
-    for ( uint32_t j = 0; j < CC_SFX_ARRAY_LEN; ++j )
+    // Cancel unplayed sound effects after rollback.
+    // Filter flag 0x80 means the SFX didn't play after rollback since the filter didn't get incremented.
+    for ( size_t j = 0; ; ++j )
     {
-        // Filter flag 0x80 means the SFX didn't play after rollback since the filter didn't get incremented
-        if ( AsmHacks::sfxFilterArray[j] == 0x80 )
-        {
-            // Play the SFX muted to cancel it
-            CC_SFX_ARRAY_ADDR[j] = 1;
-            AsmHacks::sfxMuteArray[j] = 1;
-        }
+        j += MemKernels::findByte ( AsmHacks::sfxFilterArray + j, CC_SFX_ARRAY_LEN - j, 0x80 );
+
+        if ( j >= CC_SFX_ARRAY_LEN )
+            break;
+
+        // Play the SFX muted to cancel it
+        CC_SFX_ARRAY_ADDR[j] = 1;
+        AsmHacks::sfxMuteArray[j] = 1;
     }
 
     // Cleared last played sound effects
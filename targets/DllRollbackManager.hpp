@@ -2,17 +2,49 @@
 
 #include "DllNetplayManager.hpp"
 #include "Constants.hpp"
+#include "ChangeDetector.hpp"
+#include "RollbackStates.hpp"
+#include "RollbackKeyframes.hpp"
+#include "Statistics.hpp"
 
 #include <memory>
-#include <stack>
-#include <list>
 #include <array>
+#include <vector>
+#include <string>
 
 
 class DllRollbackManager
+    : private RollbackStates::Owner
 {
 public:
 
+    // Histogram of rollback distances in frames
+    typedef Histogram<NUM_ROLLBACK_STATES> RollbackHistogram;
+
+    // Cost of saving / loading game states
+    struct Stats
+    {
+        // Cost of the last save / load in microseconds
+        uint64_t lastSaveTime = 0, lastLoadTime = 0;
+
+        // Worst and total cost of all saves / loads in microseconds
+        uint64_t maxSaveTime = 0, maxLoadTime = 0, totalSaveTime = 0, totalLoadTime = 0;
+
+        // Number of saves / loads
+        uint32_t numSaves = 0, numLoads = 0;
+
+        // Number of bytes stored by the last save, and stored by the deltas of all the currently saved states.
+        // See RollbackKeyframes::Stats for the memory used by keyframes.
+        size_t lastSaveBytes = 0, storedBytes = 0;
+
+        // Number of bytes that changed since the previous state, these are the only bytes copied by the last save
+        size_t lastChangedBytes = 0;
+
+        // Cost of the last and worst load of a compressed keyframe in microseconds, and the number of those loads
+        uint64_t lastUncompressTime = 0, maxUncompressTime = 0;
+        uint32_t numUncompresses = 0;
+    };
+
     // Allocate / deallocate memory for saving game states
     void allocateStates();
     void deallocateStates();
@@ -27,33 +59,48 @@ public:
     // Finalize rollback sound effects
     void finishedRerunSounds();
 
+    // Get the save / load costs
+    const Stats& getStats() const { return _stats; }
+
+    // Get the measured rollback distances, and the number of states currently allocated
+    const RollbackHistogram& getRollbackDistances() const { return _rollbackDistances; }
+    size_t getNumStates() const { return _states.capacity(); }
+
+    // Get the memory used by each keyframe tier
+    RollbackKeyframes::Stats getKeyframeStats() const { return _keyframes.getStats(); }
+
 private:
 
-    struct GameState
-    {
-        // Each game state is uniquely identified by (netplayState, startWorldTime, indexedFrame).
-        // They are chronologically ordered by index and then frame.
-        NetplayState netplayState;
-        uint32_t startWorldTime;
-        IndexedFrame indexedFrame;
-
-        // The pointer to the raw bytes in the state pool
-        char *rawBytes;
-
-        // Save / load the game state
-        void save();
-        void load();
-    };
+    // Keyframes, the newest are raw and the older ones are compressed in the background
+    RollbackKeyframes _keyframes;
+
+    // Delta buffer for each state slot, these keep their capacity between saves
+    std::vector<std::string> _deltas;
 
-    // Memory pool to allocate game states
-    std::shared_ptr<char> _memoryPool;
+    // Full raw bytes of the most recently saved or loaded state, the next state is compared against this
+    std::shared_ptr<char> _lastState;
 
-    // Unused indices in the memory pool, each game state has the same size
-    std::stack<size_t> _freeStack;
+    // Detects which parts of the game state changed since the last state
+    std::shared_ptr<ChangeDetector> _changeDetector;
 
-    // List of saved game states in chronological order
-    std::list<GameState> _statesList;
+    // Ranges of the game state that changed since the last state
+    std::vector<ChangedRange> _changed;
+
+    // Saved game states in chronological order
+    RollbackStates _states;
 
     // History of sound effect playbacks
     std::array<std::array<uint8_t, CC_SFX_ARRAY_LEN>, NUM_ROLLBACK_STATES> _sfxHistory;
+
+    // Save / load costs
+    Stats _stats;
+
+    // Rollback distances measured by loadState, these are kept between allocations
+    RollbackHistogram _rollbackDistances;
+
+    // Get the number of states to allocate, from the rollback distances measured so far
+    size_t getPoolSize() const;
+
+    // Update the stored bytes when a state is freed
+    void rollbackStateFreed ( const RollbackStates::State& state ) override;
 };
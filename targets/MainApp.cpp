@@ -87,6 +87,9 @@ struct MainApp
 
     bool isInitialConfigReady = false;
 
+    // Flags from the remote VersionConfig
+    uint8_t remoteVersionFlags = 0;
+
     SpectateConfig spectateConfig;
 
     NetplayConfig netplayConfig;
@@ -266,6 +269,14 @@ struct MainApp
         msgQueue.clear();
     }
 
+    // Optional protocol flags supported locally, these are only used if the remote also supports them
+    uint8_t getProtocolFlags() const
+    {
+        // Dummy mode only handles PlayerInputs, checksums and framing are handled by Protocol for any message
+        return ( options[Options::Dummy] ? 0 : ClientMode::DeltaInputs )
+               | ClientMode::FastChecksum | ClientMode::FramedMessages;
+    }
+
     void gotVersionConfig ( Socket *socket, const VersionConfig& versionConfig )
     {
         const Version RemoteVersion = versionConfig.version;
@@ -344,6 +355,8 @@ struct MainApp
             LOG ( "serverDataSocket=%08x", serverDataSocket.get() );
         }
 
+        remoteVersionFlags = versionConfig.mode.flags;
+
         initialConfig.invalidate();
         ctrlSocket->send ( initialConfig );
     }
@@ -764,6 +777,10 @@ struct MainApp
             netplayConfig.winCount = initialConfig.winCount;
             netplayConfig.setNames ( initialConfig.localName, initialConfig.remoteName );
 
+            // Enable the optional protocol features supported by both sides
+            clientMode.flags |= ( getProtocolFlags() & remoteVersionFlags );
+            netplayConfig.mode.flags = clientMode.flags;
+
             LOG ( "NetplayConfig: %s; flags={ %s }; delay=%d; rollback=%d; rollbackDelay=%d; winCount=%d; "
                   "hostPlayer=%d; names={ '%s', '%s' }", netplayConfig.mode, netplayConfig.mode.flagString(),
                   netplayConfig.delay, netplayConfig.rollback, netplayConfig.rollbackDelay, netplayConfig.winCount,
@@ -859,7 +876,7 @@ struct MainApp
             ASSERT ( newSocket != 0 );
             ASSERT ( newSocket->isConnected() == true );
 
-            newSocket->send ( new VersionConfig ( clientMode ) );
+            newSocket->send ( new VersionConfig ( clientMode, getProtocolFlags() ) );
 
             pushPendingSocket ( this, newSocket );
         }
@@ -893,7 +910,7 @@ struct MainApp
             ASSERT ( ctrlSocket.get() != 0 );
             ASSERT ( ctrlSocket->isConnected() == true );
 
-            ctrlSocket->send ( new VersionConfig ( clientMode ) );
+            ctrlSocket->send ( new VersionConfig ( clientMode, getProtocolFlags() ) );
         }
         else if ( socket == dataSocket.get() )
         {
@@ -1067,6 +1084,10 @@ struct MainApp
 
         ASSERT ( netplayConfig.delay != 0xFF );
 
+        // Latency for the time sync until the inputs round trip is measured
+        if ( clientMode.isNetplay() )
+            procMan.ipcSend ( pingStats );
+
         netplayConfig.invalidate();
 
         procMan.ipcSend ( netplayConfig );
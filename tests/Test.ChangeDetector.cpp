@@ -0,0 +1,127 @@
+#ifndef RELEASE
+
+#include "ChangeDetector.hpp"
+#include "Compression.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <string>
+
+using namespace std;
+
+
+#define BLOCK_SIZE      ( 64 )
+#define BUFFER_SIZE     ( 64 * 1024 + 13 )
+#define NUM_ITERATIONS  ( 50 )
+#define MAX_CHANGES     ( 20 )
+
+
+// Scan the buffer in two source ranges, with the second range starting at an unaligned offset
+static vector<ChangedRange> scanBuffer ( ChangeDetector& detector, const char *src, const char *prev )
+{
+    vector<ChangedRange> changed;
+
+    const size_t split = BUFFER_SIZE / 3;
+
+    detector.begin();
+    detector.scan ( src, split, 0, prev, changed );
+    detector.scan ( src + split, BUFFER_SIZE - split, split, prev, changed );
+
+    return changed;
+}
+
+static void testChangeDetector ( ChangeDetector& detector )
+{
+    vector<char> src ( BUFFER_SIZE ), prev ( BUFFER_SIZE ), copy ( BUFFER_SIZE );
+
+    for ( char& c : src )
+        c = rand();
+
+    // Initial snapshot
+    vector<ChangedRange> changed = scanBuffer ( detector, &src[0], &prev[0] );
+
+    for ( const ChangedRange& range : changed )
+        memcpy ( &prev[range.offset], range.src, range.size );
+
+    EXPECT_EQ ( 0, memcmp ( &src[0], &prev[0], BUFFER_SIZE ) );
+
+    // Nothing changed
+    changed = scanBuffer ( detector, &src[0], &prev[0] );
+
+    EXPECT_TRUE ( changed.empty() );
+
+    for ( size_t i = 0; i < NUM_ITERATIONS; ++i )
+    {
+        const size_t numChanges = 1 + rand() % MAX_CHANGES;
+
+        for ( size_t j = 0; j < numChanges; ++j )
+            src [ rand() % BUFFER_SIZE ] ^= ( 1 + rand() % 255 );
+
+        changed = scanBuffer ( detector, &src[0], &prev[0] );
+
+        EXPECT_FALSE ( changed.empty() );
+
+        // Every changed byte must be inside a changed range, and only copying those ranges updates the snapshot
+        size_t changedBytes = 0;
+        string delta;
+        size_t zeroRun = 0, pos = 0;
+
+        copy = prev;
+
+        for ( const ChangedRange& range : changed )
+        {
+            ASSERT_TRUE ( range.src != 0 );
+            ASSERT_LE ( range.offset + range.size, BUFFER_SIZE );
+
+            zeroRun += range.offset - pos;
+            deltaAppend ( range.src, &prev[range.offset], range.size, zeroRun, delta );
+            pos = range.offset + range.size;
+
+            memcpy ( &prev[range.offset], range.src, range.size );
+            changedBytes += range.size;
+        }
+
+        EXPECT_EQ ( 0, memcmp ( &src[0], &prev[0], BUFFER_SIZE ) );
+        EXPECT_LE ( changedBytes, numChanges * 2 * BLOCK_SIZE );
+
+        // The delta built from only the changed ranges turns the older snapshot into the new one
+        EXPECT_TRUE ( deltaUncompress ( &delta[0], delta.size(), &copy[0], BUFFER_SIZE ) );
+        EXPECT_EQ ( 0, memcmp ( &src[0], &copy[0], BUFFER_SIZE ) );
+    }
+
+    // Null sources are treated as all zero
+    changed.clear();
+    detector.begin();
+    detector.scan ( 0, BUFFER_SIZE, 0, &prev[0], changed );
+
+    ASSERT_EQ ( 1, changed.size() );
+    EXPECT_TRUE ( changed[0].src == 0 );
+    EXPECT_EQ ( 0, changed[0].offset );
+    EXPECT_EQ ( BUFFER_SIZE, changed[0].size );
+
+    // After a reset, everything that isn't compared directly is reported as changed
+    detector.reset();
+    changed = scanBuffer ( detector, &src[0], &prev[0] );
+
+    for ( const ChangedRange& range : changed )
+        EXPECT_EQ ( 0, memcmp ( range.src, &prev[range.offset], range.size ) );
+}
+
+
+TEST ( ChangeDetector, Compare )
+{
+    CompareChangeDetector detector ( BLOCK_SIZE );
+    testChangeDetector ( detector );
+}
+
+TEST ( ChangeDetector, Hash )
+{
+    HashChangeDetector detector ( BLOCK_SIZE );
+    testChangeDetector ( detector );
+}
+
+#endif // NOT RELEASE
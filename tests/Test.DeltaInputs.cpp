@@ -0,0 +1,213 @@
+#ifndef RELEASE
+
+#include "Messages.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <deque>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+
+#define NUM_ITERATIONS      ( 1000 )
+#define SESSION_FRAMES      ( 60 * 60 * 2 )
+#define LATENCY_FRAMES      ( 4 )
+#define PACKET_LOSS         ( 10 )
+
+
+// Inputs are usually held for several frames
+static vector<uint16_t> generateInputs ( size_t count )
+{
+    vector<uint16_t> inputs ( count );
+    uint16_t held = 0;
+
+    for ( uint16_t& input : inputs )
+    {
+        if ( rand() % 8 == 0 )
+            held = rand() % 0x400;
+
+        input = held;
+    }
+
+    return inputs;
+}
+
+// Encode and decode a message with the full protocol
+static MsgPtr roundTrip ( const MsgPtr& msg, size_t& bytes )
+{
+    const string data = Protocol::encode ( msg );
+    size_t consumed = 0;
+
+    bytes = data.size();
+
+    return Protocol::decode ( &data[0], data.size(), consumed );
+}
+
+
+TEST ( DeltaInputs, RoundTrip )
+{
+    srand ( 1234 );
+
+    for ( size_t i = 0; i < NUM_ITERATIONS; ++i )
+    {
+        const IndexedFrame indexedFrame = {{ uint32_t ( rand() % 200 ), uint32_t ( rand() % 4 ) }};
+        const IndexedFrame ack = {{ uint32_t ( rand() % 200 ), uint32_t ( rand() % 4 ) }};
+        const IndexedFrame remoteAck = {{ uint32_t ( rand() % 200 ), uint32_t ( rand() % 4 ) }};
+
+        DeltaInputs *deltaInputs = new DeltaInputs ( indexedFrame, ack, remoteAck );
+        MsgPtr msg ( deltaInputs );
+
+        ASSERT_GE ( deltaInputs->size(), 1u );
+        ASSERT_LE ( deltaInputs->size(), size_t ( NUM_INPUTS ) );
+        ASSERT_EQ ( deltaInputs->getEndFrame(), indexedFrame.parts.frame + 1 );
+
+        // Only the inputs after the remote ack are included, but always at least the last input
+        uint32_t startFrame =
+            ( indexedFrame.parts.frame + 1 < NUM_INPUTS ) ? 0 : indexedFrame.parts.frame + 1 - NUM_INPUTS;
+
+        if ( remoteAck.parts.index == indexedFrame.parts.index )
+            startFrame = max ( startFrame, min ( remoteAck.parts.frame, indexedFrame.parts.frame ) );
+
+        ASSERT_EQ ( startFrame, deltaInputs->getStartFrame() ) << "i=" << i;
+
+        const vector<uint16_t> inputs = generateInputs ( deltaInputs->size() );
+        copy ( inputs.begin(), inputs.end(), deltaInputs->inputs.begin() );
+
+        size_t bytes = 0;
+        MsgPtr decoded = roundTrip ( msg, bytes );
+
+        ASSERT_TRUE ( decoded.get() ) << "i=" << i;
+        ASSERT_EQ ( MsgType::DeltaInputs, decoded->getMsgType() );
+
+        const DeltaInputs& result = decoded->getAs<DeltaInputs>();
+
+        EXPECT_EQ ( indexedFrame.value, result.indexedFrame.value );
+        EXPECT_EQ ( ack.value, result.ack.value );
+        ASSERT_EQ ( deltaInputs->size(), result.size() );
+        EXPECT_EQ ( inputs, vector<uint16_t> ( result.inputs.begin(), result.inputs.begin() + result.size() ) );
+    }
+}
+
+TEST ( DeltaInputs, InvalidRuns )
+{
+    const IndexedFrame indexedFrame = {{ 100, 1 }};
+
+    // The run lengths must add up to the number of inputs
+    for ( uint8_t length : { 3, 6 } )
+    {
+        ostringstream ss ( stringstream::binary );
+
+        {
+            cereal::BinaryOutputArchive archive ( ss );
+            archive ( indexedFrame.value, indexedFrame.value, uint8_t ( 5 ), uint8_t ( 1 ), uint16_t ( 0 ), length );
+        }
+
+        istringstream ss2 ( ss.str(), stringstream::binary );
+        cereal::BinaryInputArchive archive ( ss2 );
+
+        DeltaInputs deltaInputs;
+        EXPECT_THROW ( deltaInputs.load ( archive ), cereal::Exception ) << "length=" << uint32_t ( length );
+    }
+}
+
+TEST ( DeltaInputs, LossyBandwidth )
+{
+    srand ( 1234 );
+
+    const vector<uint16_t> inputs = generateInputs ( SESSION_FRAMES );
+
+    for ( bool delta : { false, true } )
+    {
+        // Messages in flight with the frame they arrive on
+        deque<pair<uint32_t, MsgPtr>> sent;
+        deque<pair<uint32_t, IndexedFrame>> acks;
+
+        IndexedFrame remoteAck = {{ 0, 0 }};
+        vector<uint16_t> received;
+        size_t totalBytes = 0, numLost = 0;
+
+        for ( uint32_t frame = 0; frame < SESSION_FRAMES; ++frame )
+        {
+            const IndexedFrame indexedFrame = {{ frame, 0 }};
+            MsgPtr msg;
+
+            if ( delta )
+            {
+                DeltaInputs *deltaInputs = new DeltaInputs ( indexedFrame, {{ 0, 0 }}, remoteAck );
+                copy ( &inputs[deltaInputs->getStartFrame()], &inputs[frame] + 1, deltaInputs->inputs.begin() );
+                msg.reset ( deltaInputs );
+            }
+            else
+            {
+                PlayerInputs *playerInputs = new PlayerInputs ( indexedFrame );
+                copy ( &inputs[playerInputs->getStartFrame()], &inputs[frame] + 1, playerInputs->inputs.begin() );
+                msg.reset ( playerInputs );
+            }
+
+            size_t bytes = 0;
+            MsgPtr decoded = roundTrip ( msg, bytes );
+
+            ASSERT_TRUE ( decoded.get() );
+
+            totalBytes += bytes;
+
+            if ( rand() % 100 < PACKET_LOSS )
+                ++numLost;
+            else
+                sent.push_back ( { frame + LATENCY_FRAMES, decoded } );
+
+            // Receive the inputs in order, the ack for them is sent back with the remote's next message
+            while ( !sent.empty() && sent.front().first == frame )
+            {
+                uint32_t start;
+                const uint16_t *first;
+                size_t n;
+
+                if ( delta )
+                {
+                    const DeltaInputs& deltaInputs = sent.front().second->getAs<DeltaInputs>();
+                    start = deltaInputs.getStartFrame();
+                    first = &deltaInputs.inputs[0];
+                    n = deltaInputs.size();
+                }
+                else
+                {
+                    const PlayerInputs& playerInputs = sent.front().second->getAs<PlayerInputs>();
+                    start = playerInputs.getStartFrame();
+                    first = &playerInputs.inputs[0];
+                    n = playerInputs.size();
+                }
+
+                ASSERT_LE ( start, received.size() ) << "frame=" << frame;
+
+                for ( size_t i = received.size() - start; i < n; ++i )
+                    received.push_back ( first[i] );
+
+                sent.pop_front();
+
+                if ( rand() % 100 >= PACKET_LOSS )
+                    acks.push_back ( { frame + 1 + LATENCY_FRAMES, {{ uint32_t ( received.size() ), 0 }} } );
+            }
+
+            while ( !acks.empty() && acks.front().first == frame )
+            {
+                if ( acks.front().second.value > remoteAck.value )
+                    remoteAck = acks.front().second;
+
+                acks.pop_front();
+            }
+        }
+
+        ASSERT_GE ( received.size(), SESSION_FRAMES - LATENCY_FRAMES - 1 );
+        EXPECT_EQ ( vector<uint16_t> ( inputs.begin(), inputs.begin() + received.size() ), received );
+
+        PRINT ( "%s: latency=%u frames; loss=%u%%; lost=%u; %.1f bytes/msg; %.0f bytes/sec",
+                ( delta ? "DeltaInputs" : "PlayerInputs" ), LATENCY_FRAMES, PACKET_LOSS, numLost,
+                double ( totalBytes ) / SESSION_FRAMES, double ( totalBytes ) * 60 / SESSION_FRAMES );
+    }
+}
+
+#endif // NOT RELEASE
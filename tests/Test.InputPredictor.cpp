@@ -0,0 +1,101 @@
+#ifndef RELEASE
+
+#include "InputPredictor.hpp"
+#include "Logger.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+
+
+#define SESSION_FRAMES      ( 60 * 60 )
+
+#define DIRECTION_RIGHT     ( 6 )
+#define BUTTON_A            ( 0x10 )
+
+
+// Holds a direction and taps a button for two frames at random intervals
+static vector<uint16_t> generateTaps ( size_t count )
+{
+    vector<uint16_t> inputs;
+
+    while ( inputs.size() < count )
+    {
+        inputs.insert ( inputs.end(), 5 + rand() % 25, DIRECTION_RIGHT );
+        inputs.insert ( inputs.end(), 2, DIRECTION_RIGHT | BUTTON_A );
+    }
+
+    inputs.resize ( count );
+    return inputs;
+}
+
+// Feed each input with the inputs before it
+static void train ( InputPredictors& predictors, const vector<uint16_t>& inputs )
+{
+    for ( size_t i = 1; i < inputs.size(); ++i )
+    {
+        const size_t n = min<size_t> ( i, INPUT_PREDICTOR_HISTORY );
+        predictors.gotInput ( &inputs[i - n], n, inputs[i] );
+    }
+}
+
+
+TEST ( InputPredictor, Strategies )
+{
+    const uint16_t inputs[] = { DIRECTION_RIGHT, DIRECTION_RIGHT | BUTTON_A };
+
+    EXPECT_EQ ( DIRECTION_RIGHT | BUTTON_A, RepeatLastPredictor().predict ( inputs, 2 ) );
+    EXPECT_EQ ( DIRECTION_RIGHT, HoldDirectionPredictor().predict ( inputs, 2 ) );
+
+    // Untrained states repeat the last input
+    MarkovPredictor markov;
+    EXPECT_EQ ( DIRECTION_RIGHT | BUTTON_A, markov.predict ( inputs, 2 ) );
+
+    // The same input held for a different number of frames is a different state
+    const uint16_t held[] = { DIRECTION_RIGHT | BUTTON_A, DIRECTION_RIGHT | BUTTON_A };
+
+    markov.train ( inputs, 2, DIRECTION_RIGHT | BUTTON_A );
+    markov.train ( held, 2, DIRECTION_RIGHT );
+    markov.train ( held, 2, DIRECTION_RIGHT );
+    markov.train ( held, 2, 0 );
+
+    EXPECT_EQ ( DIRECTION_RIGHT | BUTTON_A, markov.predict ( inputs, 2 ) );
+    EXPECT_EQ ( DIRECTION_RIGHT, markov.predict ( held, 2 ) );
+
+    markov.clear();
+    EXPECT_EQ ( DIRECTION_RIGHT | BUTTON_A, markov.predict ( held, 2 ) );
+}
+
+TEST ( InputPredictor, HitRates )
+{
+    srand ( 1234 );
+
+    const vector<uint16_t> inputs = generateTaps ( SESSION_FRAMES );
+
+    InputPredictors predictors;
+
+    EXPECT_STREQ ( "RepeatLast", predictors.getBest().name() );
+
+    train ( predictors, inputs );
+
+    for ( const auto& predictor : predictors.getAll() )
+        EXPECT_EQ ( uint32_t ( SESSION_FRAMES - 1 ), predictor->getNumInputs() );
+
+    const double repeatLast = predictors.getAll()[0]->getHitRate();
+    const double holdDirection = predictors.getAll()[1]->getHitRate();
+    const double markov = predictors.getAll()[2]->getHitRate();
+
+    // Each tap is two mispredictions when repeating the last input or always releasing buttons,
+    // but the Markov model learns that taps are released after two frames.
+    EXPECT_GT ( markov, repeatLast );
+    EXPECT_GT ( markov, holdDirection );
+    EXPECT_STREQ ( "Markov", predictors.getBest().name() );
+
+    PRINT ( "InputPredictor: %s", predictors.str() );
+}
+
+#endif // NOT RELEASE
@@ -0,0 +1,578 @@
+#ifndef RELEASE
+
+#include "InputsContainer.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+
+
+#define NUM_ITERATIONS      ( 20000 )
+#define MAX_INDEX           ( 12 )
+#define MAX_FRAME           ( 3 * INPUTS_CHUNK_SIZE )
+#define MAX_COUNT           ( INPUTS_CHUNK_SIZE + 40 )
+#define NUM_VALUES          ( 4 )
+#define BENCH_FRAMES        ( 60 * 60 * 5 )
+#define BENCH_INDICES       ( 4 )
+#define SESSION_INDICES     ( 300 )
+#define SESSION_FRAMES      ( 60 * 60 )
+
+
+// The previous std::vector<std::vector<T>> implementation, used as a reference
+template<typename T>
+class ReferenceInputs
+{
+public:
+
+    // Get a single input for the given index:frame, returns 0 if none.
+    T get ( uint32_t index, uint32_t frame ) const
+    {
+        if ( index >= _inputs.size() || _inputs[index].empty() )
+            return lastInputBefore ( index );
+
+        if ( frame >= _inputs[index].size() )
+            return _inputs[index].back();
+
+        return _inputs[index][frame];
+    }
+
+    // Get n inputs starting from the given index:frame, ASSERTS if not enough.
+    void get ( uint32_t index, uint32_t frame, T *t, size_t n ) const
+    {
+        ASSERT ( index < _inputs.size() );
+        ASSERT ( frame + n <= _inputs[index].size() );
+
+        std::copy ( _inputs[index].begin() + frame,
+                    _inputs[index].begin() + frame + n, t );
+    }
+
+    // Set a single input for the given index:frame, CANNOT change existing inputs.
+    void set ( uint32_t index, uint32_t frame, T t )
+    {
+        if ( _inputs.size() > index && _inputs[index].size() > frame )
+            return;
+
+        resize ( index, frame );
+
+        _inputs[index][frame] = t;
+    }
+
+    // Assign a single input for the given index:frame, CAN change existing inputs
+    void assign ( uint32_t index, uint32_t frame, T t )
+    {
+        resize ( index, frame );
+
+        _inputs[index][frame] = t;
+    }
+
+    // Fill n inputs with the same given value starting from the given index:frame, CAN change existing inputs.
+    void set ( uint32_t index, uint32_t frame, T t, size_t n )
+    {
+        resize ( index, frame, n );
+
+        std::fill ( _inputs[index].begin() + frame,
+                    _inputs[index].begin() + frame + n, t );
+    }
+
+    // Set n inputs starting from the given index:frame, CAN change existing inputs.
+    void set ( uint32_t index, uint32_t frame, const T *t, size_t n, uint32_t checkStartingFromIndex = UINT_MAX )
+    {
+        if ( index >= checkStartingFromIndex )
+        {
+            IndexedFrame f;
+            size_t i;
+
+            for ( i = 0, f = {{ frame, index }}; i < n; ++i, ++f.parts.frame )
+            {
+                if ( get ( f.parts.index, f.parts.frame ) == t[i] )
+                    continue;
+
+                // Indicate changed if the input is different from the last known input
+                _lastChangedFrame.value = std::min ( _lastChangedFrame.value, f.value );
+                break;
+            }
+        }
+
+        resize ( index, frame, n );
+
+        std::copy ( t, t + n, &_inputs[index][frame] );
+    }
+
+    // Resize the container so that it can contain inputs up to index:frame+n.
+    void resize ( uint32_t index, uint32_t frame, size_t n = 1 )
+    {
+        T last = 0;
+
+        if ( index >= _inputs.size() )
+        {
+            last = lastInputBefore ( _inputs.size() );
+            _inputs.resize ( index + 1 );
+        }
+        else if ( ! _inputs[index].empty() )
+        {
+            last = _inputs[index].back();
+        }
+
+        if ( frame + n > _inputs[index].size() )
+            _inputs[index].resize ( frame + n, last );
+    }
+
+    void clear()
+    {
+        _inputs.clear();
+    }
+
+    bool empty() const
+    {
+        return _inputs.empty();
+    }
+
+    bool empty ( size_t index ) const
+    {
+        if ( index >= _inputs.size() )
+            return true;
+
+        return _inputs[index].empty();
+    }
+
+    uint32_t getEndIndex() const
+    {
+        return _inputs.size();
+    }
+
+    uint32_t getEndFrame() const
+    {
+        if ( _inputs.empty() )
+            return 0;
+
+        return _inputs.back().size();
+    }
+
+    uint32_t getEndFrame ( size_t index ) const
+    {
+        if ( index >= _inputs.size() )
+            return 0;
+
+        return _inputs[index].size();
+    }
+
+    void eraseIndexOlderThan ( size_t index )
+    {
+        if ( index + 1 >= _inputs.size() )
+            _inputs.clear();
+        else
+            _inputs.erase ( _inputs.begin(), _inputs.begin() + index );
+    }
+
+    IndexedFrame getLastChangedFrame() const
+    {
+        return _lastChangedFrame;
+    }
+
+    void clearLastChangedFrame()
+    {
+        _lastChangedFrame = MaxIndexedFrame;
+    }
+
+private:
+
+    // Mapping: index -> frame -> input
+    std::vector<std::vector<T>> _inputs;
+
+    // Last frame of input that changed
+    IndexedFrame _lastChangedFrame = MaxIndexedFrame;
+
+    // Get the last known input BEFORE the given index. Defaults to 0 if unknown.
+    T lastInputBefore ( uint32_t index ) const
+    {
+        if ( _inputs.empty() || index == 0 )
+            return 0;
+
+        if ( index > _inputs.size() )
+            index = _inputs.size();
+
+        do
+        {
+            --index;
+            if ( ! _inputs[index].empty() )
+                return _inputs[index].back();
+        }
+        while ( index > 0 );
+
+        return 0;
+    }
+};
+
+
+static void expectSameInputs ( const ReferenceInputs<uint16_t>& ref, const InputsContainer<uint16_t>& inputs )
+{
+    ASSERT_EQ ( ref.empty(), inputs.empty() );
+    ASSERT_EQ ( ref.getEndIndex(), inputs.getEndIndex() );
+    ASSERT_EQ ( ref.getEndFrame(), inputs.getEndFrame() );
+    ASSERT_EQ ( ref.getLastChangedFrame().value, inputs.getLastChangedFrame().value );
+
+    for ( uint32_t index = 0; index <= ref.getEndIndex(); ++index )
+    {
+        ASSERT_EQ ( ref.empty ( index ), inputs.empty ( index ) ) << "index=" << index;
+        ASSERT_EQ ( ref.getEndFrame ( index ), inputs.getEndFrame ( index ) ) << "index=" << index;
+
+        for ( uint32_t frame = 0; frame <= ref.getEndFrame ( index ) + 1; ++frame )
+            ASSERT_EQ ( ref.get ( index, frame ), inputs.get ( index, frame ) ) << "index=" << index << " frame=" << frame;
+
+        if ( ref.getEndFrame ( index ) == 0 )
+            continue;
+
+        // Read a range that crosses chunk boundaries
+        const uint32_t frame = rand() % ref.getEndFrame ( index );
+        const size_t n = ref.getEndFrame ( index ) - frame;
+
+        vector<uint16_t> expected ( n ), actual ( n );
+        ref.get ( index, frame, &expected[0], n );
+        inputs.get ( index, frame, &actual[0], n );
+
+        ASSERT_EQ ( expected, actual ) << "index=" << index << " frame=" << frame;
+    }
+}
+
+
+TEST ( InputsContainer, MatchesReference )
+{
+    srand ( 1234 );
+
+    ReferenceInputs<uint16_t> ref;
+    InputsContainer<uint16_t> inputs;
+
+    vector<uint16_t> values ( MAX_COUNT );
+
+    for ( size_t i = 0; i < NUM_ITERATIONS; ++i )
+    {
+        const int action = rand() % 100;
+
+        const uint32_t index = rand() % MAX_INDEX;
+        const uint32_t frame = rand() % MAX_FRAME;
+        const uint16_t value = rand() % NUM_VALUES;
+        const size_t n = rand() % MAX_COUNT;
+
+        if ( action < 25 )
+        {
+            ref.set ( index, frame, value );
+            inputs.set ( index, frame, value );
+        }
+        else if ( action < 40 )
+        {
+            ref.assign ( index, frame, value );
+            inputs.assign ( index, frame, value );
+        }
+        else if ( action < 50 )
+        {
+            ref.set ( index, frame, value, n );
+            inputs.set ( index, frame, value, n );
+        }
+        else if ( action < 75 )
+        {
+            for ( uint16_t& v : values )
+                v = rand() % NUM_VALUES;
+
+            const uint32_t checkStartingFromIndex = rand() % ( MAX_INDEX + 1 );
+
+            ref.set ( index, frame, &values[0], n, checkStartingFromIndex );
+            inputs.set ( index, frame, &values[0], n, checkStartingFromIndex );
+        }
+        else if ( action < 85 )
+        {
+            ref.resize ( index, 0, 0 );
+            inputs.resize ( index, 0, 0 );
+        }
+        else if ( action < 93 )
+        {
+            const size_t count = rand() % ( ref.getEndIndex() + 1 );
+
+            ref.eraseIndexOlderThan ( count );
+            inputs.eraseIndexOlderThan ( count );
+        }
+        else if ( action < 98 )
+        {
+            ref.clearLastChangedFrame();
+            inputs.clearLastChangedFrame();
+        }
+        else
+        {
+            ref.clear();
+            inputs.clear();
+        }
+
+        expectSameInputs ( ref, inputs );
+
+        if ( HasFailure() )
+        {
+            ADD_FAILURE() << "i=" << i << " action=" << action;
+            return;
+        }
+    }
+}
+
+// Stream of PlayerInputs messages, each with the last NUM_INPUTS inputs up to the current frame
+struct InputsStream
+{
+    struct Message
+    {
+        uint32_t index, frame;
+        vector<uint16_t> inputs;
+    };
+
+    vector<Message> messages;
+
+    InputsStream()
+    {
+        uint16_t held = 0;
+
+        for ( uint32_t index = 0; index < BENCH_INDICES; ++index )
+        {
+            vector<uint16_t> inputs;
+
+            for ( uint32_t frame = 0; frame < BENCH_FRAMES; ++frame )
+            {
+                // Inputs are usually held for several frames
+                if ( rand() % 8 == 0 )
+                    held = rand() % 0x400;
+
+                inputs.push_back ( held );
+
+                const uint32_t start = ( frame + 1 < NUM_INPUTS ? 0 : frame + 1 - NUM_INPUTS );
+
+                messages.push_back ( { index, start, vector<uint16_t> ( &inputs[start], &inputs[frame] + 1 ) } );
+            }
+        }
+    }
+
+    template<typename C>
+    double replay ( C& container ) const
+    {
+        const auto start = chrono::high_resolution_clock::now();
+
+        for ( const Message& msg : messages )
+        {
+            container.set ( msg.index, msg.frame, &msg.inputs[0], msg.inputs.size(), 0 );
+            container.clearLastChangedFrame();
+        }
+
+        const auto end = chrono::high_resolution_clock::now();
+
+        return chrono::duration<double, nano> ( end - start ).count() / messages.size();
+    }
+};
+
+TEST ( InputsContainer, ReplayBenchmark )
+{
+    srand ( 1234 );
+
+    const InputsStream stream;
+
+    ReferenceInputs<uint16_t> ref;
+    InputsContainer<uint16_t> inputs;
+
+    const double refTime = stream.replay ( ref );
+    const double time = stream.replay ( inputs );
+
+    expectSameInputs ( ref, inputs );
+
+    // Replay the same messages again, so every message is compared against known inputs
+    const double refRepeatTime = stream.replay ( ref );
+    const double repeatTime = stream.replay ( inputs );
+
+    PRINT ( "InputsContainer: %u messages; reference=%.1f ns/msg; chunked=%.1f ns/msg",
+            stream.messages.size(), refTime, time );
+    PRINT ( "InputsContainer: repeated reference=%.1f ns/msg; chunked=%.1f ns/msg", refRepeatTime, repeatTime );
+}
+
+TEST ( InputsContainer, LongSessionMemory )
+{
+    srand ( 1234 );
+
+    ReferenceInputs<uint16_t> ref;
+    InputsContainer<uint16_t> inputs;
+
+    uint16_t held = 0;
+    size_t hotSize = 0;
+
+    // Keep every index like a spectator, with inputs usually held for several frames
+    for ( uint32_t index = 0; index < SESSION_INDICES; ++index )
+    {
+        for ( uint32_t frame = 0; frame < SESSION_FRAMES; ++frame )
+        {
+            if ( rand() % 8 == 0 )
+                held = rand() % 0x400;
+
+            ref.set ( index, frame, held );
+            inputs.set ( index, frame, held );
+        }
+
+        if ( index == INPUTS_HOT_INDICES )
+            hotSize = inputs.getMemorySize();
+    }
+
+    const size_t rawSize = size_t ( SESSION_INDICES ) * SESSION_FRAMES * sizeof ( uint16_t );
+
+    expectSameInputs ( ref, inputs );
+
+    // Only the newest indices are uncompressed, so memory grows with the number of input changes
+    EXPECT_LT ( inputs.getMemorySize(), rawSize / 3 );
+
+    PRINT ( "InputsContainer: %u indices; raw=%u bytes; hot=%u bytes; total=%u bytes",
+            SESSION_INDICES, rawSize, hotSize, inputs.getMemorySize() );
+
+    // Changing an older index uncompresses it
+    ref.assign ( 10, 100, 0xFFFF );
+    inputs.assign ( 10, 100, 0xFFFF );
+
+    expectSameInputs ( ref, inputs );
+}
+
+// Frames start to end - 1 before the current frame, read one input at a time like the previous history queries
+static bool hasUpDownPerFrame ( const InputsContainer<uint16_t>& inputs, uint32_t index, uint32_t current,
+                                uint32_t start, uint32_t end )
+{
+    for ( size_t i = start; i < end; ++i )
+    {
+        if ( i > current )
+            break;
+
+        const uint16_t dir = 0xF & inputs.get ( index, current - i );
+
+        if ( ( dir == 2 ) || ( dir == 8 ) )
+            return true;
+    }
+
+    return false;
+}
+
+static bool hasButtonPerFrame ( const InputsContainer<uint16_t>& inputs, uint32_t index, uint32_t current,
+                                uint16_t button, uint32_t start, uint32_t end )
+{
+    for ( size_t i = start; i < end; ++i )
+    {
+        if ( i > current )
+            break;
+
+        if ( ( inputs.get ( index, current - i ) >> 4 ) & button )
+            return true;
+    }
+
+    return false;
+}
+
+static bool heldButtonPerFrame ( const InputsContainer<uint16_t>& inputs, uint32_t index, uint32_t current,
+                                 uint16_t button, uint32_t start, uint32_t end )
+{
+    for ( size_t i = start; i < end; ++i )
+    {
+        if ( i > current )
+            return false;
+
+        if ( ! ( ( inputs.get ( index, current - i ) >> 4 ) & button ) )
+            return false;
+    }
+
+    return true;
+}
+
+// Same frames as spans of the known inputs followed by the missing inputs, like NetplayManager::forEachInputSpan
+template<typename F>
+static bool forEachInputSpan ( const InputsContainer<uint16_t>& inputs, uint32_t index, uint32_t current,
+                               uint32_t start, uint32_t end, F f )
+{
+    if ( start >= end )
+        return true;
+
+    if ( start > current )
+        return false;
+
+    const uint32_t first = current - min ( end - 1, current );
+    const uint32_t last = current - start + 1;
+    const uint32_t split = min ( max ( inputs.getEndFrame ( index ), first ), last );
+
+    if ( first < split )
+        inputs.forEachSpan ( index, first, split - first, f );
+
+    for ( uint32_t frame = split; frame < last; ++frame )
+    {
+        const uint16_t input = inputs.get ( index, frame );
+        f ( &input, 1 );
+    }
+
+    return ( end - 1 <= current );
+}
+
+TEST ( InputsContainer, Spans )
+{
+    srand ( 1234 );
+
+    InputsContainer<uint16_t> inputs;
+
+    // Enough indices that the older ones are compressed
+    for ( uint32_t index = 0; index < 4 * INPUTS_HOT_INDICES; ++index )
+    {
+        uint16_t held = 0;
+
+        for ( uint32_t frame = 0; frame < MAX_FRAME; ++frame )
+        {
+            if ( rand() % 8 == 0 )
+                held = rand() % 0x400;
+
+            inputs.set ( index, frame, held );
+        }
+    }
+
+    const uint32_t hotIndex = inputs.getEndIndex() - 1;
+
+    for ( size_t i = 0; i < NUM_ITERATIONS; ++i )
+    {
+        const uint32_t index = rand() % ( inputs.getEndIndex() + 1 );
+        const uint32_t frame = rand() % MAX_FRAME;
+
+        // Spans never cross a chunk
+        if ( index == hotIndex )
+        {
+            const size_t n = 1 + rand() % ( MAX_FRAME - frame );
+            const auto span = inputs.getSpan ( index, frame, n );
+
+            ASSERT_GE ( span.size, 1u );
+            ASSERT_LE ( span.size, n );
+            ASSERT_LE ( frame % INPUTS_CHUNK_SIZE + span.size, size_t ( INPUTS_CHUNK_SIZE ) );
+
+            for ( size_t j = 0; j < span.size; ++j )
+                ASSERT_EQ ( inputs.get ( index, frame + j ), span.data[j] ) << "frame=" << frame + j;
+        }
+
+        // History queries match reading one input at a time, including frames after the known inputs
+        const uint32_t current = frame + rand() % 8;
+        const uint32_t start = rand() % 10;
+        const uint32_t end = start + rand() % 300;
+        const uint16_t button = 1 << ( rand() % 6 );
+
+        bool upDown = false, held = true;
+        uint16_t buttons = 0;
+
+        const bool complete = forEachInputSpan ( inputs, index, current, start, end,
+                                                 [&] ( const uint16_t *span, size_t n )
+        {
+            for ( size_t j = 0; j < n; ++j )
+            {
+                upDown |= ( ( span[j] & 0xF ) == 2 ) | ( ( span[j] & 0xF ) == 8 );
+                buttons |= span[j];
+                held &= ( ( ( span[j] >> 4 ) & button ) != 0 );
+            }
+        } );
+
+        ASSERT_EQ ( hasUpDownPerFrame ( inputs, index, current, start, end ), upDown ) << "i=" << i;
+        ASSERT_EQ ( hasButtonPerFrame ( inputs, index, current, button, start, end ),
+                    bool ( ( buttons >> 4 ) & button ) ) << "i=" << i;
+        ASSERT_EQ ( heldButtonPerFrame ( inputs, index, current, button, start, end ), complete && held ) << "i=" << i;
+    }
+}
+
+#endif // NOT RELEASE
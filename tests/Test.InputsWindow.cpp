@@ -0,0 +1,293 @@
+#ifndef RELEASE
+
+#include "InputsWindow.hpp"
+#include "Messages.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <deque>
+#include <vector>
+
+using namespace std;
+
+
+#define SESSION_FRAMES      ( 60 * 60 )
+#define LATENCY_FRAMES      ( 4 )
+
+
+// One side of a simulated netplay session, that sends one inputs message per frame over a lossy loopback
+struct Peer
+{
+    // Use DeltaInputs sized by the InputsWindow, otherwise PlayerInputs
+    bool adaptive = false;
+
+    InputsWindow window;
+
+    // Local inputs to send, and the remote inputs received so far
+    vector<uint16_t> inputs, received;
+
+    // Frame each remote input was received on
+    vector<uint32_t> receivedFrame;
+
+    IndexedFrame remoteAck = {{ 0, 0 }};
+
+    size_t numBytes = 0, numMessages = 0;
+
+    MsgPtr getInputs ( uint32_t frame )
+    {
+        const IndexedFrame indexedFrame = {{ frame, 0 }};
+
+        if ( adaptive )
+        {
+            const IndexedFrame ack = {{ uint32_t ( received.size() ), 0 }};
+
+            DeltaInputs *deltaInputs = new DeltaInputs ( indexedFrame, ack,
+                                                         window.getNumInputs ( indexedFrame, remoteAck ) );
+            copy ( &inputs[deltaInputs->getStartFrame()], &inputs[frame] + 1, deltaInputs->inputs.begin() );
+            return MsgPtr ( deltaInputs );
+        }
+
+        PlayerInputs *playerInputs = new PlayerInputs ( indexedFrame );
+        copy ( &inputs[playerInputs->getStartFrame()], &inputs[frame] + 1, playerInputs->inputs.begin() );
+        return MsgPtr ( playerInputs );
+    }
+
+    void setInputs ( const MsgPtr& msg, uint32_t frame )
+    {
+        uint32_t start;
+        const uint16_t *first;
+        size_t n;
+
+        if ( adaptive )
+        {
+            const DeltaInputs& deltaInputs = msg->getAs<DeltaInputs>();
+
+            if ( deltaInputs.ack.value > remoteAck.value )
+                remoteAck = deltaInputs.ack;
+
+            window.gotRemoteAck ( remoteAck, {{ frame, 0 }} );
+            window.gotRemoteFrame ( deltaInputs.indexedFrame );
+
+            // Same as NetplayManager, drop inputs that would leave a gap
+            if ( deltaInputs.size() < MAX_INPUTS_WINDOW && deltaInputs.getStartFrame() > received.size() )
+                return;
+
+            start = deltaInputs.getStartFrame();
+            first = &deltaInputs.inputs[0];
+            n = deltaInputs.size();
+        }
+        else
+        {
+            const PlayerInputs& playerInputs = msg->getAs<PlayerInputs>();
+            start = playerInputs.getStartFrame();
+            first = &playerInputs.inputs[0];
+            n = playerInputs.size();
+        }
+
+        // Gaps are filled with the last input, like InputsContainer
+        while ( received.size() < start )
+        {
+            received.push_back ( received.empty() ? 0 : received.back() );
+            receivedFrame.push_back ( frame );
+        }
+
+        for ( size_t i = received.size() - start; i < n; ++i )
+        {
+            received.push_back ( first[i] );
+            receivedFrame.push_back ( frame );
+        }
+    }
+};
+
+// Delivers messages after a fixed latency, dropping a percentage of them
+struct LossyLoopback
+{
+    uint32_t packetLoss = 0;
+
+    // Messages in flight with the frame they arrive on
+    deque<pair<uint32_t, MsgPtr>> messages;
+
+    void send ( Peer& peer, const MsgPtr& msg, uint32_t frame )
+    {
+        const string data = Protocol::encode ( msg );
+
+        peer.numBytes += data.size();
+        ++peer.numMessages;
+
+        if ( uint32_t ( rand() % 100 ) < packetLoss )
+            return;
+
+        size_t consumed = 0;
+        messages.push_back ( { frame + LATENCY_FRAMES, Protocol::decode ( &data[0], data.size(), consumed ) } );
+    }
+
+    template<typename F>
+    void receive ( uint32_t frame, F callback )
+    {
+        while ( !messages.empty() && messages.front().first == frame )
+        {
+            callback ( messages.front().second );
+            messages.pop_front();
+        }
+    }
+};
+
+struct SessionResult
+{
+    double averageLatency = 0, bytesPerFrame = 0;
+    uint32_t worstLatency = 0, numWrong = 0;
+};
+
+static SessionResult simulateSession ( bool adaptive, uint32_t packetLoss )
+{
+    srand ( 1234 );
+
+    array<Peer, 2> peers;
+    array<LossyLoopback, 2> channels;
+
+    for ( Peer& peer : peers )
+    {
+        peer.adaptive = adaptive;
+
+        // Inputs are usually held for several frames
+        uint16_t held = 0;
+
+        for ( uint32_t frame = 0; frame < SESSION_FRAMES; ++frame )
+        {
+            if ( rand() % 8 == 0 )
+                held = rand() % 0x400;
+
+            peer.inputs.push_back ( held );
+        }
+    }
+
+    for ( LossyLoopback& channel : channels )
+        channel.packetLoss = packetLoss;
+
+    for ( uint32_t frame = 0; frame < SESSION_FRAMES; ++frame )
+    {
+        for ( uint8_t i = 0; i < 2; ++i )
+        {
+            const MsgPtr msg = peers[i].getInputs ( frame );
+
+            channels[i].send ( peers[i], msg, frame );
+
+            if ( adaptive && peers[i].window.shouldDuplicate() )
+                channels[i].send ( peers[i], msg, frame );
+        }
+
+        for ( uint8_t i = 0; i < 2; ++i )
+            channels[i].receive ( frame, [&] ( const MsgPtr& msg ) { peers[1 - i].setInputs ( msg, frame ); } );
+    }
+
+    SessionResult result;
+
+    const Peer& peer = peers[1];
+    const size_t count = min<size_t> ( peer.received.size(), SESSION_FRAMES - NUM_INPUTS );
+
+    for ( uint32_t frame = 0; frame < count; ++frame )
+    {
+        const uint32_t latency = peer.receivedFrame[frame] - frame;
+
+        result.averageLatency += latency;
+        result.worstLatency = max ( result.worstLatency, latency );
+        result.numWrong += ( peer.received[frame] != peers[0].inputs[frame] );
+    }
+
+    result.averageLatency /= count;
+    result.bytesPerFrame = double ( peers[0].numBytes ) / SESSION_FRAMES;
+
+    EXPECT_EQ ( size_t ( SESSION_FRAMES - NUM_INPUTS ), count ) << "packetLoss=" << packetLoss;
+
+    return result;
+}
+
+
+TEST ( InputsWindow, WindowFromPacketLoss )
+{
+    InputsWindow window;
+
+    EXPECT_EQ ( MIN_INPUTS_WINDOW, window.getWindow() );
+
+    // One in every four remote frames is lost
+    for ( uint32_t frame = 0; frame < 4000; ++frame )
+    {
+        if ( frame % 4 != 3 )
+            window.gotRemoteFrame ( {{ frame, 0 }} );
+    }
+
+    EXPECT_NEAR ( 0.25, window.getPacketLoss(), 0.05 );
+    EXPECT_EQ ( uint32_t ( ceil ( log ( INPUTS_WINDOW_LOSS_TARGET ) / log ( window.getPacketLoss() ) ) ),
+                window.getWindow() );
+    EXPECT_TRUE ( window.shouldDuplicate() );
+
+    // Resent and older messages don't count
+    window.reset();
+
+    for ( uint32_t frame = 0; frame < 100; ++frame )
+    {
+        window.gotRemoteFrame ( {{ frame, 1 }} );
+        window.gotRemoteFrame ( {{ frame, 1 }} );
+        window.gotRemoteFrame ( {{ frame / 2, 1 }} );
+    }
+
+    EXPECT_EQ ( 0, window.getPacketLoss() );
+    EXPECT_FALSE ( window.shouldDuplicate() );
+
+    window.maxWindow = 5;
+
+    for ( uint32_t frame = 0; frame < 4000; frame += 2 )
+        window.gotRemoteFrame ( {{ frame, 2 }} );
+
+    EXPECT_EQ ( 5u, window.getWindow() );
+}
+
+TEST ( InputsWindow, NumInputsFromAck )
+{
+    InputsWindow window;
+
+    // Until the remote acks inputs in the same index, send as many as possible
+    EXPECT_EQ ( 10u, window.getNumInputs ( {{ 9, 1 }}, {{ 0, 0 }} ) );
+    EXPECT_EQ ( 30u, window.getNumInputs ( {{ 99, 1 }}, {{ 50, 0 }} ) );
+    EXPECT_EQ ( 30u, window.getNumInputs ( {{ 99, 1 }}, {{ 0, 1 }} ) );
+
+    for ( uint32_t frame = 0; frame < 1000; ++frame )
+        window.gotRemoteAck ( {{ frame, 1 }}, {{ frame + 5, 1 }} );
+
+    EXPECT_NEAR ( 6, window.getRoundTrip(), 0.01 );
+
+    // Only unacked inputs are sent, up to the window
+    EXPECT_EQ ( 3u, window.getNumInputs ( {{ 99, 1 }}, {{ 97, 1 }} ) );
+    EXPECT_EQ ( 1u, window.getNumInputs ( {{ 99, 1 }}, {{ 100, 1 }} ) );
+    EXPECT_EQ ( uint32_t ( MIN_INPUTS_WINDOW ), window.getNumInputs ( {{ 99, 1 }}, {{ 90, 1 }} ) );
+
+    // Everything since an overdue ack is resent
+    EXPECT_EQ ( 20u, window.getNumInputs ( {{ 99, 1 }}, {{ 80, 1 }} ) );
+    EXPECT_EQ ( 30u, window.getNumInputs ( {{ 99, 1 }}, {{ 10, 1 }} ) );
+}
+
+TEST ( InputsWindow, LossyLoopbackLatency )
+{
+    for ( uint32_t packetLoss : { 0, 5, 20, 40 } )
+    {
+        const SessionResult fixed = simulateSession ( false, packetLoss );
+        const SessionResult adaptive = simulateSession ( true, packetLoss );
+
+        EXPECT_EQ ( 0u, adaptive.numWrong ) << "packetLoss=" << packetLoss;
+
+        PRINT ( "InputsWindow: loss=%u%%; fixed: %.2f/%u frames, %.1f bytes/frame, %u wrong; "
+                "adaptive: %.2f/%u frames, %.1f bytes/frame, %u wrong", packetLoss,
+                fixed.averageLatency, fixed.worstLatency, fixed.bytesPerFrame, fixed.numWrong,
+                adaptive.averageLatency, adaptive.worstLatency, adaptive.bytesPerFrame, adaptive.numWrong );
+
+        if ( packetLoss <= 5 )
+        {
+            EXPECT_LT ( adaptive.bytesPerFrame, fixed.bytesPerFrame ) << "packetLoss=" << packetLoss;
+        }
+    }
+}
+
+#endif // NOT RELEASE
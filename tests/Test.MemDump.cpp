@@ -0,0 +1,284 @@
+#ifndef RELEASE
+
+#include "MemDump.hpp"
+#include "StringUtils.hpp"
+#include "Compression.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <sstream>
+
+using namespace std;
+
+
+#define STATIC_SIZE     ( 128 * 1024 )
+#define NUM_EFFECTS     ( 1000 )
+#define EFFECT_SIZE     ( 0x33C )
+#define CHILD_SIZE      ( 0x300 )
+#define GRANDCHILD_SIZE ( 0x100 )
+#define NUM_ITERATIONS  ( 200 )
+
+
+// Synthetic ~2 MB memory layout: a large static block, plus an array of effects each with a nested pointer chain
+struct SyntheticLayout
+{
+    vector<char> staticBlock, effects, children, grandchildren;
+
+    MemDumpList allAddrs;
+
+    SyntheticLayout()
+        : staticBlock ( STATIC_SIZE )
+        , effects ( NUM_EFFECTS * EFFECT_SIZE )
+        , children ( NUM_EFFECTS * CHILD_SIZE )
+        , grandchildren ( NUM_EFFECTS * GRANDCHILD_SIZE )
+    {
+        randomize();
+
+        for ( size_t i = 0; i < NUM_EFFECTS; ++i )
+        {
+            // Some effects are inactive and have null pointers
+            char *child = ( i % 4 == 0 ? 0 : &children[i * CHILD_SIZE] );
+            char *grandchild = ( i % 3 == 0 ? 0 : &grandchildren[i * GRANDCHILD_SIZE] );
+
+            memcpy ( &effects[i * EFFECT_SIZE + 0x10], &child, sizeof ( child ) );
+            memcpy ( &children[i * CHILD_SIZE + 0x20], &grandchild, sizeof ( grandchild ) );
+
+            allAddrs.append ( MemDump ( &effects[i * EFFECT_SIZE], EFFECT_SIZE,
+            {
+                MemDumpPtr ( 0x10, 0, CHILD_SIZE,
+                {
+                    MemDumpPtr ( 0x20, 0, GRANDCHILD_SIZE )
+                } )
+            } ) );
+        }
+
+        allAddrs.append ( MemDump ( &staticBlock[0], STATIC_SIZE ) );
+        allAddrs.update();
+    }
+
+    // Randomize all data except the pointers
+    void randomize()
+    {
+        for ( char& c : staticBlock )
+            c = rand();
+
+        for ( size_t i = 0; i < effects.size(); ++i )
+        {
+            if ( i % EFFECT_SIZE < 0x10 || i % EFFECT_SIZE >= 0x10 + sizeof ( char * ) )
+                effects[i] = rand();
+        }
+
+        for ( size_t i = 0; i < children.size(); ++i )
+        {
+            if ( i % CHILD_SIZE < 0x20 || i % CHILD_SIZE >= 0x20 + sizeof ( char * ) )
+                children[i] = rand();
+        }
+
+        for ( char& c : grandchildren )
+            c = rand();
+    }
+
+    // Save / load with the recursive walk
+    void saveDump ( char *rawBytes ) const
+    {
+        char *dump = rawBytes;
+
+        for ( const MemDump& mem : allAddrs.addrs )
+            mem.saveDump ( dump );
+    }
+
+    void loadDump ( const char *rawBytes ) const
+    {
+        const char *dump = rawBytes;
+
+        for ( const MemDump& mem : allAddrs.addrs )
+            mem.loadDump ( dump );
+    }
+};
+
+
+template<typename F>
+static double timeMicroseconds ( const F& func )
+{
+    const auto start = chrono::high_resolution_clock::now();
+
+    for ( size_t i = 0; i < NUM_ITERATIONS; ++i )
+        func();
+
+    const auto end = chrono::high_resolution_clock::now();
+
+    return chrono::duration<double, micro> ( end - start ).count() / NUM_ITERATIONS;
+}
+
+
+TEST ( MemDump, PlanMatchesRecursive )
+{
+    SyntheticLayout layout;
+
+    ASSERT_FALSE ( layout.allAddrs.plan.empty() );
+    ASSERT_EQ ( layout.allAddrs.totalSize, layout.allAddrs.plan.totalSize );
+
+    const size_t totalSize = layout.allAddrs.totalSize;
+
+    vector<char> recursive ( totalSize ), flat ( totalSize );
+
+    layout.saveDump ( &recursive[0] );
+    layout.allAddrs.plan.saveDump ( &flat[0] );
+
+    EXPECT_EQ ( 0, memcmp ( &recursive[0], &flat[0], totalSize ) );
+
+    // Loading the saved dump restores the original data
+    layout.randomize();
+    layout.allAddrs.plan.loadDump ( &flat[0] );
+    layout.saveDump ( &recursive[0] );
+
+    EXPECT_EQ ( 0, memcmp ( &recursive[0], &flat[0], totalSize ) );
+}
+
+TEST ( MemDump, PlanBenchmark )
+{
+    SyntheticLayout layout;
+
+    const size_t totalSize = layout.allAddrs.totalSize;
+
+    vector<char> dump ( totalSize );
+
+    const double recursiveSave = timeMicroseconds ( [&] { layout.saveDump ( &dump[0] ); } );
+    const double recursiveLoad = timeMicroseconds ( [&] { layout.loadDump ( &dump[0] ); } );
+    const double flatSave = timeMicroseconds ( [&] { layout.allAddrs.plan.saveDump ( &dump[0] ); } );
+    const double flatLoad = timeMicroseconds ( [&] { layout.allAddrs.plan.loadDump ( &dump[0] ); } );
+
+    PRINT ( "MemDump: totalSize=%u bytes; ops=%u", totalSize, layout.allAddrs.plan.numOps );
+    PRINT ( "MemDump: recursive save=%.1f us; load=%.1f us", recursiveSave, recursiveLoad );
+    PRINT ( "MemDump: flat plan save=%.1f us; load=%.1f us", flatSave, flatLoad );
+}
+
+TEST ( MemDump, UpdateMergesRanges )
+{
+    SyntheticLayout layout;
+
+    // All effects are continuous, so they are merged into one memory dump, with the pointer offsets shifted
+    ASSERT_EQ ( 2u, layout.allAddrs.addrs.size() );
+    EXPECT_TRUE ( layout.allAddrs.overlaps.empty() );
+
+    const MemDump& merged = ( layout.allAddrs.addrs[0].addr == &layout.effects[0]
+                              ? layout.allAddrs.addrs[0] : layout.allAddrs.addrs[1] );
+
+    ASSERT_EQ ( &layout.effects[0], merged.addr );
+    ASSERT_EQ ( size_t ( NUM_EFFECTS * EFFECT_SIZE ), merged.size );
+    ASSERT_EQ ( size_t ( NUM_EFFECTS ), merged.ptrs.size() );
+
+    for ( size_t i = 0; i < NUM_EFFECTS; ++i )
+    {
+        char *child = ( i % 4 == 0 ? 0 : &layout.children[i * CHILD_SIZE] );
+
+        EXPECT_EQ ( i * EFFECT_SIZE + 0x10, merged.ptrs[i].srcOffset ) << "i=" << i;
+        EXPECT_EQ ( child, merged.ptrs[i].getAddr() ) << "i=" << i;
+    }
+
+    // Overlapping ranges are reported and not merged
+    vector<char> bytes ( 0x100 );
+
+    MemDumpList list;
+    list.append ( MemDump ( &bytes[0x80], 0x40 ) );
+    list.append ( MemDump ( &bytes[0x00], 0x40 ) );
+    list.append ( MemDump ( &bytes[0x40], 0x20 ) );
+    list.append ( MemDump ( &bytes[0x50], 0x10 ) );
+    list.update();
+
+    ASSERT_EQ ( 3u, list.addrs.size() );
+    EXPECT_EQ ( size_t ( 0x60 ), list.addrs[0].size );
+    EXPECT_EQ ( size_t ( 0xB0 ), list.totalSize );
+
+    ASSERT_EQ ( 1u, list.overlaps.size() );
+    EXPECT_EQ ( &bytes[0x00], list.overlaps[0].firstAddr );
+    EXPECT_EQ ( size_t ( 0x60 ), list.overlaps[0].firstSize );
+    EXPECT_EQ ( &bytes[0x50], list.overlaps[0].secondAddr );
+    EXPECT_EQ ( size_t ( 0x10 ), list.overlaps[0].secondSize );
+
+    // Ranges contained in an earlier range are all reported, not just the first one
+    list.clear();
+    list.append ( MemDump ( &bytes[0x00], 0x100 ) );
+    list.append ( MemDump ( &bytes[0x10], 0x10 ) );
+    list.append ( MemDump ( &bytes[0x20], 0x10 ) );
+    list.append ( MemDump ( &bytes[0x50], 0x10 ) );
+    list.update();
+
+    ASSERT_EQ ( 4u, list.addrs.size() );
+    ASSERT_EQ ( 3u, list.overlaps.size() );
+
+    for ( const MemDumpOverlap& overlap : list.overlaps )
+    {
+        EXPECT_EQ ( &bytes[0x00], overlap.firstAddr );
+        EXPECT_EQ ( size_t ( 0x100 ), overlap.firstSize );
+    }
+
+    EXPECT_EQ ( &bytes[0x20], list.overlaps[1].secondAddr );
+    EXPECT_EQ ( &bytes[0x50], list.overlaps[2].secondAddr );
+}
+
+// Compare ops as they are stored on disk, since addresses are 32-bit
+static void expectSameOps ( const MemDumpPlan& a, const MemDumpPlan& b )
+{
+    ASSERT_EQ ( a.numOps, b.numOps );
+    ASSERT_EQ ( a.totalSize, b.totalSize );
+
+    for ( size_t i = 0; i < a.numOps; ++i )
+    {
+        EXPECT_EQ ( a.ops[i].depth, b.ops[i].depth ) << "i=" << i;
+        EXPECT_EQ ( uint32_t ( a.ops[i].src ), uint32_t ( b.ops[i].src ) ) << "i=" << i;
+        EXPECT_EQ ( a.ops[i].dst, b.ops[i].dst ) << "i=" << i;
+        EXPECT_EQ ( a.ops[i].size, b.ops[i].size ) << "i=" << i;
+    }
+}
+
+TEST ( MemDump, FlatLayout )
+{
+    SyntheticLayout layout;
+
+    // Old cereal format
+    ostringstream ss ( ostringstream::binary );
+    {
+        cereal::BinaryOutputArchive archive ( ss );
+        layout.allAddrs.save ( archive );
+    }
+
+    string legacy = ss.str();
+    char md5[16];
+    getMD5 ( legacy, md5 );
+    legacy.append ( md5, sizeof ( md5 ) );
+
+    // Flat format
+    string flat;
+    layout.allAddrs.plan.save ( flat );
+
+    MemDumpPlan legacyPlan, flatPlan;
+
+    const double legacyLoad = timeMicroseconds ( [&] { legacyPlan.load ( &legacy[0], legacy.size() ); } );
+    const double flatLoad = timeMicroseconds ( [&] { flatPlan.load ( &flat[0], flat.size() ); } );
+
+    expectSameOps ( layout.allAddrs.plan, legacyPlan );
+    expectSameOps ( layout.allAddrs.plan, flatPlan );
+
+    // Converting the old format gives the same bytes
+    string converted;
+    legacyPlan.save ( converted );
+    EXPECT_EQ ( flat, converted );
+
+    // Corrupted data fails to load
+    flat[sizeof ( MemDumpHeader )] ^= 1;
+    EXPECT_FALSE ( flatPlan.load ( &flat[0], flat.size() ) );
+    EXPECT_TRUE ( flatPlan.empty() );
+
+    PRINT ( "MemDump: legacy load=%.1f us; heapSize=%u bytes; %u bytes on disk",
+            legacyLoad, legacyPlan.getHeapSize(), legacy.size() );
+    PRINT ( "MemDump: flat load=%.1f us; heapSize=%u bytes; %u bytes on disk",
+            flatLoad, flatPlan.getHeapSize(), flat.size() );
+}
+
+#endif // NOT RELEASE
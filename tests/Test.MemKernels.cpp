@@ -0,0 +1,170 @@
+#ifndef RELEASE
+
+#include "MemKernels.hpp"
+#include "StringUtils.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+
+#define NUM_ITERATIONS  ( 1000 )
+#define MAX_LENGTH      ( 3000 )
+#define NUM_ROWS        ( 15 )
+#define BENCH_SIZE      ( 4 * 1024 * 1024 )
+#define BENCH_REPEAT    ( 20 )
+
+
+// Run a test with both the scalar and SSE2 paths
+template<typename F>
+static void forEachPath ( const F& func )
+{
+    const bool useSse2 = MemKernels::useSse2;
+
+    MemKernels::useSse2 = false;
+    func ( "scalar" );
+
+    if ( MemKernels::isSse2Supported() )
+    {
+        MemKernels::useSse2 = true;
+        func ( "sse2" );
+    }
+
+    MemKernels::useSse2 = useSse2;
+}
+
+template<typename F>
+static double gigabytesPerSecond ( size_t bytes, const F& func )
+{
+    const auto start = chrono::high_resolution_clock::now();
+
+    for ( size_t i = 0; i < BENCH_REPEAT; ++i )
+        func();
+
+    const auto end = chrono::high_resolution_clock::now();
+
+    return ( double ( bytes ) * BENCH_REPEAT ) / chrono::duration<double, nano> ( end - start ).count();
+}
+
+
+TEST ( MemKernels, Correctness )
+{
+    forEachPath ( [] ( const char *path )
+    {
+        vector<uint8_t> a ( MAX_LENGTH + 16 ), b ( MAX_LENGTH + 16 ), c ( MAX_LENGTH + 16 );
+        vector<vector<uint8_t>> rows ( NUM_ROWS, vector<uint8_t> ( MAX_LENGTH + 16 ) );
+
+        for ( size_t i = 0; i < NUM_ITERATIONS; ++i )
+        {
+            // Random unaligned offsets and lengths
+            const size_t offset = rand() % 16;
+            const size_t len = rand() % MAX_LENGTH;
+
+            for ( uint8_t& x : a )
+                x = rand();
+
+            // Copy
+            MemKernels::copy ( &b[offset], &a[offset], len );
+            EXPECT_EQ ( 0, memcmp ( &b[offset], &a[offset], len ) ) << path;
+
+            // First difference
+            const size_t diff = ( len ? rand() % ( len + 1 ) : 0 );
+            if ( diff < len )
+                b[offset + diff] ^= 0x80;
+
+            EXPECT_EQ ( diff, MemKernels::firstDifference ( &a[offset], &b[offset], len ) ) << path;
+
+            // Find byte
+            memset ( &c[0], 0, c.size() );
+            const size_t found = ( len ? rand() % ( len + 1 ) : 0 );
+            if ( found < len )
+                c[offset + found] = 0x80;
+
+            EXPECT_EQ ( found, MemKernels::findByte ( &c[offset], len, 0x80 ) ) << path;
+
+            // 16-bit words, differing in either byte
+            const size_t numWords = len / 2;
+            const size_t word = ( numWords ? rand() % ( numWords + 1 ) : 0 );
+
+            vector<uint16_t> x ( numWords + 1, 0x1234 ), y ( x );
+
+            if ( word < numWords )
+                y[word] ^= ( rand() % 2 ? 0x0100 : 0x0001 );
+
+            EXPECT_EQ ( word, MemKernels::firstDifference16 ( &x[0], &y[0], numWords ) ) << path;
+            EXPECT_EQ ( word, MemKernels::findNotEqual16 ( &y[0], numWords, 0x1234 ) ) << path;
+
+            // OR rows
+            const uint8_t *rowPtrs[NUM_ROWS];
+            const size_t numRows = rand() % NUM_ROWS;
+
+            for ( size_t r = 0; r < numRows; ++r )
+            {
+                for ( uint8_t& x : rows[r] )
+                    x = ( rand() % 8 == 0 ? 1 << ( rand() % 8 ) : 0 );
+
+                rowPtrs[r] = &rows[r][offset];
+            }
+
+            memcpy ( &b[0], &a[0], a.size() );
+            MemKernels::orRows ( &b[offset], rowPtrs, numRows, len );
+
+            for ( size_t j = 0; j < len; ++j )
+            {
+                uint8_t expected = a[offset + j];
+
+                for ( size_t r = 0; r < numRows; ++r )
+                    expected |= rows[r][offset + j];
+
+                ASSERT_EQ ( expected, b[offset + j] ) << path;
+            }
+        }
+    } );
+}
+
+TEST ( MemKernels, Benchmark )
+{
+    forEachPath ( [] ( const char *path )
+    {
+        vector<uint8_t> a ( BENCH_SIZE ), b ( BENCH_SIZE );
+        vector<vector<uint8_t>> rows ( NUM_ROWS, vector<uint8_t> ( BENCH_SIZE / NUM_ROWS ) );
+        const uint8_t *rowPtrs[NUM_ROWS];
+
+        for ( size_t r = 0; r < NUM_ROWS; ++r )
+            rowPtrs[r] = &rows[r][0];
+
+        size_t result = 0;
+
+        const double copy = gigabytesPerSecond ( BENCH_SIZE, [&]
+        {
+            MemKernels::copy ( &b[0], &a[0], BENCH_SIZE );
+        } );
+
+        const double firstDifference = gigabytesPerSecond ( 2 * BENCH_SIZE, [&]
+        {
+            result += MemKernels::firstDifference ( &a[0], &b[0], BENCH_SIZE );
+        } );
+
+        const double findByte = gigabytesPerSecond ( BENCH_SIZE, [&]
+        {
+            result += MemKernels::findByte ( &a[0], BENCH_SIZE, 0x80 );
+        } );
+
+        const double orRows = gigabytesPerSecond ( BENCH_SIZE, [&]
+        {
+            MemKernels::orRows ( &b[0], rowPtrs, NUM_ROWS, BENCH_SIZE / NUM_ROWS );
+        } );
+
+        EXPECT_EQ ( 2 * BENCH_SIZE * BENCH_REPEAT, result );
+
+        PRINT ( "MemKernels[%s]: copy=%.2f GB/s; firstDifference=%.2f GB/s; findByte=%.2f GB/s; orRows=%.2f GB/s",
+                path, copy, firstDifference, findByte, orRows );
+    } );
+}
+
+#endif // NOT RELEASE
@@ -0,0 +1,94 @@
+#ifndef RELEASE
+
+#include "Profiler.hpp"
+#include "Logger.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <cstdio>
+
+using namespace std;
+
+
+#define NUM_FRAMES      ( 2 * NUM_PROFILER_FRAMES )
+#define NUM_SCOPES      ( 1000000 )
+#define CSV_FILE        "test_profile.csv"
+
+
+TEST ( Profiler, RollingPercentiles )
+{
+    Profiler& profiler = Profiler::get();
+    profiler.reset();
+
+    const uint64_t ticksPerMicrosecond = Profiler::getTicksPerSecond() / 1000000;
+
+    // Every 50th frame is slow, older frames are outside the window
+    for ( uint32_t i = 0; i < NUM_FRAMES; ++i )
+    {
+        const uint32_t save = ( NUM_FRAMES - i <= PROFILER_WINDOW ? 100 : 1000 );
+
+        profiler.add ( Profiler::RollbackSave, save * ticksPerMicrosecond );
+        profiler.add ( Profiler::RollbackLoad, ( i % 50 == 0 ? 5000 : 10 ) * ticksPerMicrosecond );
+        profiler.nextFrame();
+    }
+
+    EXPECT_EQ ( 100u, profiler.getPercentile ( Profiler::RollbackSave, 0.5 ) );
+    EXPECT_EQ ( 100u, profiler.getPercentile ( Profiler::RollbackSave, 0.99 ) );
+    EXPECT_EQ ( 10u, profiler.getPercentile ( Profiler::RollbackLoad, 0.5 ) );
+    EXPECT_EQ ( 5000u, profiler.getPercentile ( Profiler::RollbackLoad, 0.99 ) );
+    EXPECT_EQ ( 0u, profiler.getPercentile ( Profiler::SocketCheck, 0.99 ) );
+
+    // The CSV has a header and one row for each kept frame
+    ASSERT_TRUE ( profiler.saveCsv ( CSV_FILE ) );
+
+    ifstream fin ( CSV_FILE );
+    string line;
+    size_t numLines = 0;
+
+    ASSERT_TRUE ( getline ( fin, line ).good() );
+    EXPECT_EQ ( "frame,RollbackSave,RollbackLoad,FrameStepNormal,FrameStepRerun,SocketCheck,PresentFrameEnd", line );
+
+    while ( getline ( fin, line ) )
+        ++numLines;
+
+    EXPECT_EQ ( size_t ( NUM_PROFILER_FRAMES - 1 ), numLines );
+
+    fin.close();
+    remove ( CSV_FILE );
+
+    profiler.reset();
+}
+
+TEST ( Profiler, ScopeOverhead )
+{
+    Profiler::get().reset();
+
+    // Disabled scopes don't record anything, like in MainApp where frames aren't advanced
+    {
+        PROFILE_SCOPE ( SocketCheck );
+    }
+
+    Profiler::get().nextFrame();
+    EXPECT_EQ ( 0u, Profiler::get().getPercentile ( Profiler::SocketCheck, 0.99 ) );
+
+    Profiler::enabled = true;
+
+    const auto start = chrono::high_resolution_clock::now();
+
+    for ( size_t i = 0; i < NUM_SCOPES; ++i )
+    {
+        PROFILE_SCOPE ( FrameStepNormal );
+    }
+
+    const auto end = chrono::high_resolution_clock::now();
+
+    PRINT ( "Profiler: scope overhead=%.1f ns", chrono::duration<double, nano> ( end - start ).count() / NUM_SCOPES );
+
+    Profiler::enabled = false;
+    Profiler::get().reset();
+}
+
+#endif // NOT RELEASE
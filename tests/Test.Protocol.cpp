@@ -0,0 +1,557 @@
+#ifndef RELEASE
+
+#include "Messages.hpp"
+#include "MessagePool.hpp"
+#include "Profiler.hpp"
+#include "Logger.hpp"
+#include "Test.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+
+#define NUM_ENCODES         ( 20000 )
+
+#define NUM_TRACE_FRAMES    ( 600 )
+
+#define NUM_DECODE_PASSES   ( 20 )
+
+#define NUM_CHECKSUMS       ( 200000 )
+
+#define NUM_SERIALIZES      ( 200000 )
+
+
+// Inputs are usually held for several frames
+template<size_t N>
+static void generateInputs ( array<uint16_t, N>& inputs )
+{
+    uint16_t held = 0;
+
+    for ( uint16_t& input : inputs )
+    {
+        if ( rand() % 8 == 0 )
+            held = rand() % 0x400;
+
+        input = held;
+    }
+}
+
+// The messages sent every frame
+static vector<MsgPtr> generateMessages()
+{
+    const IndexedFrame indexedFrame = {{ 1234, 5 }};
+
+    PlayerInputs *playerInputs = new PlayerInputs ( indexedFrame );
+    generateInputs ( playerInputs->inputs );
+
+    BothInputs *bothInputs = new BothInputs ( indexedFrame );
+    generateInputs ( bothInputs->inputs[0] );
+    generateInputs ( bothInputs->inputs[1] );
+
+    SyncHash *syncHash = new SyncHash();
+    syncHash->indexedFrame = indexedFrame;
+    syncHash->roundTimer = syncHash->realTimer = 1234;
+
+    for ( char& byte : syncHash->hash )
+        byte = rand();
+
+    for ( SyncHash::CharaHash& chara : syncHash->chara )
+    {
+        memset ( &chara, 0, sizeof ( chara ) );
+        chara.health = 11400;
+        chara.x = rand() % 0x10000;
+    }
+
+    return { MsgPtr ( playerInputs ), MsgPtr ( bothInputs ), MsgPtr ( syncHash ) };
+}
+
+// Reset a message as if it was just constructed, so each encode does the full work
+static void resetMessage ( const MsgPtr& msg )
+{
+    msg->compressionLevel = 9;
+    msg->invalidate();
+}
+
+
+TEST ( Protocol, EncodeBuffer )
+{
+    srand ( 1234 );
+
+    string buffer;
+
+    for ( const MsgPtr& msg : generateMessages() )
+    {
+        resetMessage ( msg );
+        const string expected = Protocol::encode ( msg );
+
+        // Buffers are replaced, not appended to
+        buffer = "garbage";
+
+        resetMessage ( msg );
+        EXPECT_EQ ( expected.size(), Protocol::encode ( msg, buffer ) );
+        EXPECT_EQ ( expected, buffer ) << msg;
+
+        size_t consumed = 0;
+        const MsgPtr decoded = Protocol::decode ( &buffer[0], buffer.size(), consumed );
+
+        ASSERT_TRUE ( decoded.get() ) << msg;
+        EXPECT_EQ ( buffer.size(), consumed );
+        EXPECT_EQ ( msg->getMsgType(), decoded->getMsgType() );
+    }
+
+    // Compressed messages are encoded in place
+    const IndexedFrame indexedFrame = {{ 0, 0 }};
+
+    BothInputs zeros ( indexedFrame );
+    zeros.inputs = {{ {{ 0 }}, {{ 0 }} }};
+
+    Protocol::encode ( zeros, buffer );
+    EXPECT_NE ( 0, buffer[1] );
+
+    size_t consumed = 0;
+    const MsgPtr decoded = Protocol::decode ( &buffer[0], buffer.size(), consumed );
+
+    ASSERT_TRUE ( decoded.get() );
+    EXPECT_EQ ( buffer.size(), consumed );
+    EXPECT_TRUE ( decoded->getAs<BothInputs>().inputs == zeros.inputs );
+
+    EXPECT_EQ ( 0u, Protocol::encode ( NullMsg, buffer ) );
+    EXPECT_TRUE ( buffer.empty() );
+}
+
+TEST ( Protocol, EncodeBenchmark )
+{
+    srand ( 1234 );
+
+    string buffer;
+
+    for ( const MsgPtr& msg : generateMessages() )
+    {
+        // Grow the buffer first, like after the first message sent
+        resetMessage ( msg );
+        Protocol::encode ( msg, buffer );
+
+        size_t mallocs = getNumMallocs();
+        uint64_t ticks = Profiler::getTicks();
+
+        for ( size_t i = 0; i < NUM_ENCODES; ++i )
+        {
+            resetMessage ( msg );
+            const string bytes = Protocol::encode ( msg );
+        }
+
+        const double stringNs = 1e9 * ( Profiler::getTicks() - ticks ) / Profiler::getTicksPerSecond() / NUM_ENCODES;
+        const double stringMallocs = double ( getNumMallocs() - mallocs ) / NUM_ENCODES;
+
+        // The same without compression, which allocates its own state on every call
+        mallocs = getNumMallocs();
+        ticks = Profiler::getTicks();
+
+        for ( size_t i = 0; i < NUM_ENCODES; ++i )
+        {
+            resetMessage ( msg );
+            msg->compressionLevel = 0;
+            Protocol::encode ( msg, buffer );
+        }
+
+        const double uncompressedNs = 1e9 * ( Profiler::getTicks() - ticks ) / Profiler::getTicksPerSecond() / NUM_ENCODES;
+        const double uncompressedMallocs = double ( getNumMallocs() - mallocs ) / NUM_ENCODES;
+
+        mallocs = getNumMallocs();
+        ticks = Profiler::getTicks();
+
+        for ( size_t i = 0; i < NUM_ENCODES; ++i )
+        {
+            resetMessage ( msg );
+            Protocol::encode ( msg, buffer );
+        }
+
+        const double bufferNs = 1e9 * ( Profiler::getTicks() - ticks ) / Profiler::getTicksPerSecond() / NUM_ENCODES;
+        const double bufferMallocs = double ( getNumMallocs() - mallocs ) / NUM_ENCODES;
+
+        PRINT ( "%s: %u bytes; string: %.0f ns, %.1f mallocs; buffer: %.0f ns, %.1f mallocs; "
+                "uncompressed: %.0f ns, %.1f mallocs", msg->getMsgType(), buffer.size(),
+                stringNs, stringMallocs, bufferNs, bufferMallocs, uncompressedNs, uncompressedMallocs );
+
+        // Encoding into a reused buffer allocates less than a new string, and nothing except for compression
+        EXPECT_LT ( bufferMallocs, stringMallocs ) << msg;
+        EXPECT_EQ ( 0.0, uncompressedMallocs ) << msg;
+    }
+}
+
+// The messages sent during a 10 second netplay session
+static vector<MsgPtr> generateSession()
+{
+    vector<MsgPtr> session;
+
+    for ( uint32_t frame = 0; frame < NUM_TRACE_FRAMES; ++frame )
+    {
+        for ( const MsgPtr& msg : generateMessages() )
+        {
+            // Sync hashes are only sent once per second
+            if ( msg->getMsgType() == MsgType::SyncHash && frame % 60 )
+                continue;
+
+            session.push_back ( msg );
+        }
+    }
+
+    return session;
+}
+
+// Bytes received during the session, as read into a socket's buffer
+static string generateTrace ( ChecksumType checksum = ChecksumType::MD5 )
+{
+    string trace, buffer;
+
+    for ( const MsgPtr& msg : generateSession() )
+    {
+        Protocol::encode ( msg, buffer, checksum );
+        trace += buffer;
+    }
+
+    return trace;
+}
+
+// Decode every message in the trace like Socket::readEvent, returns the number of messages
+static size_t decodeTrace ( const string& trace )
+{
+    size_t count = 0;
+
+    for ( size_t pos = 0; pos < trace.size(); )
+    {
+        size_t consumed = 0;
+        const MsgPtr msg = Protocol::decode ( &trace[pos], trace.size() - pos, consumed );
+
+        if ( ! msg.get() )
+            break;
+
+        pos += consumed;
+        ++count;
+    }
+
+    return count;
+}
+
+TEST ( Protocol, DecodeBenchmark )
+{
+    srand ( 1234 );
+
+    const string trace = generateTrace();
+
+    // Fill the message pools first, like after the first few frames
+    const size_t count = decodeTrace ( trace );
+
+    ASSERT_EQ ( NUM_TRACE_FRAMES * 2 + NUM_TRACE_FRAMES / 60, count );
+
+    const size_t heapBlocks = getNumPoolHeapBlocks();
+    const size_t mallocs = getNumMallocs();
+    const uint64_t ticks = Profiler::getTicks();
+
+    for ( size_t i = 0; i < NUM_DECODE_PASSES; ++i )
+        EXPECT_EQ ( count, decodeTrace ( trace ) );
+
+    const double seconds = double ( Profiler::getTicks() - ticks ) / Profiler::getTicksPerSecond();
+    const double mallocsPerMsg = double ( getNumMallocs() - mallocs ) / ( count * NUM_DECODE_PASSES );
+
+    PRINT ( "Decoded %u messages in %u bytes; %.0f msgs/s; %.2f mallocs/msg; %u new pool blocks",
+            count, trace.size(), count * NUM_DECODE_PASSES / seconds, mallocsPerMsg,
+            size_t ( getNumPoolHeapBlocks() - heapBlocks ) );
+
+    // Decoded messages only reuse pooled blocks once the pools are filled, and nothing else allocates
+    EXPECT_EQ ( heapBlocks, size_t ( getNumPoolHeapBlocks() ) );
+    EXPECT_EQ ( 0.0, mallocsPerMsg );
+}
+
+TEST ( Protocol, DecodePooled )
+{
+    srand ( 1234 );
+
+    const string bytes = Protocol::encode ( generateMessages()[0] );
+
+    size_t consumed = 0;
+    MsgPtr msg = Protocol::decode ( &bytes[0], bytes.size(), consumed );
+    ASSERT_TRUE ( msg.get() );
+
+    // The pooled block is only reused after the last reference is dropped
+    MsgPtr copy = msg;
+    const Serializable *const ptr = msg.get();
+
+    msg.reset();
+    msg = Protocol::decode ( &bytes[0], bytes.size(), consumed );
+    EXPECT_NE ( ptr, msg.get() );
+
+    // Freed blocks are reused last in first out
+    msg.reset();
+    copy.reset();
+    msg = Protocol::decode ( &bytes[0], bytes.size(), consumed );
+    EXPECT_EQ ( ptr, msg.get() );
+}
+
+TEST ( Protocol, Checksum )
+{
+    // Reference values
+    EXPECT_EQ ( 0xE3069283, Checksum::crc32c ( "123456789", 9 ) );
+    EXPECT_EQ ( 0x02CC5D05, Checksum::xxHash32 ( "", 0 ) );
+    EXPECT_EQ ( 0x32D153FF, Checksum::xxHash32 ( "abc", 3 ) );
+
+    // The SSE4.2 and table CRC32C agree for every length and alignment
+    char bytes[256];
+    for ( size_t i = 0; i < sizeof ( bytes ); ++i )
+        bytes[i] = rand();
+
+    const bool useSse42 = Checksum::useSse42;
+
+    for ( size_t i = 0; i < 8; ++i )
+    {
+        for ( size_t len = 0; len + i <= sizeof ( bytes ); len += 13 )
+        {
+            Checksum::useSse42 = false;
+            const uint32_t crc = Checksum::crc32c ( &bytes[i], len );
+
+            Checksum::useSse42 = Checksum::isSse42Supported();
+            EXPECT_EQ ( crc, Checksum::crc32c ( &bytes[i], len ) ) << "len=" << len << "; offset=" << i;
+        }
+    }
+
+    Checksum::useSse42 = useSse42;
+
+    srand ( 1234 );
+
+    string buffer;
+
+    for ( ChecksumType checksum : { ChecksumType::MD5, ChecksumType::CRC32C, ChecksumType::XXHash32 } )
+    {
+        for ( const MsgPtr& msg : generateMessages() )
+        {
+            resetMessage ( msg );
+            Protocol::encode ( msg, buffer, checksum );
+
+            size_t consumed = 0;
+            MsgPtr decoded = Protocol::decode ( &buffer[0], buffer.size(), consumed );
+
+            ASSERT_TRUE ( decoded.get() ) << msg;
+            EXPECT_EQ ( buffer.size(), consumed );
+
+            // Re-encoding with a different checksum replaces the cached hash
+            const string bytes = buffer;
+            Protocol::encode ( msg, buffer, ChecksumType::MD5 );
+            Protocol::encode ( msg, buffer, checksum );
+            EXPECT_EQ ( bytes, buffer ) << msg;
+
+            // Corrupt the last byte of the checksum
+            buffer.back() ^= 1;
+            decoded = Protocol::decode ( &buffer[0], buffer.size(), consumed );
+            EXPECT_FALSE ( decoded.get() ) << msg;
+        }
+    }
+
+    // Uncompressed MD5 messages have the same header as older versions
+    const MsgPtr msg = generateMessages()[0];
+    msg->compressionLevel = 0;
+
+    Protocol::encode ( msg, buffer, ChecksumType::MD5 );
+    EXPECT_EQ ( 0, buffer[1] );
+}
+
+TEST ( Protocol, ChecksumBenchmark )
+{
+    static const char *names[] = { "MD5", "CRC32C", "XXHash32" };
+
+    char bytes[64];
+    for ( char& byte : bytes )
+        byte = rand();
+
+    for ( ChecksumType checksum : { ChecksumType::MD5, ChecksumType::CRC32C, ChecksumType::XXHash32 } )
+    {
+        srand ( 1234 );
+
+        char result[CHECKSUM_MAX_SIZE];
+        uint64_t ticks = Profiler::getTicks();
+
+        for ( size_t i = 0; i < NUM_CHECKSUMS; ++i )
+            Checksum::calculate ( checksum, bytes, sizeof ( bytes ), result );
+
+        const double checksumNs = 1e9 * ( Profiler::getTicks() - ticks ) / Profiler::getTicksPerSecond()
+                                  / NUM_CHECKSUMS;
+
+        // Uncompressed messages, like DeltaInputs, so the checksum isn't hidden by compression
+        const vector<MsgPtr> session = generateSession();
+        string buffer;
+        size_t wireSize = 0;
+
+        for ( const MsgPtr& msg : session )
+            msg->compressionLevel = 0;
+
+        ticks = Profiler::getTicks();
+
+        for ( size_t i = 0; i < NUM_DECODE_PASSES; ++i )
+        {
+            for ( const MsgPtr& msg : session )
+            {
+                msg->invalidate();
+                wireSize += Protocol::encode ( msg, buffer, checksum );
+            }
+        }
+
+        const double encodeNs = 1e9 * ( Profiler::getTicks() - ticks ) / Profiler::getTicksPerSecond()
+                                / ( session.size() * NUM_DECODE_PASSES );
+
+        string trace;
+
+        for ( const MsgPtr& msg : session )
+        {
+            Protocol::encode ( msg, buffer, checksum );
+            trace += buffer;
+        }
+
+        ticks = Profiler::getTicks();
+
+        for ( size_t i = 0; i < NUM_DECODE_PASSES; ++i )
+            EXPECT_EQ ( session.size(), decodeTrace ( trace ) );
+
+        const double seconds = double ( Profiler::getTicks() - ticks ) / Profiler::getTicksPerSecond();
+
+        PRINT ( "%s: %.0f ns / 64 bytes; encode %.0f ns/msg; decode %.0f msgs/s; %.1f bytes/msg",
+                names[uint32_t ( checksum )], checksumNs, encodeNs, session.size() * NUM_DECODE_PASSES / seconds,
+                double ( wireSize ) / ( session.size() * NUM_DECODE_PASSES ) );
+    }
+}
+
+// Serialize the message data with cereal, without the base data or hash
+static string saveCereal ( const MsgPtr& msg )
+{
+    ostringstream ss ( stringstream::binary );
+    cereal::BinaryOutputArchive archive ( ss );
+    msg->save ( archive );
+    return ss.str();
+}
+
+TEST ( Protocol, FixedLayout )
+{
+    static_assert ( FixedLayout::Layout<uint32_t, int8_t>::size == 5, "Fields aren't padded" );
+    static_assert ( FixedLayout::Layout<uint32_t, std::array<std::array<uint16_t, 3>, 2>>::size == 16, "" );
+    static_assert ( ! FixedLayout::Layout<uint32_t, std::string>::isFixed, "Strings don't have a fixed size" );
+    static_assert ( FixedLayout::Layout<uint32_t, std::string>::size == 0, "" );
+
+    srand ( 1234 );
+
+    vector<MsgPtr> msgs = generateMessages();
+    msgs.pop_back();
+
+    RngState *rngState = new RngState ( 12 );
+    rngState->rngState0 = rand();
+    rngState->rngState1 = rand();
+    rngState->rngState2 = rand();
+    for ( char& byte : rngState->rngState3 )
+        byte = rand();
+
+    ChangeConfig *changeConfig = new ChangeConfig();
+    changeConfig->value = ChangeConfig::Rollback;
+    changeConfig->indexedFrame = {{ 1234, 5 }};
+    changeConfig->delay = 4;
+    changeConfig->rollback = 2;
+
+    msgs.push_back ( MsgPtr ( rngState ) );
+    msgs.push_back ( MsgPtr ( changeConfig ) );
+    msgs.push_back ( MsgPtr ( new MenuIndex ( 34, -1 ) ) );
+    msgs.push_back ( MsgPtr ( new TransitionIndex ( 56 ) ) );
+
+    string buffer;
+
+    for ( const MsgPtr& msg : msgs )
+    {
+        const string expected = saveCereal ( msg );
+
+        // Fixed layouts write the same bytes as cereal
+        ASSERT_EQ ( expected.size(), msg->getFixedSize() ) << msg;
+
+        string bytes ( msg->getFixedSize(), '\0' );
+        msg->saveFixed ( &bytes[0] );
+        EXPECT_EQ ( expected, bytes ) << msg;
+
+        // Decoded messages are loaded from the fixed layout
+        const bool isSequence = ( msg->getBaseType() == BaseType::SerializableSequence );
+
+        if ( isSequence )
+            msg->getAs<SerializableSequence>().setSequence ( 0x12345678 );
+
+        resetMessage ( msg );
+        Protocol::encode ( msg, buffer );
+
+        size_t consumed = 0;
+        const MsgPtr decoded = Protocol::decode ( &buffer[0], buffer.size(), consumed );
+
+        ASSERT_TRUE ( decoded.get() ) << msg;
+        EXPECT_EQ ( buffer.size(), consumed );
+        EXPECT_EQ ( expected, saveCereal ( decoded ) ) << msg;
+
+        // The base data is also written without cereal
+        if ( isSequence )
+        {
+            EXPECT_EQ ( 0x12345678u, decoded->getAs<SerializableSequence>().getSequence() ) << msg;
+        }
+
+        // A truncated message is rejected
+        buffer.resize ( buffer.size() - 1 );
+        EXPECT_FALSE ( Protocol::decode ( &buffer[0], buffer.size(), consumed ).get() ) << msg;
+    }
+
+    // Messages with dynamic members still go through cereal
+    EXPECT_EQ ( 0u, ErrorMessage ( "error" ).getFixedSize() );
+    EXPECT_EQ ( 0u, VersionConfig().getFixedSize() );
+    EXPECT_EQ ( 0u, InitialConfig().getFixedSize() );
+}
+
+TEST ( Protocol, FixedLayoutBenchmark )
+{
+    srand ( 1234 );
+
+    string buffer;
+
+    for ( const MsgPtr& msg : generateMessages() )
+    {
+        const size_t fixedSize = msg->getFixedSize();
+
+        if ( ! fixedSize )
+            continue;
+
+        uint64_t ticks = Profiler::getTicks();
+
+        for ( size_t i = 0; i < NUM_SERIALIZES; ++i )
+            buffer = saveCereal ( msg );
+
+        const double cerealNs = 1e9 * ( Profiler::getTicks() - ticks ) / Profiler::getTicksPerSecond() / NUM_SERIALIZES;
+
+        ticks = Profiler::getTicks();
+
+        for ( size_t i = 0; i < NUM_SERIALIZES; ++i )
+        {
+            buffer.resize ( fixedSize );
+            msg->saveFixed ( &buffer[0] );
+        }
+
+        const double fixedNs = 1e9 * ( Profiler::getTicks() - ticks ) / Profiler::getTicksPerSecond() / NUM_SERIALIZES;
+
+        PRINT ( "%s: %u bytes; cereal: %.0f ns; fixed: %.0f ns", msg->getMsgType(), fixedSize, cerealNs, fixedNs );
+    }
+
+    // The full encode and decode of the per-frame messages, which now use the fixed layouts
+    const string trace = generateTrace();
+    const size_t count = decodeTrace ( trace );
+    const uint64_t ticks = Profiler::getTicks();
+
+    for ( size_t i = 0; i < NUM_DECODE_PASSES; ++i )
+        EXPECT_EQ ( count, decodeTrace ( trace ) );
+
+    const double seconds = double ( Profiler::getTicks() - ticks ) / Profiler::getTicksPerSecond();
+
+    PRINT ( "Decoded %u messages; %.0f msgs/s", count, count * NUM_DECODE_PASSES / seconds );
+}
+
+#endif // NOT RELEASE
@@ -0,0 +1,246 @@
+#ifndef RELEASE
+
+#include "ReadBuffer.hpp"
+#include "Messages.hpp"
+#include "Profiler.hpp"
+#include "Logger.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+
+
+#define NUM_STREAM_MESSAGES     ( 2000 )
+
+#define NUM_STREAM_PASSES       ( 20 )
+
+#define LARGE_MESSAGE_SIZE      ( 256 * 1024 )
+
+#define LARGE_FRAGMENT_SIZE     ( 1460 )
+
+
+// Messages of different sizes, with every few messages framed
+static vector<MsgPtr> generateStream ( string& stream, bool allFramed = false )
+{
+    vector<MsgPtr> msgs;
+    string buffer;
+
+    for ( uint32_t i = 0; i < NUM_STREAM_MESSAGES; ++i )
+    {
+        MsgPtr msg;
+
+        switch ( rand() % 4 )
+        {
+            case 0:
+                msg.reset ( new TransitionIndex ( i ) );
+                break;
+
+            case 1:
+                msg.reset ( new MenuIndex ( i, rand() % 10 ) );
+                break;
+
+            case 2:
+            {
+                const IndexedFrame indexedFrame = {{ i, 0 }};
+                PlayerInputs *inputs = new PlayerInputs ( indexedFrame );
+
+                for ( uint16_t& input : inputs->inputs )
+                    input = rand() % 0x400;
+
+                msg.reset ( inputs );
+                break;
+            }
+
+            default:
+                msg.reset ( new ErrorMessage ( string ( rand() % 2000, 'a' + rand() % 26 ) ) );
+                break;
+        }
+
+        if ( allFramed || rand() % 3 )
+            Protocol::encodeFrame ( msg, buffer );
+        else
+            Protocol::encode ( msg, buffer );
+
+        stream += buffer;
+        msgs.push_back ( msg );
+    }
+
+    return msgs;
+}
+
+// Feed the stream into the buffer in fragments, like TCP reads, returns the decoded messages
+static vector<MsgPtr> readStream ( ReadBuffer& readBuffer, const string& stream, size_t maxFragmentSize )
+{
+    vector<MsgPtr> msgs;
+
+    for ( size_t pos = 0; pos < stream.size(); )
+    {
+        size_t len = 0;
+        char *space = readBuffer.getSpace ( len );
+
+        len = min ( len, min ( 1 + rand() % maxFragmentSize, stream.size() - pos ) );
+
+        memcpy ( space, &stream[pos], len );
+        readBuffer.commit ( len );
+        pos += len;
+
+        for ( ;; )
+        {
+            size_t consumed = 0;
+            MsgPtr msg = readBuffer.decode ( consumed );
+
+            if ( ! msg.get() )
+                break;
+
+            EXPECT_NE ( 0u, consumed );
+            msgs.push_back ( msg );
+        }
+    }
+
+    return msgs;
+}
+
+
+TEST ( ReadBuffer, RandomFragments )
+{
+    srand ( 1234 );
+
+    string stream;
+    const vector<MsgPtr> expected = generateStream ( stream );
+
+    ReadBuffer readBuffer;
+    readBuffer.reset();
+
+    for ( size_t maxFragmentSize : { 1, 7, 100, 1500, 65536 } )
+    {
+        const vector<MsgPtr> msgs = readStream ( readBuffer, stream, maxFragmentSize );
+
+        ASSERT_EQ ( expected.size(), msgs.size() ) << "maxFragmentSize=" << maxFragmentSize;
+
+        for ( size_t i = 0; i < msgs.size(); ++i )
+        {
+            ASSERT_EQ ( expected[i]->getMsgType(), msgs[i]->getMsgType() ) << "i=" << i;
+            EXPECT_EQ ( Protocol::encode ( expected[i] ), Protocol::encode ( msgs[i] ) ) << "i=" << i;
+        }
+
+        EXPECT_EQ ( 0u, readBuffer.getSize() );
+    }
+}
+
+TEST ( ReadBuffer, Cursor )
+{
+    const string bytes = Protocol::encode ( TransitionIndex ( 1 ) ) + Protocol::encode ( TransitionIndex ( 2 ) );
+
+    ReadBuffer readBuffer;
+    readBuffer.reset();
+
+    size_t len = 0;
+    char *space = readBuffer.getSpace ( len );
+    memcpy ( space, &bytes[0], bytes.size() );
+    readBuffer.commit ( bytes.size() - 1 );
+
+    // Consumed bytes only move the cursor, the rest of the bytes stay in place
+    size_t consumed = 0;
+    MsgPtr msg = readBuffer.decode ( consumed );
+
+    ASSERT_TRUE ( msg.get() );
+    EXPECT_EQ ( 1u, msg->getAs<TransitionIndex>().index );
+    EXPECT_EQ ( space + consumed, readBuffer.getData() );
+    EXPECT_EQ ( space + bytes.size() - 1, readBuffer.getSpace ( len ) );
+
+    EXPECT_FALSE ( readBuffer.decode ( consumed ).get() );
+
+    // The buffer rewinds once everything is consumed
+    readBuffer.commit ( 1 );
+    msg = readBuffer.decode ( consumed );
+
+    ASSERT_TRUE ( msg.get() );
+    EXPECT_EQ ( 2u, msg->getAs<TransitionIndex>().index );
+    EXPECT_EQ ( 0u, readBuffer.getSize() );
+    EXPECT_EQ ( space, readBuffer.getSpace ( len ) );
+}
+
+TEST ( ReadBuffer, InvalidData )
+{
+    string buffer;
+    Protocol::encodeFrame ( MsgPtr ( new TransitionIndex ( 1 ) ), buffer );
+
+    // Corrupt the checksum of the first frame, the next message is still decoded
+    string bytes = buffer;
+    bytes.back() ^= 1;
+    bytes += Protocol::encode ( TransitionIndex ( 2 ) );
+
+    ReadBuffer readBuffer;
+    readBuffer.assign ( &bytes[0], bytes.size() );
+
+    size_t consumed = 0;
+    MsgPtr msg = readBuffer.decode ( consumed );
+
+    ASSERT_TRUE ( msg.get() );
+    EXPECT_EQ ( 2u, msg->getAs<TransitionIndex>().index );
+    EXPECT_EQ ( 0u, readBuffer.getSize() );
+
+    // Bytes that aren't a message or a frame clear the buffer
+    bytes = string ( 1, char ( MsgType::LastType ) ) + buffer;
+    readBuffer.assign ( &bytes[0], bytes.size() );
+
+    EXPECT_FALSE ( readBuffer.decode ( consumed ).get() );
+    EXPECT_EQ ( 0u, readBuffer.getSize() );
+
+    // Frames that can never fit in the buffer clear it
+    const uint32_t size = 0xFFFFFFF0;
+    bytes = buffer;
+    memcpy ( &bytes[1], &size, sizeof ( size ) );
+    readBuffer.assign ( &bytes[0], bytes.size() );
+
+    EXPECT_FALSE ( readBuffer.decode ( consumed ).get() );
+    EXPECT_EQ ( 0u, readBuffer.getSize() );
+}
+
+TEST ( ReadBuffer, LargeMessageBenchmark )
+{
+    srand ( 1234 );
+
+    MsgPtr msg ( new ErrorMessage ( string ( LARGE_MESSAGE_SIZE, 'a' ) ) );
+    msg->compressionLevel = 0;
+
+    string unframed, framed;
+    Protocol::encode ( msg, unframed );
+    Protocol::encodeFrame ( msg, framed );
+
+    ReadBuffer readBuffer;
+    readBuffer.reset();
+
+    // Unframed messages are decoded again on every fragment until the whole message has arrived,
+    // framed messages only parse the header once and then wait for the rest.
+    for ( const string *bytes : { &unframed, &framed } )
+    {
+        const uint64_t ticks = Profiler::getTicks();
+
+        for ( size_t i = 0; i < NUM_STREAM_PASSES; ++i )
+            ASSERT_EQ ( 1u, readStream ( readBuffer, *bytes, LARGE_FRAGMENT_SIZE ).size() );
+
+        const double ms = 1e3 * ( Profiler::getTicks() - ticks ) / Profiler::getTicksPerSecond() / NUM_STREAM_PASSES;
+
+        PRINT ( "%s: %u bytes in fragments of up to %u bytes; %.2f ms",
+                ( bytes == &framed ? "Framed" : "Unframed" ), bytes->size(), LARGE_FRAGMENT_SIZE, ms );
+    }
+
+    // A stream of small framed messages
+    string stream;
+    const vector<MsgPtr> expected = generateStream ( stream, true );
+    const uint64_t ticks = Profiler::getTicks();
+
+    for ( size_t i = 0; i < NUM_STREAM_PASSES; ++i )
+        ASSERT_EQ ( expected.size(), readStream ( readBuffer, stream, LARGE_FRAGMENT_SIZE ).size() );
+
+    const double seconds = double ( Profiler::getTicks() - ticks ) / Profiler::getTicksPerSecond();
+
+    PRINT ( "Stream: %u messages in %u bytes; %.0f msgs/s",
+            expected.size(), stream.size(), expected.size() * NUM_STREAM_PASSES / seconds );
+}
+
+#endif // NOT RELEASE
@@ -0,0 +1,132 @@
+#ifndef RELEASE
+
+#include "RollbackKeyframes.hpp"
+#include "StringUtils.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+
+#define NUM_KEYFRAMES       ( 16 )
+#define NUM_RAW_BUFFERS     ( 3 )
+#define KEYFRAME_SIZE       ( 64 * 1024 )
+#define NUM_ITERATIONS      ( 2000 )
+#define BENCH_SIZE          ( 2 * 1024 * 1024 )
+#define BENCH_REPEAT        ( 10 )
+
+
+// Mostly zero bytes with some random runs, similar to game memory
+static void randomize ( char *bytes, size_t len )
+{
+    memset ( bytes, 0, len );
+
+    for ( size_t i = 0; i < len; i += 1 + rand() % 64 )
+        bytes[i] = rand();
+}
+
+
+TEST ( RollbackKeyframes, MatchesStored )
+{
+    srand ( 1234 );
+
+    RollbackKeyframes keyframes;
+    keyframes.allocate ( NUM_KEYFRAMES, NUM_RAW_BUFFERS, KEYFRAME_SIZE, 1 );
+
+    vector<string> expected ( NUM_KEYFRAMES );
+    string buffer ( KEYFRAME_SIZE, '\0' );
+
+    for ( size_t i = 0; i < NUM_ITERATIONS; ++i )
+    {
+        const uint32_t keyframe = rand() % NUM_KEYFRAMES;
+        const int action = rand() % 4;
+
+        if ( expected[keyframe].empty() )
+        {
+            expected[keyframe].resize ( KEYFRAME_SIZE );
+            randomize ( &expected[keyframe][0], KEYFRAME_SIZE );
+
+            memcpy ( keyframes.store ( keyframe ), &expected[keyframe][0], KEYFRAME_SIZE );
+        }
+        else if ( action == 0 )
+        {
+            keyframes.erase ( keyframe );
+            expected[keyframe].clear();
+        }
+        else if ( action == 1 )
+        {
+            keyframes.compress ( keyframe );
+        }
+        else
+        {
+            ASSERT_TRUE ( keyframes.load ( keyframe, &buffer[0] ) ) << "i=" << i;
+            ASSERT_EQ ( expected[keyframe], buffer ) << "i=" << i;
+        }
+
+        const RollbackKeyframes::Stats stats = keyframes.getStats();
+
+        ASSERT_LE ( stats.numRaw, NUM_RAW_BUFFERS );
+        ASSERT_EQ ( stats.numRaw * KEYFRAME_SIZE, stats.rawBytes );
+    }
+
+    // Every stored keyframe should still be loadable after being compressed
+    for ( uint32_t keyframe = 0; keyframe < NUM_KEYFRAMES; ++keyframe )
+    {
+        if ( expected[keyframe].empty() )
+            continue;
+
+        keyframes.compress ( keyframe );
+
+        ASSERT_TRUE ( keyframes.load ( keyframe, &buffer[0] ) );
+        EXPECT_EQ ( expected[keyframe], buffer );
+    }
+
+    keyframes.deallocate();
+}
+
+TEST ( RollbackKeyframes, UncompressLatency )
+{
+    srand ( 1234 );
+
+    RollbackKeyframes keyframes;
+    keyframes.allocate ( 2, 1, BENCH_SIZE, 1 );
+
+    string expected ( BENCH_SIZE, '\0' ), buffer ( BENCH_SIZE, '\0' );
+    randomize ( &expected[0], BENCH_SIZE );
+
+    // Storing the second keyframe forces the first one to be compressed
+    memcpy ( keyframes.store ( 0 ), &expected[0], BENCH_SIZE );
+    keyframes.compress ( 0 );
+    keyframes.store ( 1 );
+
+    ASSERT_FALSE ( keyframes.isRaw ( 0 ) );
+
+    double worst = 0;
+
+    for ( size_t i = 0; i < BENCH_REPEAT; ++i )
+    {
+        const auto start = chrono::high_resolution_clock::now();
+
+        ASSERT_TRUE ( keyframes.load ( 0, &buffer[0] ) );
+
+        const auto end = chrono::high_resolution_clock::now();
+
+        worst = max ( worst, chrono::duration<double, milli> ( end - start ).count() );
+    }
+
+    EXPECT_EQ ( expected, buffer );
+
+    const RollbackKeyframes::Stats stats = keyframes.getStats();
+
+    PRINT ( "RollbackKeyframes: size=%u; compressedBytes=%u; worstUncompressTime=%.2f ms",
+            BENCH_SIZE, stats.compressedBytes, worst );
+
+    keyframes.deallocate();
+}
+
+#endif // NOT RELEASE
@@ -0,0 +1,253 @@
+#ifndef RELEASE
+
+#include "RollbackStates.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <list>
+#include <stack>
+
+using namespace std;
+
+
+#define NUM_STATES          ( 60 )
+#define NUM_KEYFRAMES       ( 2 + NUM_STATES / 8 )
+#define KEYFRAME_INTERVAL   ( 8 )
+#define NUM_ITERATIONS      ( 100000 )
+#define MAX_ROLLBACK_DISTANCE ( 20 )
+#define MAX_REMOTE_DELAY    ( 80 )
+
+
+// The previous std::list + std::stack implementation, used as a reference
+class ReferenceStates
+{
+public:
+
+    list<RollbackStates::State> states;
+
+    ReferenceStates()
+    {
+        for ( uint32_t i = 0; i < NUM_STATES; ++i )
+            _freeStack.push ( i );
+
+        for ( uint32_t i = 0; i < NUM_KEYFRAMES; ++i )
+            _freeKeyframes.push ( i );
+    }
+
+    const RollbackStates::State& push ( IndexedFrame indexedFrame, uint32_t remoteFrame )
+    {
+        bool isKeyframe = states.empty() || ( states.back().keyframeDistance + 1 >= KEYFRAME_INTERVAL );
+
+        while ( _freeStack.empty() || ( isKeyframe && _freeKeyframes.empty() ) )
+        {
+            auto it = states.begin();
+
+            if ( it->indexedFrame.parts.frame <= remoteFrame )
+            {
+                do { ++it; } while ( it != states.end() && ! it->isKeyframe() );
+
+                if ( it == states.end() )
+                    it = states.begin();
+            }
+
+            if ( eraseChain ( it ) )
+                isKeyframe = true;
+        }
+
+        RollbackStates::State state = { NetplayState::InGame, 0, indexedFrame, _freeStack.top(), NO_KEYFRAME, 0 };
+        _freeStack.pop();
+
+        if ( isKeyframe )
+        {
+            state.keyframe = _freeKeyframes.top();
+            _freeKeyframes.pop();
+        }
+        else
+        {
+            state.keyframeDistance = states.back().keyframeDistance + 1;
+        }
+
+        states.push_back ( state );
+        return states.back();
+    }
+
+    // Returns the number of states if not found
+    size_t load ( IndexedFrame indexedFrame )
+    {
+        size_t pos = states.size();
+
+        for ( auto it = states.rbegin(); it != states.rend(); ++it )
+        {
+            --pos;
+
+            if ( it->indexedFrame.value <= indexedFrame.value )
+            {
+                for ( auto jt = it.base(); jt != states.end(); ++jt )
+                    freeState ( *jt );
+
+                states.erase ( it.base(), states.end() );
+                return pos;
+            }
+        }
+
+        return states.size();
+    }
+
+private:
+
+    stack<uint32_t> _freeStack, _freeKeyframes;
+
+    void freeState ( const RollbackStates::State& state )
+    {
+        if ( state.isKeyframe() )
+            _freeKeyframes.push ( state.keyframe );
+
+        _freeStack.push ( state.slot );
+    }
+
+    bool eraseChain ( list<RollbackStates::State>::iterator it )
+    {
+        do
+        {
+            freeState ( *it );
+            it = states.erase ( it );
+        }
+        while ( it != states.end() && ! it->isKeyframe() );
+
+        return ( it == states.end() );
+    }
+};
+
+
+// Counts the states that are still allocated
+struct StateCounter : public RollbackStates::Owner
+{
+    int count = 0;
+
+    void rollbackStateFreed ( const RollbackStates::State& state ) override { --count; }
+};
+
+
+static void expectSameStates ( const ReferenceStates& ref, const RollbackStates& ring )
+{
+    ASSERT_EQ ( ref.states.size(), ring.size() );
+
+    size_t i = 0;
+
+    for ( const RollbackStates::State& state : ref.states )
+    {
+        EXPECT_EQ ( state.indexedFrame.value, ring[i].indexedFrame.value ) << "i=" << i;
+        EXPECT_EQ ( state.slot, ring[i].slot ) << "i=" << i;
+        EXPECT_EQ ( state.keyframe, ring[i].keyframe ) << "i=" << i;
+        EXPECT_EQ ( state.keyframeDistance, ring[i].keyframeDistance ) << "i=" << i;
+        ++i;
+    }
+}
+
+
+TEST ( RollbackStates, MatchesReference )
+{
+    srand ( 1234 );
+
+    ReferenceStates ref;
+    RollbackStates ring;
+    StateCounter counter;
+
+    ring.owner = &counter;
+    ring.allocate ( NUM_STATES, NUM_KEYFRAMES, KEYFRAME_INTERVAL );
+
+    IndexedFrame indexedFrame = {{ 0, 0 }};
+    uint32_t remoteDelay = 0;
+
+    for ( size_t i = 0; i < NUM_ITERATIONS; ++i )
+    {
+        const int action = rand() % 100;
+
+        if ( action < 2 )
+        {
+            // Transition to the next index
+            ++indexedFrame.parts.index;
+            indexedFrame.parts.frame = 0;
+        }
+        else if ( action < 4 )
+        {
+            // Change how far the remote is behind
+            remoteDelay = rand() % MAX_REMOTE_DELAY;
+        }
+        else if ( action < 10 )
+        {
+            // Rollback
+            IndexedFrame target = indexedFrame;
+            target.parts.frame -= min<uint32_t> ( target.parts.frame, rand() % MAX_ROLLBACK_DISTANCE );
+
+            const size_t expected = ref.load ( target );
+            const size_t pos = ring.find ( target );
+
+            ASSERT_EQ ( expected, pos ) << "i=" << i;
+
+            if ( pos < ring.size() )
+            {
+                const size_t k = ring.findKeyframe ( pos );
+
+                EXPECT_TRUE ( ring[k].isKeyframe() );
+                EXPECT_EQ ( pos - k, ring[pos].keyframeDistance );
+
+                ring.eraseAfter ( pos );
+                indexedFrame = ring[pos].indexedFrame;
+                ++indexedFrame.parts.frame;
+            }
+        }
+        else
+        {
+            // Save a state
+            const uint32_t remoteFrame = indexedFrame.parts.frame - min ( indexedFrame.parts.frame, remoteDelay );
+
+            ref.push ( indexedFrame, remoteFrame );
+            ring.push ( NetplayState::InGame, 0, indexedFrame, remoteFrame );
+            ++counter.count;
+
+            ++indexedFrame.parts.frame;
+        }
+
+        expectSameStates ( ref, ring );
+        ASSERT_EQ ( int ( ring.size() ), counter.count );
+
+        if ( HasFailure() )
+            return;
+    }
+
+    ring.deallocate();
+    EXPECT_EQ ( 0, counter.count );
+}
+
+TEST ( RollbackStates, FindSkippedFrames )
+{
+    RollbackStates ring;
+    ring.allocate ( NUM_STATES, NUM_KEYFRAMES, KEYFRAME_INTERVAL );
+
+    // Save every third frame, so the constant time guess always misses
+    for ( uint32_t frame = 10; frame < 10 + 3 * NUM_STATES; frame += 3 )
+        ring.push ( NetplayState::InGame, 0, {{ frame, 1 }}, 0 );
+
+    for ( uint32_t frame = 0; frame < 20 + 3 * NUM_STATES; ++frame )
+    {
+        const IndexedFrame indexedFrame = {{ frame, 1 }};
+
+        size_t expected = ring.size();
+
+        for ( size_t i = 0; i < ring.size(); ++i )
+        {
+            if ( ring[i].indexedFrame.value <= indexedFrame.value )
+                expected = i;
+        }
+
+        EXPECT_EQ ( expected, ring.find ( indexedFrame ) ) << "frame=" << frame;
+    }
+
+    // States from an earlier index are before every state of a later index
+    EXPECT_EQ ( ring.size(), ring.find ( {{ 1000, 0 }} ) );
+    EXPECT_EQ ( ring.size() - 1, ring.find ( {{ 0, 2 }} ) );
+}
+
+#endif // NOT RELEASE
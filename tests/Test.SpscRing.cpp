@@ -0,0 +1,123 @@
+#ifndef RELEASE
+
+#include "SpscRing.hpp"
+#include "Thread.hpp"
+#include "Profiler.hpp"
+#include "Logger.hpp"
+
+#include <gtest/gtest.h>
+
+#include <sched.h>
+
+using namespace std;
+
+
+#define NUM_STRESS_SAMPLES  ( 500000 )
+
+
+// Timestamped sample with a checksum, so torn reads are detected
+struct StressSample
+{
+    uint64_t ticks, sequence, checksum;
+};
+
+typedef SpscRing<StressSample, 1024> StressRing;
+
+// Pushes sequential samples as fast as possible, retrying when the ring is full
+struct StressProducer : public Thread
+{
+    StressRing& ring;
+
+    uint64_t numFull = 0;
+
+    StressProducer ( StressRing& ring ) : ring ( ring ) {}
+
+    void run() override
+    {
+        for ( uint64_t i = 0; i < NUM_STRESS_SAMPLES; )
+        {
+            const uint64_t ticks = Profiler::getTicks();
+
+            if ( ring.push ( { ticks, i, ticks ^ ~i } ) )
+            {
+                ++i;
+                continue;
+            }
+
+            // Let the consumer run on machines with fewer cores than threads
+            ++numFull;
+            sched_yield();
+        }
+    }
+};
+
+
+TEST ( SpscRing, Basic )
+{
+    SpscRing<int, 4> ring;
+    int value = 0;
+
+    EXPECT_TRUE ( ring.empty() );
+    EXPECT_FALSE ( ring.pop ( value ) );
+
+    for ( int i = 0; i < 4; ++i )
+        EXPECT_TRUE ( ring.push ( i ) );
+
+    // Full rings drop the new element
+    EXPECT_FALSE ( ring.push ( 4 ) );
+    EXPECT_EQ ( 4u, ring.size() );
+
+    // Wrap around several times
+    for ( int i = 0; i < 20; ++i )
+    {
+        ASSERT_TRUE ( ring.pop ( value ) );
+        EXPECT_EQ ( i, value );
+        EXPECT_TRUE ( ring.push ( i + 4 ) );
+    }
+
+    EXPECT_EQ ( 4u, ring.size() );
+}
+
+TEST ( SpscRing, Stress )
+{
+    StressRing ring;
+    StressProducer producer ( ring );
+
+    const uint64_t start = Profiler::getTicks();
+
+    producer.start();
+
+    uint64_t expected = 0, numEmpty = 0, lastTicks = 0, maxLatency = 0;
+    StressSample sample;
+
+    while ( expected < NUM_STRESS_SAMPLES )
+    {
+        if ( ! ring.pop ( sample ) )
+        {
+            ++numEmpty;
+            sched_yield();
+            continue;
+        }
+
+        // Every sample arrives exactly once, in order, and intact
+        ASSERT_EQ ( expected, sample.sequence );
+        ASSERT_EQ ( sample.ticks ^ ~sample.sequence, sample.checksum );
+        ASSERT_GE ( sample.ticks, lastTicks );
+
+        maxLatency = max ( maxLatency, Profiler::getTicks() - sample.ticks );
+        lastTicks = sample.ticks;
+        ++expected;
+    }
+
+    producer.join();
+
+    EXPECT_TRUE ( ring.empty() );
+
+    const double seconds = double ( Profiler::getTicks() - start ) / Profiler::getTicksPerSecond();
+
+    PRINT ( "SpscRing: %u samples in %.3f s (%.1f M/s); full=%llu; empty=%llu; maxLatency=%.1f us",
+            NUM_STRESS_SAMPLES, seconds, NUM_STRESS_SAMPLES / seconds / 1e6, producer.numFull, numEmpty,
+            1e6 * maxLatency / Profiler::getTicksPerSecond() );
+}
+
+#endif // NOT RELEASE
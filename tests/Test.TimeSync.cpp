@@ -0,0 +1,214 @@
+#ifndef RELEASE
+
+#include "TimeSync.hpp"
+#include "Logger.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <deque>
+
+using namespace std;
+
+
+#define SESSION_SECONDS     ( 120 )
+#define LATENCY_MS          ( 50.0 )
+#define MAX_FRAMES_AHEAD    ( 8 )
+#define STALL_MS            ( 1.0 )
+
+
+// Virtual peer with its own clock, that sends its newest input frame and an ack every frame
+struct VirtualPeer
+{
+    // Local clock ticks per real millisecond
+    double clockRate = 1.0;
+
+    bool useTimeSync = false;
+
+    // Remote advantage is only known with acks
+    bool useAcks = true;
+
+    TimeSync timeSync;
+
+    uint32_t frame = 0, remoteEnd = 0;
+
+    double nextFrameTime = 0;
+
+    // Number of times this peer had to wait for the remote, and the total remote frames it had to predict
+    uint32_t numStalls = 0;
+    uint64_t numPredicted = 0;
+};
+
+// Message with the newest input frame and ack, delivered at a real time
+struct VirtualMessage
+{
+    double time;
+    uint32_t end, ack;
+};
+
+struct SimulationResult
+{
+    double averageAdvantage = 0, worstAdvantage = 0;
+    array<uint32_t, 2> numStalls = {{ 0, 0 }};
+    array<uint64_t, 2> numPredicted = {{ 0, 0 }};
+};
+
+static SimulationResult simulate ( double skew, bool useTimeSync, bool useAcks )
+{
+    array<VirtualPeer, 2> peers;
+    array<deque<VirtualMessage>, 2> channels;
+
+    peers[0].clockRate = 1 + skew;
+    peers[1].clockRate = 1 - skew;
+
+    // Start half a frame apart, like after loading screens that end at slightly different times
+    peers[1].nextFrameTime = 500.0 / TIME_SYNC_NOMINAL_FPS;
+
+    for ( VirtualPeer& peer : peers )
+    {
+        peer.useTimeSync = useTimeSync;
+        peer.useAcks = useAcks;
+        peer.timeSync.gotPingLatency ( LATENCY_MS );
+    }
+
+    SimulationResult result;
+    uint32_t numSamples = 0;
+
+    for ( ;; )
+    {
+        const uint8_t i = ( peers[0].nextFrameTime <= peers[1].nextFrameTime ? 0 : 1 );
+        VirtualPeer& peer = peers[i];
+        const VirtualPeer& remote = peers[1 - i];
+        const double now = peer.nextFrameTime;
+
+        if ( now > SESSION_SECONDS * 1000.0 )
+            break;
+
+        // Receive the remote messages that have arrived
+        deque<VirtualMessage>& incoming = channels[1 - i];
+
+        while ( ! incoming.empty() && incoming.front().time <= now )
+        {
+            peer.remoteEnd = max ( peer.remoteEnd, incoming.front().end );
+
+            if ( peer.useAcks )
+                peer.timeSync.gotRemoteAdvantage ( int ( incoming.front().end ) - int ( incoming.front().ack ) );
+
+            incoming.pop_front();
+        }
+
+        // Wait for the remote when too far ahead, like NetplayManager::isRemoteInputReady
+        if ( peer.frame > peer.remoteEnd + MAX_FRAMES_AHEAD )
+        {
+            ++peer.numStalls;
+            peer.nextFrameTime += STALL_MS;
+            continue;
+        }
+
+        peer.numPredicted += ( peer.frame + 1 > peer.remoteEnd ? peer.frame + 1 - peer.remoteEnd : 0 );
+
+        ++peer.frame;
+
+        channels[i].push_back ( { now + LATENCY_MS, peer.frame, peer.remoteEnd } );
+
+        peer.timeSync.gotLocalAdvantage ( int ( peer.frame ) - int ( peer.remoteEnd ) );
+
+        const double fps = ( peer.useTimeSync ? peer.timeSync.getDesiredFps() : TIME_SYNC_NOMINAL_FPS );
+
+        peer.nextFrameTime += 1000.0 / fps / peer.clockRate;
+
+        // Measure the actual advantage over the second half of the session
+        if ( i == 0 && now > SESSION_SECONDS * 500.0 )
+        {
+            const double advantage = fabs ( double ( peer.frame ) - double ( remote.frame ) );
+
+            result.averageAdvantage += advantage;
+            result.worstAdvantage = max ( result.worstAdvantage, advantage );
+            ++numSamples;
+        }
+    }
+
+    result.averageAdvantage /= numSamples;
+
+    for ( uint8_t i = 0; i < 2; ++i )
+    {
+        result.numStalls[i] = peers[i].numStalls;
+        result.numPredicted[i] = peers[i].numPredicted;
+    }
+
+    return result;
+}
+
+
+TEST ( TimeSync, DesiredFps )
+{
+    TimeSync timeSync;
+
+    timeSync.gotPingLatency ( 50 );
+    EXPECT_DOUBLE_EQ ( 3, timeSync.getLatency() );
+
+    // Not enough samples yet
+    timeSync.gotLocalAdvantage ( 10 );
+    EXPECT_EQ ( TIME_SYNC_NOMINAL_FPS, timeSync.getDesiredFps() );
+
+    for ( uint32_t i = 0; i < TIME_SYNC_MIN_SAMPLES; ++i )
+        timeSync.gotLocalAdvantage ( 10 );
+
+    // Ahead by 7 frames after the latency, which is slowed down by the max slew
+    EXPECT_DOUBLE_EQ ( 7, timeSync.getFrameAdvantage() );
+    EXPECT_DOUBLE_EQ ( TIME_SYNC_NOMINAL_FPS * ( 1 - TIME_SYNC_MAX_SLEW ), timeSync.getDesiredFps() );
+    EXPECT_GT ( timeSync.getSlew(), 0 );
+
+    // The remote advantage replaces the latency, which still slows down, but less
+    timeSync.gotRemoteAdvantage ( 8 );
+    EXPECT_DOUBLE_EQ ( 1, timeSync.getFrameAdvantage() );
+    EXPECT_GT ( timeSync.getSlew(), TIME_SYNC_GAIN * ( 1 - TIME_SYNC_DEADBAND ) );
+    EXPECT_LT ( timeSync.getSlew(), TIME_SYNC_MAX_SLEW );
+
+    // Behind within the deadband
+    timeSync.reset();
+
+    for ( uint32_t i = 0; i < TIME_SYNC_MIN_SAMPLES; ++i )
+    {
+        timeSync.gotLocalAdvantage ( 3 );
+        timeSync.gotRemoteAdvantage ( 4 );
+    }
+
+    EXPECT_DOUBLE_EQ ( -0.5, timeSync.getFrameAdvantage() );
+    EXPECT_EQ ( TIME_SYNC_NOMINAL_FPS, timeSync.getDesiredFps() );
+}
+
+TEST ( TimeSync, SkewedClocks )
+{
+    for ( double skew : { 0.001, 0.005 } )
+    {
+        const SimulationResult fixed = simulate ( skew, false, true );
+        const SimulationResult synced = simulate ( skew, true, true );
+        const SimulationResult estimated = simulate ( skew, true, false );
+
+        for ( const SimulationResult *result : { &fixed, &synced, &estimated } )
+        {
+            PRINT ( "TimeSync: skew=%.1f%%; %s: advantage=%.2f/%.0f frames; stalls=%u/%u; predicted=%llu/%llu",
+                    100 * skew, ( result == &fixed ? "fixed" : ( result == &synced ? "synced" : "estimated" ) ),
+                    result->averageAdvantage, result->worstAdvantage, result->numStalls[0], result->numStalls[1],
+                    result->numPredicted[0], result->numPredicted[1] );
+        }
+
+        // Without time sync the faster clock drifts ahead until it has to wait for the remote
+        EXPECT_GT ( fixed.numStalls[0], 0u ) << "skew=" << skew;
+
+        // With time sync the peers converge, so neither side waits and both predict about the same
+        for ( const SimulationResult *result : { &synced, &estimated } )
+        {
+            EXPECT_LT ( result->averageAdvantage, 1.5 ) << "skew=" << skew;
+            EXPECT_LE ( result->worstAdvantage, 3 ) << "skew=" << skew;
+            EXPECT_EQ ( 0u, result->numStalls[0] ) << "skew=" << skew;
+            EXPECT_EQ ( 0u, result->numStalls[1] ) << "skew=" << skew;
+            EXPECT_NEAR ( 1.0, double ( result->numPredicted[0] ) / result->numPredicted[1], 0.2 ) << "skew=" << skew;
+        }
+    }
+}
+
+#endif // NOT RELEASE
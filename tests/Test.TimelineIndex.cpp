@@ -0,0 +1,112 @@
+#ifndef RELEASE
+
+#include "TimelineIndex.hpp"
+#include "Logger.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace std;
+
+
+#define BYTES_PER_FRAME     ( TIMELINE_BYTES_PER_FRAME )
+
+
+// Session starting on index 2 at frame 5, then 3 indices of 100, 300, and 50 frames
+static TimelineIndex makeSession()
+{
+    TimelineIndex timeline;
+
+    timeline.push ( {{ 5, 2 }}, 5, 1000, 2, 0 );
+    timeline.push ( {{ 0, 3 }}, 105, 2500, 3, 105 );
+    timeline.push ( {{ 0, 4 }}, 405, 7500, 4, 300 );
+    timeline.push ( {{ 0, 5 }}, 455, 8500, 5, 50 );
+
+    return timeline;
+}
+
+
+TEST ( TimelineIndex, Lookups )
+{
+    const TimelineIndex timeline = makeSession();
+
+    ASSERT_EQ ( 4u, timeline.size() );
+
+    EXPECT_EQ ( 0u, timeline.entries[0].offset );
+    EXPECT_EQ ( 100 * BYTES_PER_FRAME, timeline.entries[1].offset );
+    EXPECT_EQ ( 400 * BYTES_PER_FRAME, timeline.entries[2].offset );
+    EXPECT_EQ ( 450 * BYTES_PER_FRAME, timeline.entries[3].offset );
+
+    EXPECT_EQ ( 0u, timeline.entries[0].wallTime );
+    EXPECT_EQ ( 7500u, timeline.entries[3].wallTime );
+
+    EXPECT_TRUE ( timeline.find ( 1 ) == 0 );
+    EXPECT_TRUE ( timeline.find ( 6 ) == 0 );
+    ASSERT_TRUE ( timeline.find ( 3 ) != 0 );
+    EXPECT_EQ ( 3u, timeline.find ( 3 )->index );
+
+    // World time before the first entry, on an entry, and in between
+    EXPECT_EQ ( MaxIndexedFrame.value, timeline.getIndexedFrame ( 4 ).value );
+    EXPECT_EQ ( IndexedFrame ( {{ 5, 2 }} ).value, timeline.getIndexedFrame ( 5 ).value );
+    EXPECT_EQ ( IndexedFrame ( {{ 104, 2 }} ).value, timeline.getIndexedFrame ( 104 ).value );
+    EXPECT_EQ ( IndexedFrame ( {{ 0, 3 }} ).value, timeline.getIndexedFrame ( 105 ).value );
+    EXPECT_EQ ( IndexedFrame ( {{ 299, 3 }} ).value, timeline.getIndexedFrame ( 404 ).value );
+    EXPECT_EQ ( IndexedFrame ( {{ 1000, 5 }} ).value, timeline.getIndexedFrame ( 1455 ).value );
+
+    EXPECT_EQ ( 3u, timeline.findWallTime ( 6000 )->index );
+    EXPECT_EQ ( 5u, timeline.findWallTime ( 9000 )->index );
+
+    // Round trips between index:frame, world time, and offsets
+    for ( uint32_t worldTime = 5; worldTime < 600; ++worldTime )
+    {
+        const IndexedFrame indexedFrame = timeline.getIndexedFrame ( worldTime );
+
+        EXPECT_EQ ( worldTime, timeline.getWorldTime ( indexedFrame ) );
+
+        const uint32_t offset = timeline.getOffset ( indexedFrame );
+
+        EXPECT_EQ ( ( worldTime - 5 ) * BYTES_PER_FRAME, offset );
+        EXPECT_EQ ( indexedFrame.value, timeline.getIndexedFrameAtOffset ( offset ).value );
+        EXPECT_EQ ( indexedFrame.value, timeline.getIndexedFrameAtOffset ( offset + 1 ).value );
+    }
+
+    EXPECT_EQ ( UINT_MAX, timeline.getOffset ( {{ 0, 2 }} ) );
+    EXPECT_EQ ( UINT_MAX, timeline.getWorldTime ( {{ 0, 1 }} ) );
+}
+
+TEST ( TimelineIndex, Rollback )
+{
+    TimelineIndex timeline = makeSession();
+
+    // Re-entering index 4 after a rollback replaces the last two entries
+    timeline.push ( {{ 0, 4 }}, 406, 7600, 4, 301 );
+
+    ASSERT_EQ ( 3u, timeline.size() );
+    EXPECT_EQ ( 406u, timeline.entries.back().worldTime );
+    EXPECT_EQ ( 401 * BYTES_PER_FRAME, timeline.entries.back().offset );
+}
+
+TEST ( TimelineIndex, Serialize )
+{
+    const TimelineIndex timeline = makeSession();
+
+    const string bytes = Protocol::encode ( timeline );
+
+    size_t consumed;
+    const MsgPtr msg = Protocol::decode ( &bytes[0], bytes.size(), consumed );
+
+    ASSERT_TRUE ( msg.get() );
+    ASSERT_EQ ( MsgType::TimelineIndex, msg->getMsgType() );
+    EXPECT_EQ ( bytes.size(), consumed );
+
+    const TimelineIndex& decoded = msg->getAs<TimelineIndex>();
+
+    EXPECT_EQ ( timeline.startWallTime, decoded.startWallTime );
+    ASSERT_EQ ( timeline.size(), decoded.size() );
+
+    for ( size_t i = 0; i < timeline.size(); ++i )
+        EXPECT_EQ ( timeline.entries[i].str(), decoded.entries[i].str() );
+
+    PRINT ( "TimelineIndex: %u entries in %u bytes", timeline.size(), bytes.size() );
+}
+
+#endif // NOT RELEASE
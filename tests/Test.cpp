@@ -1,10 +1,31 @@
 #ifndef RELEASE
 
+#include "Test.hpp"
+
 #include <gtest/gtest.h>
 
+#include <atomic>
+
 using namespace std;
 
 
+// The unit tests are linked with --wrap=malloc, so every call to malloc goes through here
+static atomic<size_t> numMallocs ( 0 );
+
+extern "C" void *__real_malloc ( size_t size );
+
+extern "C" void *__wrap_malloc ( size_t size )
+{
+    ++numMallocs;
+    return __real_malloc ( size );
+}
+
+size_t getNumMallocs()
+{
+    return numMallocs;
+}
+
+
 int RunAllTests ( int& argc, char *argv[] )
 {
     testing::InitGoogleTest ( &argc, argv );
@@ -1,3 +1,9 @@
 #pragma once
 
+#include <cstddef>
+
+
 int RunAllTests ( int& argc, char *argv[] );
+
+// Get the number of calls to malloc so far, this includes operator new and allocations inside C libraries
+size_t getNumMallocs();
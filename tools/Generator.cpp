@@ -3,6 +3,8 @@
 
 #include <utility>
 #include <algorithm>
+#include <fstream>
+#include <iterator>
 
 using namespace std;
 
@@ -307,6 +309,36 @@ int main ( int argc, char *argv[] )
 
     Logger::get().initialize ( LOG_FILE, 0 );
 
+    // Convert a rollback data file in the old format to the flat format
+    if ( string ( argv[1] ) == "--convert" )
+    {
+        if ( argc < 4 )
+        {
+            PRINT ( "Usage: %s --convert input output", argv[0] );
+            Logger::get().deinitialize();
+            return -1;
+        }
+
+        ifstream fin ( argv[2], ifstream::binary );
+        const string data ( ( istreambuf_iterator<char> ( fin ) ), istreambuf_iterator<char>() );
+
+        MemDumpPlan plan;
+
+        if ( ! plan.load ( &data[0], data.size() ) )
+        {
+            PRINT ( "Failed to load %s", argv[2] );
+            Logger::get().deinitialize();
+            return -1;
+        }
+
+        LOG ( "Converted: numOps=%u; totalSize=%u", plan.numOps, plan.totalSize );
+
+        const bool good = plan.save ( argv[3] );
+
+        Logger::get().deinitialize();
+        return ( good ? 0 : -1 );
+    }
+
     MemDumpList allAddrs;
 
     allAddrs.append ( miscAddrs );
@@ -323,6 +355,16 @@ int main ( int argc, char *argv[] )
 
     LOG ( "allAddrs.totalSize=%u", allAddrs.totalSize );
 
+    if ( ! allAddrs.overlaps.empty() )
+        PRINT ( "Warning: %u overlapping address ranges, see %s", allAddrs.overlaps.size(), LOG_FILE );
+
+    for ( const MemDumpOverlap& overlap : allAddrs.overlaps )
+    {
+        LOG ( "Overlap: { 0x%06X, 0x%06X } and { 0x%06X, 0x%06X }",
+              overlap.firstAddr, overlap.firstAddr + overlap.firstSize,
+              overlap.secondAddr, overlap.secondAddr + overlap.secondSize );
+    }
+
     LOG ( "allAddrs:" );
     for ( const MemDump& mem : allAddrs.addrs )
     {
@@ -350,7 +392,9 @@ int main ( int argc, char *argv[] )
         }
     }
 
-    allAddrs.save ( argv[1] );
+    LOG ( "allAddrs.plan: numOps=%u; totalSize=%u", allAddrs.plan.numOps, allAddrs.plan.totalSize );
+
+    allAddrs.plan.save ( argv[1] );
 
     Logger::get().deinitialize();
     return 0;
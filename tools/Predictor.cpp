@@ -0,0 +1,141 @@
+#include "ReplayManager.hpp"
+#include "InputPredictor.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+
+#define LOG_FILE "predictor.log"
+
+// Default number of missing remote frames each input is predicted over
+#define DEFAULT_LATENCY ( 4 )
+
+
+// Hits of one strategy when predicting over the latency
+struct Score
+{
+    uint32_t numHits = 0, numInputs = 0;
+};
+
+// Score every strategy against the inputs of one player in one index. Each input is predicted from the actual inputs
+// known latency frames earlier, chaining the predictions in between, like the missing remote inputs during rollback.
+static void evaluate ( const vector<uint16_t>& inputs, uint32_t latency,
+                       InputPredictors& predictors, vector<Score>& scores )
+{
+    array<uint16_t, INPUT_PREDICTOR_HISTORY> history;
+
+    for ( uint32_t frame = latency; frame < inputs.size(); ++frame )
+    {
+        // The predictors are only trained with the inputs that would be known by now
+        const uint32_t known = frame - latency;
+
+        if ( known > 0 )
+        {
+            const size_t n = min<size_t> ( known, INPUT_PREDICTOR_HISTORY );
+            predictors.gotInput ( &inputs[known - n], n, inputs[known] );
+        }
+
+        for ( size_t i = 0; i < predictors.getAll().size(); ++i )
+        {
+            const InputPredictor& predictor = *predictors.getAll()[i];
+
+            size_t n = min<size_t> ( known + 1, INPUT_PREDICTOR_HISTORY );
+            copy ( &inputs[known + 1 - n], &inputs[known] + 1, history.begin() );
+
+            uint16_t input = 0;
+
+            for ( uint32_t f = known + 1; f <= frame; ++f )
+            {
+                input = predictor.predict ( &history[0], n );
+
+                if ( n == history.size() )
+                    copy ( history.begin() + 1, history.end(), history.begin() );
+                else
+                    ++n;
+
+                history[n - 1] = input;
+            }
+
+            scores[i].numHits += ( input == inputs[frame] );
+            ++scores[i].numInputs;
+        }
+    }
+}
+
+int main ( int argc, char *argv[] )
+{
+    if ( argc < 2 )
+    {
+        PRINT ( "Usage: %s [--latency frames] replay..", argv[0] );
+        return -1;
+    }
+
+    Logger::get().initialize ( LOG_FILE, 0 );
+
+    uint32_t latency = DEFAULT_LATENCY;
+    int first = 1;
+
+    if ( string ( argv[1] ) == "--latency" && argc >= 4 )
+    {
+        latency = max ( 1, atoi ( argv[2] ) );
+        first = 3;
+    }
+
+    // The Markov models are trained per player across all the replays
+    array<InputPredictors, 2> predictors;
+    array<vector<Score>, 2> scores;
+
+    for ( uint8_t player = 0; player < 2; ++player )
+        scores[player].resize ( predictors[player].getAll().size() );
+
+    for ( int i = first; i < argc; ++i )
+    {
+        ReplayManager repMan;
+
+        if ( ! repMan.load ( argv[i], true ) )
+        {
+            PRINT ( "Failed to load %s", argv[i] );
+            continue;
+        }
+
+        // Only the in-game inputs are predicted during rollback
+        for ( uint32_t index = 0; index <= repMan.getLastIndex(); ++index )
+        {
+            if ( repMan.getGameMode ( {{ 0, index }} ) != CC_GAME_MODE_IN_GAME )
+                continue;
+
+            array<vector<uint16_t>, 2> inputs;
+
+            for ( uint32_t frame = 0; frame < repMan.getNumFrames ( index ); ++frame )
+            {
+                const ReplayManager::Inputs& frameInputs = repMan.getInputs ( {{ frame, index }} );
+                inputs[0].push_back ( frameInputs.p1 );
+                inputs[1].push_back ( frameInputs.p2 );
+            }
+
+            for ( uint8_t player = 0; player < 2; ++player )
+                evaluate ( inputs[player], latency, predictors[player], scores[player] );
+        }
+    }
+
+    for ( uint8_t player = 0; player < 2; ++player )
+    {
+        PRINT ( "P%u: %s", player + 1, predictors[player].str() );
+
+        for ( size_t i = 0; i < scores[player].size(); ++i )
+        {
+            const Score& score = scores[player][i];
+
+            PRINT ( "P%u: %s: %.2f%% over %u frames; %u mispredicted of %u",
+                    player + 1, predictors[player].getAll()[i]->name(),
+                    ( score.numInputs ? 100.0 * score.numHits / score.numInputs : 0.0 ),
+                    latency, score.numInputs - score.numHits, score.numInputs );
+        }
+    }
+
+    Logger::get().deinitialize();
+    return 0;
+}